@@ -5,15 +5,30 @@
 #define _POSIX_SOURCE
 
 #include <time.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
 #include <errno.h>
-
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <locale.h>
+#include <langinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Calendar functions defined in dates.h (tm_isleapyear(), tm_getdaysinmonth()...) are compiled here as external definitions.
+#define TM_INLINE
 #include "dates.h"
 
 /// Returns the name of UTC timezone.
 /// @returns The name of UTC timezone
+/// @remark The name is interned: UTC representation is identified by this very pointer in \p tm_zone, never by comparing strings.
+/// Abbreviations of local time types are interned likewise by each compiled timezone, even those spelled "GMT" or "UTC".
 static const char *
 tm_utctimezone (void)
 {
@@ -28,918 +43,6768 @@ tm_utctimezone (void)
     {
       struct tm result;
 
-      // gmtime_r converts to "GMT" timezone
-      UTC_TZ = strdup (gmtime_r (&now, &result)->tm_zone);
+      // gmtime_r converts to "GMT" timezone, statically allocated: instants broken down by gmtime_r() share the same pointer.
+      UTC_TZ = gmtime_r (&now, &result)->tm_zone;
     }
   }
   return UTC_TZ;
 }
 
-/// Initializes instant in time from local date and time data.
-/// @param [in,out] tm Pointer to broken-down time structure
-/// @returns Absolute calendar time
-/// @remark Calls mktime. The tm_normalizetolocal() function is equivalent to the POSIX standard function mktime()
-static time_t
-tm_normalizetolocal (struct tm *tm)
-{
-  /* (mktime man page)
-     The mktime() function converts a broken-down time structure, expressed as local time, to calendar time representation.
-     The function ignores the values supplied by the caller in the tm_wday, tm_yday and tm_gmtoff fields.
-     If structure members are outside their valid interval,  they will be normalized  (so that,  for example, 40 October is
-     changed into 9 November).
-
-     The value  specified in the tm_isdst field  informs mktime() whether or not daylight saving time (DST) is in effect for the time supplied in
-     the tm structure:
-     - a positive value means DST is in effect;
-     - zero means that DST is not in effect;
-     - and a negative value means that mktime() should (use timezone information and system databases to) attempt  to determine whether DST is in
-     effect at the specified time.
+/*****************************************************
+*   CALENDAR KERNELS                                 *
+*****************************************************/
 
-     The mktime() function modifies the fields of the tm structure as follows: tm_wday and tm_yday are set to values determined from the contents
-     of the other fields; tm_gmtoff is set according to the current timezone of the system (environment variable TZ).
-     If structure members are outside their valid interval, they will be normalized (so that, for example, 40 October is changed into 9 November).
-     tm_isdst  is set (regardless of its initial value) to a positive value or to 0, respectively, to indicate whether DST is or is not in effect
-     at the specified time.
+/// Shift of the branch-free calendar kernels, in 400-year eras, so that they compute on unsigned 32-bit integers.
+#define TM_CIVILERAS 82
+/// Day number of 1970-01-01 in the branch-free calendar kernels.
+#define TM_CIVILEPOCH (719468 + 146097 * TM_CIVILERAS)
+/// Range of years handled by the branch-free calendar kernels.
+#define TM_CIVILMINYEAR (1 - 400 * TM_CIVILERAS)
+#define TM_CIVILMAXYEAR 2900000
+/// Range of days since 1970-01-01 handled by the branch-free calendar kernels.
+#define TM_CIVILMINDAYS (-TM_CIVILEPOCH)
+#define TM_CIVILMAXDAYS 1000000000
+
+/// Declares a function compiled for several instruction sets (AVX2 and baseline), selected when the program is loaded.
+/// Loops of branch-free calendar kernels in such functions can be vectorized, with the baseline as scalar fallback.
+#if defined(__x86_64__) && ((defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6) || (defined(__clang__) && __clang_major__ >= 14))
+#  define TM_TARGET_CLONES __attribute__ ((target_clones ("avx2", "default")))
+#else
+#  define TM_TARGET_CLONES
+#endif
+
+/// Returns the number of days elapsed since 1970-01-01 at a date, without branches.
+/// @param [in] year Year (TM_CIVILMINYEAR through TM_CIVILMAXYEAR)
+/// @param [in] month Month (1 through 12)
+/// @param [in] day Day of month (1 through 31)
+/// @returns Number of days since 1970-01-01 (negative before)
+/// @remark Algorithm from Cassio Neri and Lorenz Schneider, Euclidean affine functions and their application to calendar algorithms.
+static inline int32_t
+tm_daysfromcivil32 (int32_t year, uint32_t month, uint32_t day)
+{
+  uint32_t j = month <= 2;      // January and February are counted as months 13 and 14 of the previous year.
+  uint32_t y = (uint32_t) (year + 400 * TM_CIVILERAS) - j;
+  uint32_t m = j ? month + 12 : month;
+  uint32_t c = y / 100;
 
-     Calling mktime() also sets the external variable tzname with information about the current timezone.
-   */
-  return mktime (tm);           /* May apply daylight saving if tm_isdst is not negative before function call */
+  return (int32_t) (1461 * y / 4 - c + c / 4 + (979 * m - 2919) / 32 + day - 1) - TM_CIVILEPOCH;
 }
 
-/// Initializes instant in time from UTC date and time data.
-/// @param [in,out] tm Pointer to broken-down time structure
-/// @returns Absolute calendar time
-/// @remark Portable version of timegm(): set the TZ environment variable to UTC, call mktime and restore the value of TZ.
-/// @see man mktime and timegm
-static time_t
-tm_normalizetoutc (struct tm *tm)
+/// Returns the date a number of days after 1970-01-01, without branches.
+/// @param [in] days Number of days since 1970-01-01 (TM_CIVILMINDAYS through TM_CIVILMAXDAYS)
+/// @param [out] year Year
+/// @param [out] month Month (1 through 12)
+/// @param [out] day Day of month (1 through 31)
+/// @param [out] yday Day of year (0 through 365)
+/// @param [out] wday Day of week (0 through 6, Sunday = 0)
+/// @remark Inverse of tm_daysfromcivil32().
+static inline void
+tm_civilfromdays32 (int32_t days, int32_t *year, uint32_t *month, uint32_t *day, uint32_t *yday, uint32_t *wday)
 {
-  char *tz = getenv ("TZ");
-
-  // getenv() returns a pointer to a string within the environment list which should not be modified.
-  // The string pointed to by the return value of getenv() may be statically allocated.
-
-  if (tz)
-    tz = strdup (tz);
-
-  /* If the TZ variable does appear in the environment, and its value is empty, then Coordinated Universal Time (UTC) is used.
-   * But setenv to empty timezone ("") can not be used here because, in this case, mktime () would convert to "UTC" timezone.
-   * Behavior is therefore not consistent with gmtime() which converts to "GMT" timezone */
-  if (setenv ("TZ", tm_utctimezone (), 1) != 0)
-    return (time_t) - 1;
-
-  tzset ();
+  uint32_t n = (uint32_t) (days + TM_CIVILEPOCH);
+  uint32_t n1 = 4 * n + 3;
+  uint32_t c = n1 / 146097;     // Century
+  uint64_t p2 = UINT64_C (2939745) * (n1 % 146097 | 3);
+  uint32_t ny = (uint32_t) p2 / 2939745 / 4;    // Day of year, from March 1st
+  uint32_t n3 = 2141 * ny + 197913;
+  uint32_t j = ny >= 306;       // January or February, counted as months 13 and 14 of the previous year
+  uint32_t y = 100 * c + (uint32_t) (p2 >> 32) + j;
+  uint32_t leap = (y % 4 == 0) & ((y % 100 != 0) | (y % 400 == 0));
+
+  *year = (int32_t) y - 400 * TM_CIVILERAS;
+  *month = j ? (n3 >> 16) - 12 : n3 >> 16;
+  *day = (n3 & 0xFFFF) / 2141 + 1;
+  *yday = j ? ny - 306 : ny + 59 + leap;
+  *wday = (n + 3) % 7;          // 1970-01-01 was a Thursday
+}
 
-  time_t ret = mktime (tm);
+/// Returns the dates of an array of numbers of days after 1970-01-01 (see tm_civilfromdays32()).
+/// @remark Vectorized where the instruction set allows it.
+TM_TARGET_CLONES static void
+tm_civilfromdays_n (size_t n, const int32_t *restrict days, int32_t *restrict year, uint32_t *restrict month,
+                    uint32_t *restrict day, uint32_t *restrict yday, uint32_t *restrict wday)
+{
+  for (size_t i = 0; i < n; i++)
+    tm_civilfromdays32 (days[i], &year[i], &month[i], &day[i], &yday[i], &wday[i]);
+}
 
-  if (tz)
-    setenv ("TZ", tz, 1);
-  else
-    unsetenv ("TZ");
+/// Truncates an array of dates and times to the beginning of their buckets, without branches in the loops.
+/// @param [in] n Number of dates and times
+/// @param [in,out] days Numbers of days since 1970-01-01 (TM_CIVILMINDAYS through TM_CIVILMAXDAYS)
+/// @param [in,out] secs Seconds of day (0 through 86399)
+/// @param [in] unit Unit of buckets
+/// @param [in] width Width of buckets, in seconds, for units of minutes and hours
+/// @remark Vectorized where the instruction set allows it.
+TM_TARGET_CLONES static void
+tm_bucketfloor_n (size_t n, int32_t *restrict days, int32_t *restrict secs, tm_bucketunit unit, int32_t width)
+{
+  switch (unit)
+  {
+    case TM_BUCKET_MINUTE:
+    case TM_BUCKET_HOUR:
+      for (size_t i = 0; i < n; i++)
+        secs[i] -= secs[i] % width;
+      break;
+    case TM_BUCKET_DAY:
+      for (size_t i = 0; i < n; i++)
+        secs[i] = 0;
+      break;
+    case TM_BUCKET_WEEK:
+      for (size_t i = 0; i < n; i++)
+      {
+        days[i] -= (int32_t) (((uint32_t) (days[i] + TM_CIVILEPOCH) + 2) % 7);  // Days since Monday
+        secs[i] = 0;
+      }
+      break;
+    default:
+    {
+      uint32_t months = unit == TM_BUCKET_MONTH ? 1 : unit == TM_BUCKET_QUARTER ? 3 : 12;
 
-  tzset ();
+      for (size_t i = 0; i < n; i++)
+      {
+        int32_t year;
+        uint32_t month, day, yday, wday;
 
-  return ret;
+        tm_civilfromdays32 (days[i], &year, &month, &day, &yday, &wday);
+        days[i] = tm_daysfromcivil32 (year, month - (month - 1) % months, 1);
+        secs[i] = 0;
+      }
+    }
+  }
 }
 
-/*****************************************************
-*   CONSTRUCTORS                                     *
-*****************************************************/
-static time_t tm_normalize (struct tm *date);
-
-tm_status
-tm_makenow (struct tm *tm)
+/// Returns the number of days elapsed since 1970-01-01 at a date of the proleptic Gregorian calendar.
+/// @param [in] year Year
+/// @param [in] month Month (1 through 12)
+/// @param [in] day Day of month (1 through 31)
+/// @returns Number of days since 1970-01-01 (negative before)
+/// @remark Years out of the range of tm_daysfromcivil32() are brought back by whole 400-year cycles (146097 days)
+/// to tm_getdayssinceepoch().
+static long long
+tm_daysfromcivil (long long year, unsigned int month, unsigned int day)
 {
-  time_t now;
+  if (year >= TM_CIVILMINYEAR && year <= TM_CIVILMAXYEAR)
+    return tm_daysfromcivil32 ((int32_t) year, month, day);
 
-  errno = 0;
-  if (time (&now) == (time_t) - 1 && errno)
-    return TM_ERROR;
+  long long cycles = year / 400;
 
-  tzset ();
-  localtime_r (&now, tm);
-  return TM_OK;
+  return tm_getdayssinceepoch ((int) (year - cycles * 400), (tm_month) month, (int) day) + cycles * 146097;
 }
 
-tm_status
-tm_maketoday (struct tm * tm)
+/// Returns the date of the proleptic Gregorian calendar a number of days after 1970-01-01.
+/// @param [in] days Number of days since 1970-01-01
+/// @param [out] year Year
+/// @param [out] month Month (1 through 12)
+/// @param [out] day Day of month (1 through 31)
+/// @remark Inverse of tm_daysfromcivil().
+static void
+tm_civilfromdays (long long days, long long *year, unsigned int *month, unsigned int *day)
 {
-  if (tm_makenow (tm) == TM_ERROR)
-    return TM_ERROR;
-  else
-    return tm_trimtime (tm);
-}
+  if (days >= TM_CIVILMINDAYS && days <= TM_CIVILMAXDAYS)
+  {
+    int32_t y;
+    uint32_t yday, wday;
 
-tm_status
-tm_makelocal (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
-{
-  tm->tm_year = year - 1900;
-  tm->tm_mon = month - 1;
-  tm->tm_mday = day;
-  tm->tm_hour = hour;
-  tm->tm_min = min;
-  tm->tm_sec = sec;
-  tm->tm_isdst = -1;            // Let timezone information and system databases define DST flag.
+    tm_civilfromdays32 ((int32_t) days, &y, month, day, &yday, &wday);
+    *year = y;
+    return;
+  }
 
-  errno = 0;
-  time_t ret = tm_normalizetolocal (tm);        // Normalize
+  days += 719468;
 
-  if (tm->tm_year == year - 1900 && tm->tm_mon == month - 1 && tm->tm_mday == day && tm->tm_hour == hour
-      && tm->tm_min == min && tm->tm_sec == sec)
-    return ret != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
-  else
-    return TM_ERROR;
+  long long era = (days >= 0 ? days : days - 146096) / 146097;
+  unsigned int doe = (unsigned int) (days - era * 146097);      // [0, 146096]
+  unsigned int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;     // [0, 399]
+  unsigned int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);   // [0, 365]
+  unsigned int mp = (5 * doy + 2) / 153;        // [0, 11], March = 0
+
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = (long long) yoe + era * 400 + (*month <= 2);
 }
 
-/// Initialize instant in time with absolute calendar time.
-/// @param [in] timep Absolute calendar time
-/// @param [out] tm Pointer to broken-down time structure
-/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
-/// @remark Default representation is set to local.
-static tm_status
-tm_makelocalfromcalendartime (time_t timep, struct tm *tm)
+/// Returns date and time attributes, in seconds since 1970-01-01 00:00:00, as if they were expressed in UTC.
+/// @param [in] tm Pointer to broken-down time structure
+/// @remark Structure members outside their valid interval are normalized as mktime() would (40 October is changed into 9 November.)
+static long long
+tm_linearseconds (const struct tm *tm)
 {
-  // data type time_t represents calendar time. which is the number of seconds elapsed since 1970-01-01 00:00:00 UTC.
-  tzset ();
-  return localtime_r (&timep, tm) ? TM_OK : TM_ERROR;
+  // Months are carried over to years first, then the other attributes are added up linearly, whatever their range.
+  long long year = (long long) tm->tm_year + 1900 + tm->tm_mon / 12;
+  int mon = tm->tm_mon % 12;
+
+  if (mon < 0)
+  {
+    mon += 12;
+    year--;
+  }
+
+  return (((tm_daysfromcivil (year, (unsigned int) mon + 1, 1) + tm->tm_mday - 1) * 24 + tm->tm_hour) * 60
+          + tm->tm_min) * 60 + tm->tm_sec;
 }
 
-/// Initializes instant in time with absolute calendar time.
-/// @param [in] timep Absolute calendar time
+/// Breaks down calendar time into UTC date and time attributes.
+/// @param [in] t Absolute calendar time
 /// @param [out] tm Pointer to broken-down time structure
 /// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
-/// @remark Default representation is set to UTC.
+/// @remark Arithmetic equivalent of gmtime_r(), without any system call.
 static tm_status
-tm_makeutcfromcalendartime (time_t timep, struct tm *tm)
+tm_breakdownutc (long long t, struct tm *tm)
 {
-  // data type time_t represents calendar time. which is the number of seconds elapsed since 1970-01-01 00:00:00 UTC.
-  return gmtime_r (&timep, tm) ? TM_OK : TM_ERROR;
-}
+  long long days = (t >= 0 ? t : t - 86399) / 86400;
+  int secs = (int) (t - days * 86400);
 
-tm_status
-tm_makeutc (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
-{
-  struct tm date;
+  if (days >= TM_CIVILMINDAYS && days <= TM_CIVILMAXDAYS)
+  {
+    int32_t year;
+    uint32_t month, day, yday, wday;
+
+    tm_civilfromdays32 ((int32_t) days, &year, &month, &day, &yday, &wday);
+    tm->tm_year = year - 1900;
+    tm->tm_mon = (int) month - 1;
+    tm->tm_mday = (int) day;
+    tm->tm_wday = (int) wday;
+    tm->tm_yday = (int) yday;
+  }
+  else
+  {
+    long long year;
+    unsigned int month, day;
 
-  if (!tm)
-    tm = &date;
+    tm_civilfromdays (days, &year, &month, &day);
+    if (year - 1900 > INT_MAX || year - 1900 < INT_MIN)
+    {
+      errno = EOVERFLOW;
+      return TM_ERROR;
+    }
 
-  tm->tm_year = year - 1900;
-  tm->tm_mon = month - 1;
-  tm->tm_mday = day;
-  tm->tm_hour = hour;
-  tm->tm_min = min;
-  tm->tm_sec = sec;
+    tm->tm_year = (int) (year - 1900);
+    tm->tm_mon = (int) month - 1;
+    tm->tm_mday = (int) day;
+    tm->tm_wday = (int) ((days % 7 + 11) % 7);  /* 1970-01-01 was a Thursday */
+    tm->tm_yday = (int) (days - tm_daysfromcivil (year, 1, 1));
+  }
 
-  errno = 0;
-  time_t ret = tm_normalizetoutc (tm);  /* Normalize, ignoring date timezone and saving daylight */
+  tm->tm_hour = secs / 3600;
+  tm->tm_min = secs / 60 % 60;
+  tm->tm_sec = secs % 60;
+  tm->tm_isdst = 0;
+  tm->tm_gmtoff = 0;
+  tm->tm_zone = tm_utctimezone ();
 
-  if (tm->tm_year == year - 1900 && tm->tm_mon == month - 1 && tm->tm_mday == day && tm->tm_hour == hour
-      && tm->tm_min == min && tm->tm_sec == sec)
-    return ret != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
-  else
-    return TM_ERROR;
+  return TM_OK;
 }
 
-tm_status
-tm_setdatefromstring (struct tm * tm, const char *buf)
+/// Initializes instant in time from UTC date and time data.
+/// @param [in,out] tm Pointer to broken-down time structure
+/// @returns Absolute calendar time
+/// @remark Arithmetic equivalent of timegm(): no system call, no access to environment variable TZ and no allocation.
+/// Structure members outside their valid interval are normalized as mktime() would (40 October is changed into 9 November.)
+/// @see man mktime and timegm
+static time_t
+tm_normalizetoutc (struct tm *tm)
 {
-  char *ret;
-
-  ret = strptime (buf, "%x", tm);
-  if (!ret || *ret)
-    ret = strptime (buf, "%Ex", tm);
-  if (!ret || *ret)
-    ret = strptime (buf, "%Y-%m-%d", tm);
-  if (!ret || *ret)
-    return TM_ERROR;
-
-  int year = tm->tm_year + 1900;        /* tm_year is the number of years since 1900. */
+  long long t = tm_linearseconds (tm);
 
-  if (year >= 0 && year < 100)
+  if ((long long) (time_t) t != t || tm_breakdownutc (t, tm) == TM_ERROR)
   {
-    time_t now;
-
-    time (&now);
-    int current_year = localtime (&now)->tm_year + 1900;        /* tm_year is the number of years since 1900. */
-
-    tm->tm_year += lround ((current_year - year) / 100.) * 100;
+    errno = EOVERFLOW;
+    return (time_t) - 1;
   }
 
-  tm->tm_isdst = -1;
-
-  struct tm copy = *tm;
-
-  errno = 0;
-  time_t retval = tm_normalize (tm);
-
-  if (tm->tm_year == copy.tm_year && tm->tm_mon == copy.tm_mon && tm->tm_mday == copy.tm_mday
-      && tm->tm_hour == copy.tm_hour && tm->tm_min == copy.tm_min && tm->tm_sec == copy.tm_sec)
-    return retval != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
-  else
-    return TM_ERROR;
+  return (time_t) t;
 }
 
-tm_status
-tm_settimefromstring (struct tm * tm, const char *buf)
-{
-  char *ret;
+/*****************************************************
+*   TIMEZONE RULES                                   *
+*****************************************************/
 
-  tm->tm_hour = tm->tm_min = tm->tm_sec = 0;
-  ret = strptime (buf, "%X", tm);
-  if (!ret || *ret)
-    ret = strptime (buf, "%EX", tm);
-  if (!ret || *ret)
-    ret = strptime (buf, "%T", tm);
-  if (!ret || *ret)
-    ret = strptime (buf, "%R", tm);
-  if (!ret || *ret)
-    return TM_ERROR;
+#ifndef TM_TZDIR
+/// Default directory of the timezone database, used when environment variable TZDIR is not set.
+#  define TM_TZDIR "/usr/share/zoneinfo"
+#endif
 
-  tm->tm_isdst = -1;
+#ifndef TM_TZDEFAULT
+/// Timezone file used when environment variable TZ is not set.
+#  define TM_TZDEFAULT "/etc/localtime"
+#endif
 
-  struct tm copy = *tm;
+#ifndef TM_TZRULESLASTYEAR
+/// Last year up to which recurring daylight saving time rules (POSIX TZ string) are compiled into transitions.
+/// Later instants are handled by mktime() and localtime_r().
+#  define TM_TZRULESLASTYEAR 2200
+#endif
 
-  errno = 0;
-  time_t retval = tm_normalize (tm);
+/// Local time type of a timezone.
+typedef struct
+{
+  long int utcoffset;           ///< Offset to UTC, in seconds
+  int isdst;                    ///< Daylight saving time flag
+  const char *abbreviation;     ///< Abbreviation (statically allocated for the lifetime of the process)
+} tm_localtimetype;
+
+/// Compiled timezone rules: the transition table of a timezone, read once from the timezone database.
+/// Compiled timezones are cached and never released, so that they can be used without any lock.
+struct tm_timezone
+{
+  char *name;                   ///< Timezone, as specified by environment variable TZ
+  long long since;              ///< Rules are known for instants in [since, until)
+  long long until;              ///< Rules are known for instants in [since, until)
+  size_t nbtransitions;         ///< Number of transitions
+  long long *transitions;       ///< Transition instants, in ascending order
+  unsigned char *types;         ///< Index of the local time type in effect from each transition on
+  unsigned char initial;        ///< Index of the local time type in effect before the first transition
+  size_t nbtypes;               ///< Number of local time types
+  tm_localtimetype *localtimetypes;     ///< Local time types
+  uint32_t id;                  ///< Identifier of the timezone in records (see tm_timezoneid()), 0 if it has none
+  struct tm_timezone *next;     ///< Next compiled timezone in cache
+};
+
+/// Identifies a timezone in records (see tm_torecord()): FNV-1a hash of its canonical name (see tm_canonicaltimezonename()),
+/// stable from one process or host to the next.
+/// @param [in] name Canonical name of the timezone
+/// @returns Identifier, never 0 (reserved for UTC)
+static uint32_t
+tm_timezoneid (const char *name)
+{
+  uint32_t h = 2166136261u;
 
-  if (tm->tm_year == copy.tm_year && tm->tm_mon == copy.tm_mon && tm->tm_mday == copy.tm_mday
-      && tm->tm_hour == copy.tm_hour && tm->tm_min == copy.tm_min && tm->tm_sec == copy.tm_sec)
-    return retval != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
-  else
-    return TM_ERROR;
+  for (const unsigned char *c = (const unsigned char *) name; *c; c++)
+    h = (h ^ *c) * 16777619u;
+
+  return h ? h : 1;
 }
 
-tm_status
-tm_gettimeintostring (struct tm dt, char *str, size_t max)
+/// Gets the name of a timezone the same whatever the way it is specified by environment variable TZ.
+/// Files of the timezone database are named by their path relative to the database, symbolic links resolved:
+/// "Europe/Paris", ":Europe/Paris", "/usr/share/zoneinfo/Europe/Paris" and "/etc/localtime" linked to it are all "Europe/Paris".
+/// POSIX TZ strings are their own name.
+/// @param [in] name Timezone, as specified by environment variable TZ
+/// @returns Canonical name, to be freed, or 0 if the timezone has no name valid from one host to another
+/// (unknown timezone, or file out of the timezone database, such as a copy of a zone in /etc/localtime)
+static char *
+tm_canonicaltimezonename (const char *name)
 {
-  return strftime (str, max, "%X", &dt) ? TM_OK : TM_ERROR;
+  const char *file = *name == ':' ? name + 1 : name;
+  const char *dir = getenv ("TZDIR") ? getenv ("TZDIR") : TM_TZDIR;
+  char path[4096], *resolved = 0, *resolveddir = 0, *canonical = 0;
+  size_t len;
+
+  if (*file == '/')
+    resolved = realpath (file, 0);
+  else if (*file && !strstr (file, "..") && snprintf (path, sizeof (path), "%s/%s", dir, file) < (int) sizeof (path))
+    resolved = realpath (path, 0);
+
+  if (!resolved)
+    canonical = *name != ':' && *name != '/' ? strdup (name) : 0;     // POSIX TZ string
+  else if ((resolveddir = realpath (dir, 0)) && !strncmp (resolved, resolveddir, len = strlen (resolveddir))
+           && resolved[len] == '/')
+    canonical = strdup (resolved + len + 1);
+
+  free (resolveddir);
+  free (resolved);
+
+  return canonical;
 }
 
-tm_status
-tm_getdateintostring (struct tm dt, char *str, size_t max)
+/// Cache of compiled timezones, shared by all threads.
+static _Atomic (tm_timezone *) tm_timezones = 0;
+
+/// Abbreviation of a local time type, allocated with the compiled timezone it belongs to.
+typedef struct
 {
-  return strftime (str, max, "%x", &dt) ? TM_OK : TM_ERROR;
+  const tm_timezone *owner;     ///< Compiled timezone
+  char name[];                  ///< Abbreviation, pointed to by tm_zone
+} tm_abbreviation;
+
+#ifndef TM_ABBREVIATIONSLOTS
+/// Number of slots of the table of abbreviations of compiled timezones (a power of 2).
+#  define TM_ABBREVIATIONSLOTS 4096
+#endif
+
+/// Abbreviations of compiled timezones, by address: open addressing, insert-only and lock-free.
+/// The table is kept at most 3/4 full. Abbreviations that do not fit are found by scanning the cache of compiled timezones.
+static _Atomic (const char *) tm_abbreviations[TM_ABBREVIATIONSLOTS];
+static atomic_size_t tm_nbabbreviations = 0;
+static atomic_int tm_abbreviationsoverflow = 0;
+
+/// Gets the slot of an abbreviation in the table of abbreviations of compiled timezones.
+static size_t
+tm_abbreviationslot (const char *abbreviation)
+{
+  return (size_t) (((uint64_t) (uintptr_t) abbreviation * 0x9E3779B97F4A7C15ULL) >> 32) & (TM_ABBREVIATIONSLOTS - 1);
 }
 
-/*****************************************************
-*   CONVERTERS                                       *
-*****************************************************/
-tm_status
-tm_toutcrepresentation (struct tm * date)
+/// Registers the abbreviation of a local time type in the table of abbreviations of compiled timezones.
+static void
+tm_internabbreviation (const char *abbreviation)
 {
-  if (tm_islocalrepresentation (*date))
+  if (atomic_fetch_add (&tm_nbabbreviations, 1) >= TM_ABBREVIATIONSLOTS / 4 * 3)
   {
-    errno = 0;
-    time_t local = tm_normalizetolocal (date);
+    atomic_store (&tm_abbreviationsoverflow, 1);
+    return;
+  }
 
-    if (local != (time_t) - 1 || !errno)
-      return tm_makeutcfromcalendartime (local, date);
-    else
-      return TM_ERROR;
+  for (size_t i = tm_abbreviationslot (abbreviation);; i = (i + 1) & (TM_ABBREVIATIONSLOTS - 1))
+  {
+    const char *empty = 0;
+
+    if (atomic_compare_exchange_strong (&tm_abbreviations[i], &empty, abbreviation))
+      return;
   }
-  else
-    return TM_OK;
 }
 
-tm_status
-tm_tolocalrepresentation (struct tm * date)
+/// Gets the compiled timezone a timezone abbreviation belongs to, in constant time.
+/// @param [in] abbreviation Timezone abbreviation, as pointed to by \p tm_zone
+/// @returns Compiled timezone, or 0 if \p abbreviation is not the abbreviation of a local time type of a compiled timezone
+/// @remark Abbreviations are identified by address, not by spelling: "CET" of Europe/Paris does not belong to Europe/Berlin.
+static const tm_timezone *
+tm_abbreviationowner (const char *abbreviation)
 {
-  if (tm_isutcrepresentation (*date))
+  if (!abbreviation)
+    return 0;
+
+  // The table always has empty slots: the search stops.
+  for (size_t i = tm_abbreviationslot (abbreviation);; i = (i + 1) & (TM_ABBREVIATIONSLOTS - 1))
   {
-    errno = 0;
-    time_t utc = tm_normalizetoutc (date);
+    const char *a = atomic_load (&tm_abbreviations[i]);
 
-    if (utc != (time_t) - 1 || !errno)
-      return tm_makelocalfromcalendartime (utc, date);
-    else
-      return TM_ERROR;
+    if (a == abbreviation)
+      return ((const tm_abbreviation *) (a - offsetof (tm_abbreviation, name)))->owner;
+    if (!a)
+      break;
   }
-  else
-    return TM_OK;
-}
 
-/// Normalizes instant in time.
-/// @param [in,out] date Pointer to broken-down time structure
-/// @returns Absolute calendar time
-static time_t
-tm_normalize (struct tm *date)
-{
-  if (tm_isutcrepresentation (*date))
-    return tm_normalizetoutc (date);
-  else
-    return tm_normalizetolocal (date);
-}
+  if (atomic_load (&tm_abbreviationsoverflow))
+    for (const tm_timezone * tz = atomic_load (&tm_timezones); tz; tz = tz->next)
+      for (size_t i = 0; i < tz->nbtypes; i++)
+        if (tz->localtimetypes[i].abbreviation == abbreviation)
+          return tz;
 
-/*****************************************************
-*   CALENDAR PROPERTIES                              *
-*****************************************************/
+  return 0;
+}
 
-int
-tm_isleapyear (int year)
+/// Reads a big-endian 32-bit unsigned integer.
+static uint32_t
+tm_readuint32 (const unsigned char *p)
 {
-  // Nonzero if year is a leap year (every 4 years, except every 100th isn't, and every 400th is).
-  return year % 400 == 0 || (year % 4 == 0 && year % 100 != 0);
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
 }
 
-int
-tm_getweeksinisoyear (int isoyear)
+/// Reads a big-endian 32-bit signed integer.
+static long long
+tm_readint32 (const unsigned char *p)
 {
-  struct tm date;
-
-  if (tm_makelocal (&date, isoyear + 1, TM_MONTH_JANUARY, 4, 0, 0, 0) == TM_ERROR || tm_adddays (&date, -7) == TM_ERROR)
-    return -1;
+  unsigned long u = (unsigned long) p[0] << 24 | (unsigned long) p[1] << 16 | (unsigned long) p[2] << 8 | p[3];
 
-  return tm_getisoweek (date);
+  return u & 0x80000000UL ? (long long) u - 0x100000000LL : (long long) u;
 }
 
-int
-tm_getdaysinmonth (int year, tm_month month)
+/// Reads a big-endian 64-bit signed integer.
+static long long
+tm_readint64 (const unsigned char *p)
 {
-  int ret = 1;
+  unsigned long long u = 0;
 
-  struct tm date;
-
-  if (tm_makelocal (&date, year, month, 1, 0, 0, 0) == TM_ERROR)
-    return -1;
-
-  ret -= tm_getdayofyear (date);
-  tm_addmonths (&date, 1);
-  tm_adddays (&date, -1);
-  ret += tm_getdayofyear (date);
+  for (int i = 0; i < 8; i++)
+    u = u << 8 | p[i];
 
-  return ret;
+  return u & 0x8000000000000000ULL ? -(long long) ~u - 1 : (long long) u;
 }
 
-int
-tm_getsecondsinlocalday (int year, tm_month month, int day)
+/// Rule of a POSIX TZ string, defining when daylight saving time starts or ends.
+typedef struct
 {
-  long int ret = 0;
-
-  struct tm date;
+  char kind;                    ///< 'J' (Julian day, 1 through 365), 'D' (zero-based day of year) or 'M' (month, week, day)
+  int month;                    ///< Month (1 through 12)
+  int week;                     ///< Week of month (1 through 5, 5 meaning the last one)
+  int day;                      ///< Day of year, or day of week (0 = Sunday)
+  long int time;                ///< Local time of the change, in seconds
+} tm_tzrule;
+
+/// Parses a timezone abbreviation in a POSIX TZ string.
+/// @returns Pointer to the first character after the abbreviation, or 0 on error
+static const char *
+tm_parsetzname (const char *s, char *name, size_t max)
+{
+  const char *begin = s, *end;
 
-  if (tm_makelocal (&date, year, month, day, 0, 0, 0) == TM_ERROR)
-    return -1;
+  if (*s == '<')
+  {
+    for (begin = ++s; *s && *s != '>'; s++)
+      /* nothing */ ;
+    if (*s != '>')
+      return 0;
+    end = s++;
+  }
+  else
+  {
+    while ((*s >= 'A' && *s <= 'Z') || (*s >= 'a' && *s <= 'z'))
+      s++;
+    end = s;
+  }
 
-  ret = -tm_normalize (&date);
-  tm_adddays (&date, 1);
-  ret += tm_normalize (&date);
+  if (end - begin < 3 || (size_t) (end - begin) >= max)
+    return 0;
+  memcpy (name, begin, (size_t) (end - begin));
+  name[end - begin] = 0;
 
-  return (int) ret;
+  return s;
 }
 
-int
-tm_getfirstweekdayinmonth (int year, tm_month month, tm_dayofweek dow)
+/// Parses a time ([+|-]hh[:mm[:ss]]) in a POSIX TZ string.
+/// @returns Pointer to the first character after the time, or 0 on error
+static const char *
+tm_parsetztime (const char *s, long int *seconds)
 {
-  struct tm date;
+  int sign = 1;
+  long int value[3] = { 0, 0, 0 };
 
-  if (tm_makelocal (&date, year, month, 1, 0, 0, 0) == TM_ERROR)
-    return -1;
+  if (*s == '+' || *s == '-')
+    sign = *s++ == '-' ? -1 : 1;
+
+  for (int i = 0; i < 3; i++)
+  {
+    if (i && *s++ != ':')
+    {
+      s--;
+      break;
+    }
+    if (*s < '0' || *s > '9')
+      return 0;
+    for (; *s >= '0' && *s <= '9' && value[i] < 1000; s++)
+      value[i] = 10 * value[i] + *s - '0';
+  }
 
-  return (dow - tm_getdayofweek (date) + 7) % 7 + 1;
+  *seconds = sign * (value[0] * 3600 + value[1] * 60 + value[2]);
+  return value[0] <= 167 && value[1] < 60 && value[2] < 60 ? s : 0;
 }
 
-int
-tm_getlastweekdayinmonth (int year, tm_month month, tm_dayofweek dow)
+/// Parses a rule (Jn, n or Mm.w.d, optionally followed by /time) in a POSIX TZ string.
+/// @returns Pointer to the first character after the rule, or 0 on error
+static const char *
+tm_parsetzrule (const char *s, tm_tzrule *rule)
 {
-  struct tm date;
+  char *end;
 
-  int last = tm_getdaysinmonth (year, month);
-
-  if (tm_makelocal (&date, year, month, last, 0, 0, 0) == TM_ERROR)
-    return -1;
+  rule->kind = *s == 'J' || *s == 'M' ? *s++ : 'D';
+  if (rule->kind == 'M')
+  {
+    rule->month = (int) strtol (s, &end, 10);
+    if (end == s || *end != '.' || rule->month < 1 || rule->month > 12)
+      return 0;
+    s = end + 1;
+    rule->week = (int) strtol (s, &end, 10);
+    if (end == s || *end != '.' || rule->week < 1 || rule->week > 5)
+      return 0;
+    s = end + 1;
+    rule->day = (int) strtol (s, &end, 10);
+    if (end == s || rule->day < 0 || rule->day > 6)
+      return 0;
+  }
+  else
+  {
+    if (*s < '0' || *s > '9')
+      return 0;
+    rule->day = (int) strtol (s, &end, 10);
+    if (rule->day < (rule->kind == 'J') || rule->day > 365)
+      return 0;
+  }
+  s = end;
 
-  int diff = dow - tm_getdayofweek (date);
+  rule->time = 2 * 3600;
+  if (*s == '/')
+    s = tm_parsetztime (s + 1, &rule->time);
 
-  return last + diff + (diff > 0 ? -7 : 0);
+  return s;
 }
 
-int
-tm_getfirstweekdayinisoyear (int isoyear, tm_dayofweek dow)
+/// Returns the instant at which a rule of a POSIX TZ string applies in a year.
+/// @param [in] rule Rule
+/// @param [in] year Year
+/// @param [in] utcoffset Offset to UTC in effect before the rule applies
+static long long
+tm_tzruleinstant (const tm_tzrule *rule, long long year, long int utcoffset)
 {
-  struct tm date;
-
-  int ret = tm_getfirstweekdayinmonth (isoyear, TM_MONTH_JANUARY, dow) + 7;
+  long long day = tm_daysfromcivil (year, 1, 1);
+  int leap = year % 400 == 0 || (year % 4 == 0 && year % 100 != 0);
 
-  if (tm_makelocal (&date, isoyear, TM_MONTH_JANUARY, ret, 0, 0, 0) == TM_ERROR)
-    return -1;
+  switch (rule->kind)
+  {
+    case 'J':                  // February, the 29th, is never counted.
+      day += rule->day - 1 + (leap && rule->day >= 60);
+      break;
+    case 'D':
+      day += rule->day;
+      break;
+    default:
+    {
+      static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+      int length = days[rule->month - 1] + (leap && rule->month == 2);
 
-  return ret + 7 - 7 * tm_getisoweek (date);
-}
+      day = tm_daysfromcivil (year, (unsigned int) rule->month, 1);
+      int mday = (int) ((rule->day - (day % 7 + 11) % 7 + 7) % 7) + 7 * (rule->week - 1);
 
-/*****************************************************
-*   DATE PROPERTIES                                  *
-*****************************************************/
+      while (mday >= length)
+        mday -= 7;
+      day += mday;
+    }
+  }
 
-tm_dayofweek
-tm_getdayofweek (struct tm date)
-{
-  return (date.tm_wday + 6) % 7 + 1;    /* Monday = 1, Sunday = 7 */
+  return day * 86400 + rule->time - utcoffset;
 }
 
-tm_month
-tm_getmonth (struct tm date)
+/// Builds compiled timezone rules.
+typedef struct
 {
-  return date.tm_mon + 1;       /* January = 1, December = 12 */
-}
+  tm_timezone *tz;              ///< Compiled timezone under construction
+  size_t maxtransitions;        ///< Allocated number of transitions
+  char *abbreviations;          ///< Abbreviations
+  size_t nbabbreviations;       ///< Size of abbreviations
+} tm_timezonebuilder;
 
-int
-tm_getyear (struct tm date)
+/// Appends a transition to compiled timezone rules.
+static tm_status
+tm_addtransition (tm_timezonebuilder *b, long long t, size_t type)
 {
-  return date.tm_year + 1900;
-}
+  tm_timezone *tz = b->tz;
 
-int
-tm_getday (struct tm date)
-{
-  return date.tm_mday;
+  if (tz->nbtransitions
+      && (t <= tz->transitions[tz->nbtransitions - 1] || tz->types[tz->nbtransitions - 1] == type))
+    return TM_OK;
+
+  if (tz->nbtransitions == b->maxtransitions)
+  {
+    size_t max = 2 * b->maxtransitions + 64;
+    long long *transitions = realloc (tz->transitions, max * sizeof (*transitions));
+
+    if (transitions)
+      tz->transitions = transitions;
+    unsigned char *types = realloc (tz->types, max);
+
+    if (types)
+      tz->types = types;
+    if (!transitions || !types)
+      return TM_ERROR;
+    b->maxtransitions = max;
+  }
+
+  tz->transitions[tz->nbtransitions] = t;
+  tz->types[tz->nbtransitions++] = (unsigned char) type;
+
+  return TM_OK;
 }
 
-int
-tm_gethour (struct tm date)
+/// Appends a local time type to compiled timezone rules, or finds an identical one.
+/// @returns Index of the local time type, or -1 on error
+static int
+tm_addlocaltimetype (tm_timezonebuilder *b, long int utcoffset, int isdst, const char *abbreviation)
 {
-  return date.tm_hour;
+  tm_timezone *tz = b->tz;
+  size_t i;
+
+  for (i = 0; i < tz->nbtypes; i++)
+    if (tz->localtimetypes[i].utcoffset == utcoffset && !tz->localtimetypes[i].isdst == !isdst
+        && !strcmp (tz->localtimetypes[i].abbreviation, abbreviation))
+      return (int) i;
+
+  if (i > UCHAR_MAX)
+    return -1;
+
+  size_t len = strlen (abbreviation) + 1;
+  tm_localtimetype *types = realloc (tz->localtimetypes, (i + 1) * sizeof (*types));
+  tm_abbreviation *abbreviations = malloc (sizeof (*abbreviations) + len);  // Never released, as tm_zone might point to it.
+
+  if (types)
+    tz->localtimetypes = types;
+  if (!types || !abbreviations)
+  {
+    free (abbreviations);
+    return -1;
+  }
+
+  abbreviations->owner = tz;
+  types[i].utcoffset = utcoffset;
+  types[i].isdst = isdst;
+  types[i].abbreviation = memcpy (abbreviations->name, abbreviation, len);
+  tz->nbtypes++;
+  tm_internabbreviation (types[i].abbreviation);
+
+  return (int) i;
 }
 
-int
-tm_getminute (struct tm date)
+/// Compiles the rules of a POSIX TZ string (such as "CET-1CEST,M3.5.0,M10.5.0/3") from a given year on.
+/// @param [in,out] b Compiled timezone under construction
+/// @param [in] tzstring POSIX TZ string
+/// @param [in] from First year the rules apply to
+/// @param [in] after Rules only apply after this instant
+/// @returns \p TM_OK or \p TM_ERROR (invalid TZ string)
+static tm_status
+tm_compiletzstring (tm_timezonebuilder *b, const char *tzstring, long long from, long long after)
 {
-  return date.tm_min;
+  char stdname[64], dstname[64];
+  long int stdoffset, dstoffset;
+  tm_tzrule start = { 'M', 3, 2, 0, 2 * 3600 }, end = { 'M', 11, 1, 0, 2 * 3600 };       // POSIX default rules
+  const char *s = tzstring;
+
+  if (!(s = tm_parsetzname (s, stdname, sizeof (stdname))) || !(s = tm_parsetztime (s, &stdoffset)))
+    return TM_ERROR;
+
+  int stdtype = tm_addlocaltimetype (b, -stdoffset, 0, stdname);
+
+  if (stdtype < 0)
+    return TM_ERROR;
+
+  if (!*s)
+  {
+    // No daylight saving time
+    if (!b->tz->nbtransitions)
+      b->tz->initial = (unsigned char) stdtype;
+    else if (tm_addtransition (b, after + 1, (size_t) stdtype) == TM_ERROR)
+      return TM_ERROR;
+    return TM_OK;
+  }
+
+  if (!(s = tm_parsetzname (s, dstname, sizeof (dstname))))
+    return TM_ERROR;
+  dstoffset = stdoffset - 3600;
+  if (*s && *s != ',' && !(s = tm_parsetztime (s, &dstoffset)))
+    return TM_ERROR;
+  if (*s == ',' && (!(s = tm_parsetzrule (s + 1, &start)) || *s != ',' || !(s = tm_parsetzrule (s + 1, &end))))
+    return TM_ERROR;
+  if (*s)
+    return TM_ERROR;
+
+  int dsttype = tm_addlocaltimetype (b, -dstoffset, 1, dstname);
+
+  if (dsttype < 0)
+    return TM_ERROR;
+
+  if (!b->tz->nbtransitions)
+    b->tz->initial = (unsigned char) stdtype;
+
+  for (long long year = from; year <= TM_TZRULESLASTYEAR; year++)
+  {
+    long long tstart = tm_tzruleinstant (&start, year, -stdoffset);
+    long long tend = tm_tzruleinstant (&end, year, -dstoffset);
+    int southern = tend < tstart;       // Daylight saving time at the beginning and at the end of the year
+
+    if ((tm_addtransition (b, southern ? tend : tstart, (size_t) (southern ? stdtype : dsttype)) == TM_ERROR)
+        || (tm_addtransition (b, southern ? tstart : tend, (size_t) (southern ? dsttype : stdtype)) == TM_ERROR))
+      return TM_ERROR;
+  }
+  b->tz->until = tm_daysfromcivil (TM_TZRULESLASTYEAR + 1, 1, 1) * 86400;
+
+  return TM_OK;
 }
 
-int
-tm_getsecond (struct tm date)
+#ifndef TM_TZIFMAXCOUNT
+/// Maximum number of elements (transitions, local time types, characters of abbreviations...) of TZif files.
+#  define TM_TZIFMAXCOUNT (1 << 20)
+#endif
+
+/// Compiles the content of a TZif file (RFC 8536, versions 1 to 4).
+/// @param [in,out] b Compiled timezone under construction
+/// @param [in] data Content of the file
+/// @param [in] size Size of the content
+/// @returns \p TM_OK or \p TM_ERROR (invalid or unsupported content)
+static tm_status
+tm_compiletzif (tm_timezonebuilder *b, const unsigned char *data, size_t size)
 {
-  return date.tm_sec;
+  const unsigned char *p = data, *end = data + size;
+  int version = 1;
+  size_t isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+  size_t timesize = 4;
+
+  for (;;)
+  {
+    if (end - p < 44 || memcmp (p, "TZif", 4))
+      return TM_ERROR;
+    if (p[4] >= '2')
+      version = 2;
+    // Counts are unsigned: files from an absolute TZ path are not trusted further than their size.
+    isutcnt = tm_readuint32 (p + 20);
+    isstdcnt = tm_readuint32 (p + 24);
+    leapcnt = tm_readuint32 (p + 28);
+    timecnt = tm_readuint32 (p + 32);
+    typecnt = tm_readuint32 (p + 36);
+    charcnt = tm_readuint32 (p + 40);
+    p += 44;
+
+    if (typecnt == 0 || typecnt > UCHAR_MAX + 1 || isutcnt > typecnt || isstdcnt > typecnt || leapcnt > TM_TZIFMAXCOUNT
+        || timecnt > TM_TZIFMAXCOUNT || charcnt > TM_TZIFMAXCOUNT)
+      return TM_ERROR;
+
+    size_t datasize, n;
+
+    if (__builtin_mul_overflow (timecnt, timesize + 1, &datasize)
+        || __builtin_mul_overflow (typecnt, 6, &n) || __builtin_add_overflow (datasize, n, &datasize)
+        || __builtin_add_overflow (datasize, charcnt, &datasize)
+        || __builtin_mul_overflow (leapcnt, timesize + 4, &n) || __builtin_add_overflow (datasize, n, &datasize)
+        || __builtin_add_overflow (datasize, isstdcnt, &datasize) || __builtin_add_overflow (datasize, isutcnt, &datasize)
+        || (size_t) (end - p) < datasize)
+      return TM_ERROR;
+    if (version == 1 || timesize == 8)
+      break;
+    // Skip version 1 data block, in favour of 64-bit data.
+    p += datasize;
+    timesize = 8;
+  }
+
+  if (leapcnt)                  // Leap seconds are not supported (see mktime().)
+    return TM_ERROR;
+
+  const unsigned char *times = p;
+  const unsigned char *indices = times + timecnt * timesize;
+  const unsigned char *ttinfos = indices + timecnt;
+  const char *chars = (const char *) (ttinfos + typecnt * 6);
+  int map[UCHAR_MAX + 1];
+
+  for (size_t i = 0; i < typecnt; i++)
+  {
+    size_t idx = ttinfos[6 * i + 5];
+    char abbreviation[64];
+
+    if (idx >= charcnt)
+      return TM_ERROR;
+    strncpy (abbreviation, chars + idx, sizeof (abbreviation) - 1);
+    abbreviation[sizeof (abbreviation) - 1] = 0;
+    if ((map[i] = tm_addlocaltimetype (b, (long int) tm_readint32 (ttinfos + 6 * i), ttinfos[6 * i + 4], abbreviation)) < 0)
+      return TM_ERROR;
+  }
+  b->tz->initial = (unsigned char) map[0];
+
+  for (size_t i = 0; i < timecnt; i++)
+  {
+    if (indices[i] >= typecnt
+        || tm_addtransition (b, timesize == 8 ? tm_readint64 (times + 8 * i) : tm_readint32 (times + 4 * i),
+                             (size_t) map[indices[i]]) == TM_ERROR)
+      return TM_ERROR;
+  }
+
+  p = (const unsigned char *) chars + charcnt + leapcnt * (timesize + 4) + isstdcnt + isutcnt;
+
+  // Footer: POSIX TZ string for instants after the last transition.
+  if (version >= 2 && end - p > 2 && *p == '\n')
+  {
+    const unsigned char *nl = memchr (p + 1, '\n', (size_t) (end - p - 1));
+    char tzstring[256];
+
+    if (nl && nl - p > 1 && (size_t) (nl - p - 1) < sizeof (tzstring))
+    {
+      long long last = b->tz->nbtransitions ? b->tz->transitions[b->tz->nbtransitions - 1] : LLONG_MIN;
+      long long year;
+      unsigned int month, day;
+
+      memcpy (tzstring, p + 1, (size_t) (nl - p - 1));
+      tzstring[nl - p - 1] = 0;
+      tm_civilfromdays (last == LLONG_MIN ? 0 : (last >= 0 ? last : last - 86399) / 86400, &year, &month, &day);
+      if (tm_compiletzstring (b, tzstring, year, last) == TM_ERROR)
+        return TM_ERROR;
+    }
+  }
+
+  return TM_OK;
 }
 
-int
-tm_getdayofyear (struct tm date)
+/// Reads a file into memory.
+/// @returns Allocated content of the file, or 0 on error
+static unsigned char *
+tm_readfile (const char *path, size_t *size)
 {
-  return date.tm_yday + 1;      /* 1/1 = 1, 31/12 = 365 or 366 */
+  FILE *f = fopen (path, "rb");
+
+  if (!f)
+    return 0;
+
+  unsigned char *data = 0;
+  size_t max = 0;
+
+  *size = 0;
+  for (;;)
+  {
+    if (*size == max)
+    {
+      unsigned char *more = max < (1 << 20) ? realloc (data, max = 2 * max + 4096) : 0;
+
+      if (!more)
+      {
+        free (data);
+        data = 0;
+        break;
+      }
+      data = more;
+    }
+
+    size_t n = fread (data + *size, 1, max - *size, f);
+
+    *size += n;
+    if (n == 0)
+      break;
+  }
+  fclose (f);
+
+  return data;
 }
 
-int
-tm_getisoweek (struct tm date)
+/// Compiles timezone rules, from the timezone database or from a POSIX TZ string.
+/// @param [in] name Timezone, as specified by environment variable TZ (see "man tzset" for details on possible values)
+/// @returns Compiled timezone. Rules are empty (\p since equals \p until) if the timezone could not be compiled.
+static tm_timezone *
+tm_compiletimezone (const char *name)
 {
+  tm_timezone *tz = calloc (1, sizeof (*tz));
 
-  /** ISO 8601 week date: The first week of a year (starting on Monday) is :
-     - the first week that contains at least 4 days of calendar year.
-     - the week that contains the first Thursday of a year.
-     - the week with January 4 in it
-   */
+  if (!tz || !(tz->name = strdup (name)))
+  {
+    free (tz);
+    return 0;
+  }
 
-  int week = (date.tm_yday - (date.tm_wday + 6) % 7 + 10) / 7;
+  tm_timezonebuilder b = { tz, 0, 0, 0 };
+  const char *file = *name == ':' ? name + 1 : name;
+  char path[4096];
+  size_t size;
+  unsigned char *data = 0;
+  tm_status ret = TM_ERROR;
+
+  if (*file == '/')
+    data = tm_readfile (file, &size);
+  else if (*file && !strstr (file, "..") && snprintf (path, sizeof (path), "%s/%s", getenv ("TZDIR") ? getenv ("TZDIR") : TM_TZDIR, file) < (int) sizeof (path))
+    data = tm_readfile (path, &size);
+
+  tz->since = LLONG_MIN;
+  tz->until = LLONG_MAX;
+  if (data)
+    ret = tm_compiletzif (&b, data, size);
+  else if (*name != ':')
+  {
+    // Not in the timezone database: POSIX TZ string, with rules applied from 1970 on (as localtime_r() does.)
+    ret = tm_compiletzstring (&b, name, 1970, LLONG_MIN);
+    if (ret == TM_OK && tz->nbtransitions)
+      tz->since = 0;
+  }
+  free (data);
 
-  if (week == 0)
-    return (date.tm_yday + 365 + tm_isleapyear (date.tm_year + 1900 - 1) - (date.tm_wday + 6) % 7 + 10) / 7;
-  else if (week > 52
-           && ((date.tm_yday - 365 - tm_isleapyear (date.tm_year + 1900) - (date.tm_wday + 6) % 7 + 10) / 7) > 0)
-    return (date.tm_yday - 365 - tm_isleapyear (date.tm_year + 1900) - (date.tm_wday + 6) % 7 + 10) / 7;
+  if (ret == TM_ERROR)
+  {
+    // Unknown timezone: left to mktime() and localtime_r().
+    tz->since = tz->until = 0;
+    tz->nbtransitions = 0;
+  }
   else
-    return week;
+  {
+    char *canonical = tm_canonicaltimezonename (name);
+
+    tz->id = canonical ? tm_timezoneid (canonical) : 0;
+    free (canonical);
+  }
+
+  return tz;
 }
 
-int
-tm_getisoyear (struct tm date)
+/// Gets compiled timezone rules from cache, or compiles them once.
+/// @param [in] name Timezone, as specified by environment variable TZ
+/// @returns Compiled timezone, or 0 if out of memory
+/// @remark Lock-free and thread-safe.
+static const tm_timezone *
+tm_findtimezone (const char *name)
 {
-  /* Year of which ISO week of date belongs to. */
-  int week = (date.tm_yday - (date.tm_wday + 6) % 7 + 10) / 7;
+  tm_timezone *head = atomic_load (&tm_timezones);
 
-  if (week == 0)
-    return date.tm_year + 1900 - 1;
-  else if (week > 52
-           && ((date.tm_yday - 365 - tm_isleapyear (date.tm_year + 1900) - (date.tm_wday + 6) % 7 + 10) / 7) > 0)
-    return date.tm_year + 1900 + 1;
-  else
-    return date.tm_year + 1900;
+  for (tm_timezone * tz = head; tz; tz = tz->next)
+    if (!strcmp (tz->name, name))
+      return tz;
+
+  tm_timezone *tz = tm_compiletimezone (name);
+
+  if (tz)
+  {
+    // Concurrent threads might compile the same timezone: duplicates are harmless.
+    tz->next = head;
+    while (!atomic_compare_exchange_weak (&tm_timezones, &tz->next, tz))
+      /* retry */ ;
+  }
+
+  return tz;
 }
 
-int
-tm_isutcrepresentation (struct tm date)
+/// Gets compiled rules of the local timezone, as specified by environment variable TZ.
+/// @returns Compiled timezone, or 0 if out of memory
+/// @remark The local timezone is cached per thread, keyed on the value of TZ, compared to the name of the cached timezone:
+/// the address of the value is not enough, as a libc may free the former value and allocate the next one at the same place,
+/// and a value set by putenv() may be modified in place.
+static const tm_timezone *
+tm_localtimezone (void)
 {
-  return (tm_islocalrepresentation (date) ? 0 : 1);
+  static _Thread_local const tm_timezone *local = 0;
+  const char *name = getenv ("TZ");
+
+  if (!name)
+    name = TM_TZDEFAULT;
+  else if (!*name)
+    name = "UTC0";              // Empty TZ means UTC.
+
+  if (local && !strcmp (local->name, name))
+    return local;
+
+  return local = tm_findtimezone (name);
 }
 
-int
-tm_islocalrepresentation (struct tm date)
+/// Indicates whether the timezone abbreviation of a broken-down time structure belongs to compiled timezone rules.
+static int
+tm_ownsabbreviation (const tm_timezone *tz, const char *abbreviation)
 {
-  return (date.tm_zone && strcmp (tm_utctimezone (), date.tm_zone) ? 1 : 0);
+  return tm_abbreviationowner (abbreviation) == tz;
 }
 
-tm_representation
-tm_getrepresentation (struct tm date)
+/// Gets the timezone an instant in time in local time representation is expressed in.
+/// @param [in] date Pointer to broken-down time structure
+/// @returns Timezone the abbreviation \p tm_zone of \p date belongs to, local timezone otherwise
+/// @remark In constant time, whatever the number of compiled timezones (see tm_abbreviationowner()).
+static const tm_timezone *
+tm_timezoneof (const struct tm *date)
 {
-  return tm_islocalrepresentation (date) ? TM_REP_LOCAL : TM_REP_UTC;
+  const tm_timezone *tz = tm_abbreviationowner (date->tm_zone);
+
+  return tz ? tz : tm_localtimezone ();
 }
 
-int
-tm_hasdaylightsavingtimerules (void)
+/// Finds a compiled timezone from its identifier in records (see tm_timezoneid()).
+/// @param [in] id Identifier
+/// @returns Compiled timezone, the local timezone first, or 0 if no timezone of this identifier was compiled
+static const tm_timezone *
+tm_findtimezonebyid (uint32_t id)
 {
-  tzset ();
-  return daylight;
+  if (!id)
+    return 0;
+
+  const tm_timezone *local = tm_localtimezone ();
+
+  if (local && local->id == id)
+    return local;
+
+  for (const tm_timezone * tz = atomic_load (&tm_timezones); tz; tz = tz->next)
+    if (tz->id == id)
+      return tz;
+
+  return 0;
 }
 
-int
-tm_isdaylightsavingtime (struct tm date)
+/// Interval between two transitions of a timezone, kept from one instant to the next by batch conversions.
+typedef struct
 {
-  return date.tm_isdst;
+  long long from, to;           ///< Calendar times [from, to) covered by the interval
+  long long localfrom, localto; ///< Local times [localfrom, localto) mapped to the interval without ambiguity (gap or overlap)
+  const tm_localtimetype *type; ///< Local time type in effect in the interval, 0 if the cache is empty
+} tm_intervalcache;
+
+/// Counts the transitions of a timezone that occur at or before an instant.
+/// @param [in] tz Compiled timezone
+/// @param [in] t Absolute calendar time
+/// @returns Number of transitions not after \p t (index of the first transition after \p t)
+/// @remark Binary search, in O(log n).
+static size_t
+tm_counttransitions (const tm_timezone *tz, long long t)
+{
+  size_t lo = 0, hi = tz->nbtransitions;
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (tz->transitions[mid] <= t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
 }
 
-int
-tm_isdaylightsavingextrasummertime (struct tm date)
+/// Gets the local time type in effect in a timezone at an instant.
+/// @param [in] tz Compiled timezone
+/// @param [in] t Absolute calendar time
+/// @param [in,out] cache Interval looked up last, or 0
+/// @returns Local time type, or 0 if \p t is not covered by the rules of \p tz
+/// @remark The binary search of transitions is skipped if \p t falls in the interval of \p cache.
+static const tm_localtimetype *
+tm_getlocaltimetype (const tm_timezone *tz, long long t, tm_intervalcache *cache)
 {
-  if (!date.tm_isdst)
+  if (cache && cache->type && t >= cache->from && t < cache->to)
+    return cache->type;
+
+  if (t < tz->since || t >= tz->until)
     return 0;
 
-  date.tm_isdst = 0;
-  tm_normalize (&date);
+  size_t lo = tm_counttransitions (tz, t);
+  const tm_localtimetype *type = &tz->localtimetypes[lo ? tz->types[lo - 1] : tz->initial];
 
-  // Returns 1 during the hour before DST loses effect (from summer to winter time switch), 0 otherwise.
-  return (date.tm_isdst ? 0 : 1);
+  if (cache)
+  {
+    cache->type = type;
+    cache->from = lo ? tz->transitions[lo - 1] : tz->since;
+    cache->to = lo < tz->nbtransitions ? tz->transitions[lo] : tz->until;
+    cache->localfrom = cache->from == LLONG_MIN ? LLONG_MIN : cache->from + type->utcoffset;
+    cache->localto = cache->to == LLONG_MAX ? LLONG_MAX : cache->to + type->utcoffset;
+    if (lo)
+    {
+      long int before = tz->localtimetypes[lo > 1 ? tz->types[lo - 2] : tz->initial].utcoffset;
+
+      if (before > type->utcoffset)
+        cache->localfrom = cache->from + before;
+    }
+    if (lo < tz->nbtransitions)
+    {
+      long int after = tz->localtimetypes[tz->types[lo]].utcoffset;
+
+      if (after < type->utcoffset)
+        cache->localto = cache->to + after;
+    }
+  }
+
+  return type;
 }
 
-int
-tm_isdaylightsavingextrawintertime (struct tm date)
+/// Breaks down calendar time into local date and time attributes of a timezone.
+/// @param [in] tz Compiled timezone
+/// @param [in] t Absolute calendar time
+/// @param [out] tm Pointer to broken-down time structure
+/// @returns 1 on success, 0 if \p t is not covered by the rules of \p tz, -1 on overflow
+/// @remark Lock-free equivalent of localtime_r().
+static int
+tm_breakdownintimezone (const tm_timezone *tz, long long t, struct tm *tm)
 {
-  if (date.tm_isdst)
+  if (t > LLONG_MAX / 2 || t < LLONG_MIN / 2)
+  {
+    // Years would overflow anyway, and adding the UTC offset could overflow t.
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+  const tm_localtimetype *type = tm_getlocaltimetype (tz, t, 0);
+
+  if (!type)
     return 0;
+  if (tm_breakdownutc (t + type->utcoffset, tm) == TM_ERROR)
+    return -1;
 
-  date.tm_isdst = 1;
-  tm_normalize (&date);
+  tm->tm_isdst = type->isdst;
+  tm->tm_gmtoff = type->utcoffset;
+  tm->tm_zone = type->abbreviation;
 
-  // Returns 1 during the hour after DST loses effect (from summer to winter time switch), 0 otherwise.
-  return (date.tm_isdst ? 1 : 0);
+  return 1;
 }
 
-tm_status
-tm_todaylightsavingextrawintertime (struct tm *date)
+/// Local time type in effect in an interval between two transitions.
+/// @param [in] tz Compiled timezone
+/// @param [in] i Interval, from transition \p i (-1 for the interval before the first transition) to the next one
+static const tm_localtimetype *
+tm_getintervaltype (const tm_timezone *tz, long long i)
 {
-  if (!tm_isdaylightsavingextrasummertime (*date))
-    return TM_ERROR;
-
-  date->tm_isdst = 0;
-  tm_normalize (date);
+  return &tz->localtimetypes[i >= 0 ? tz->types[i] : tz->initial];
+}
 
-  // Returns tm_OK during the hour before DST loses effect (from summer to winter time switch), TM_ERROR otherwise.
-  return (date->tm_isdst ? TM_ERROR : TM_OK);
+/// Indicates whether a local time type matches the daylight saving time flag tm_isdst, as mktime() interprets it.
+static int
+tm_matchesdst (const tm_localtimetype *type, int isdst)
+{
+  return isdst < 0 || !type->isdst == !isdst;
 }
 
-tm_status
-tm_todaylightsavingextrasummertime (struct tm *date)
+/// Converts local date and time of a timezone into calendar time, as mktime() does.
+/// @param [in] tz Compiled timezone
+/// @param [in] local Local date and time, in seconds since 1970-01-01 00:00:00 local time
+/// @param [in] isdst Daylight saving time flag, as tm_isdst for mktime() (positive, zero or negative)
+/// @param [out] t Absolute calendar time
+/// @returns 1 on success, 0 if \p local is not covered by the rules of \p tz
+/// @remark Follows the behavior of mktime():
+/// - local times skipped at a forward transition are interpreted with the offset in effect before the transition
+///   (so 2:30 am is moved to 3:30 am when clocks go forward from 2 am to 3 am), unless \p isdst selects the other offset;
+/// - local times repeated at a backward transition are interpreted as the earlier instant, unless \p isdst selects the later one;
+/// - if \p isdst disagrees with the local time type in effect, the nearest offset in time that agrees with \p isdst is used,
+///   or else a one-hour daylight saving time difference is assumed.
+static int
+tm_localtocalendartimeintimezone (const tm_timezone *tz, long long local, int isdst, long long *t)
 {
-  if (!tm_isdaylightsavingextrawintertime (*date))
-    return TM_ERROR;
+  if (tz->since == tz->until)
+    return 0;
 
-  date->tm_isdst = 1;
-  tm_normalize (date);
+  // Binary search of the last transition whose earliest local time is not after local
+  long long lo = 0, hi = (long long) tz->nbtransitions;
+
+  while (lo < hi)
+  {
+    long long mid = lo + (hi - lo) / 2;
+    long int before = tm_getintervaltype (tz, mid - 1)->utcoffset;
+    long int after = tm_getintervaltype (tz, mid)->utcoffset;
+
+    if (tz->transitions[mid] + (before < after ? before : after) <= local)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  long long i = lo - 1;         // Interval of the later candidate
+  const tm_localtimetype *later = tm_getintervaltype (tz, i);
+  const tm_localtimetype *type = later;
+
+  if (i >= 0)
+  {
+    const tm_localtimetype *earlier = tm_getintervaltype (tz, i - 1);
+
+    if (local < tz->transitions[i] + earlier->utcoffset || local < tz->transitions[i] + later->utcoffset)
+    {
+      // Local time is skipped (gap) or repeated (overlap) by transition i.
+      if (tm_matchesdst (earlier, isdst) || !tm_matchesdst (later, isdst))
+        type = earlier;
+      isdst = -1;
+    }
+  }
+
+  *t = local - type->utcoffset;
+
+  if (!tm_matchesdst (type, isdst))
+  {
+    // Use the offset of the nearest interval in time whose daylight saving time flag agrees with isdst, within 7 years,
+    // or else assume a one-hour daylight saving time difference (as mktime() does.)
+    long long best = 229222800;
+    const tm_localtimetype *nearest = 0;
+
+    for (long long j = i - 1; j >= -1 && *t - tz->transitions[j + 1] < best; j--)
+      if (tm_matchesdst (tm_getintervaltype (tz, j), isdst))
+      {
+        best = *t - tz->transitions[j + 1];
+        nearest = tm_getintervaltype (tz, j);
+        break;
+      }
+    for (long long j = i + 1; j < (long long) tz->nbtransitions && tz->transitions[j] - *t < best; j++)
+      if (tm_matchesdst (tm_getintervaltype (tz, j), isdst))
+      {
+        nearest = tm_getintervaltype (tz, j);
+        break;
+      }
+
+    *t = nearest ? local - nearest->utcoffset : *t + (isdst ? -3600 : 3600);
+  }
+
+  return *t >= tz->since && *t < tz->until;
+}
+
+/// Initializes instant in time from local date and time data.
+/// @param [in,out] tm Pointer to broken-down time structure
+/// @returns Absolute calendar time
+/// @remark The tm_normalizetolocal() function is equivalent to the POSIX standard function mktime().
+/// It makes use of the compiled rules of the timezone \p tm is expressed in (see tm_totimezonerepresentation()), the local timezone by default,
+/// and falls back to mktime() for local instants these rules do not cover.
+static time_t
+tm_normalizetolocal (struct tm *tm)
+{
+  /* (mktime man page)
+     The mktime() function converts a broken-down time structure, expressed as local time, to calendar time representation.
+     The function ignores the values supplied by the caller in the tm_wday, tm_yday and tm_gmtoff fields.
+     If structure members are outside their valid interval,  they will be normalized  (so that,  for example, 40 October is
+     changed into 9 November).
+
+     The value  specified in the tm_isdst field  informs mktime() whether or not daylight saving time (DST) is in effect for the time supplied in
+     the tm structure:
+     - a positive value means DST is in effect;
+     - zero means that DST is not in effect;
+     - and a negative value means that mktime() should (use timezone information and system databases to) attempt  to determine whether DST is in
+     effect at the specified time.
+
+     The mktime() function modifies the fields of the tm structure as follows: tm_wday and tm_yday are set to values determined from the contents
+     of the other fields; tm_gmtoff is set according to the current timezone of the system (environment variable TZ).
+     If structure members are outside their valid interval, they will be normalized (so that, for example, 40 October is changed into 9 November).
+     tm_isdst  is set (regardless of its initial value) to a positive value or to 0, respectively, to indicate whether DST is or is not in effect
+     at the specified time.
+
+     Calling mktime() also sets the external variable tzname with information about the current timezone.
+   */
+  const tm_timezone *tz = tm_timezoneof (tm);
+  long long t;
+
+  if (tz && tm_localtocalendartimeintimezone (tz, tm_linearseconds (tm), tm->tm_isdst, &t))
+  {
+    if ((long long) (time_t) t == t && tm_breakdownintimezone (tz, t, tm) > 0)
+      return (time_t) t;
+
+    errno = EOVERFLOW;
+    return (time_t) - 1;
+  }
+
+  if (tz != tm_localtimezone ())
+  {
+    // Out of the rules of another timezone than the local one: mktime() can not help.
+    errno = EOVERFLOW;
+    return (time_t) - 1;
+  }
+
+  return mktime (tm);           /* May apply daylight saving if tm_isdst is not negative before function call */
+}
+
+/*****************************************************
+*   ISO 8601                                         *
+*****************************************************/
+
+/// Reads a fixed number of decimal digits.
+/// @param [in] p Pointer to the first digit
+/// @param [in] end Pointer past the end of the string
+/// @param [in] n Number of digits
+/// @param [out] value Value of the digits
+/// @returns Pointer past the digits, or 0 if there are not \p n digits at \p p
+static const char *
+tm_parsedigits (const char *p, const char *end, int n, int *value)
+{
+  if (end - p < n)
+    return 0;
+
+  int v = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    unsigned int digit = (unsigned int) ((unsigned char) p[i] - '0');
+
+    if (digit > 9)
+      return 0;
+    v = v * 10 + (int) digit;
+  }
+
+  *value = v;
+  return p + n;
+}
+
+/// Counts the decimal digits at the beginning of a string.
+static int
+tm_countdigits (const char *p, const char *end)
+{
+  int n = 0;
+
+  while (p + n < end && p[n] >= '0' && p[n] <= '9')
+    n++;
+
+  return n;
+}
+
+/// Returns the number of days since 1970-01-01 of the monday of the first ISO week of a year.
+static long long
+tm_firstisoweekmonday (long long year)
+{
+  long long jan4 = tm_daysfromcivil (year, 1, 4);       // The first ISO week contains january, the 4th.
+
+  return jan4 - ((jan4 + 3) % 7 + 7) % 7;     // 1970-01-01 was a Thursday
+}
+
+/// Parses an ISO 8601 date, in extended or basic format:
+/// calendar date (YYYY-MM-DD or YYYYMMDD), ordinal date (YYYY-DDD or YYYYDDD) or week date (YYYY-Www-D, YYYY-Www, YYYYWwwD or YYYYWww).
+/// @param [in] p Pointer to the string
+/// @param [in] end Pointer past the end of the string
+/// @param [out] days Number of days since 1970-01-01
+/// @returns Pointer past the date, or 0 if there is no valid date at \p p
+static const char *
+tm_parseisodate (const char *p, const char *end, long long *days)
+{
+  int year, month, day;
+
+  if (!(p = tm_parsedigits (p, end, 4, &year)))
+    return 0;
+
+  int extended = p < end && *p == '-';
+
+  p += extended;
+  if (p < end && *p == 'W')
+  {
+    int week, weekday = 1;
+
+    if (!(p = tm_parsedigits (p + 1, end, 2, &week)))
+      return 0;
+    if (extended && p < end && *p == '-' && !(p = tm_parsedigits (p + 1, end, 1, &weekday)))
+      return 0;
+    if (!extended && tm_countdigits (p, end) && !(p = tm_parsedigits (p, end, 1, &weekday)))
+      return 0;
+
+    long long monday = tm_firstisoweekmonday (year);
+
+    if (week < 1 || week > (tm_firstisoweekmonday (year + 1) - monday) / 7 || weekday < 1 || weekday > 7)
+      return 0;
+
+    *days = monday + (week - 1) * 7 + weekday - 1;
+    return p;
+  }
+
+  int n = tm_countdigits (p, end);
+
+  if (n == 3)
+  {
+    // Ordinal date
+    if (!(p = tm_parsedigits (p, end, 3, &day)) || day < 1 || day > 365 + tm_isleapyear (year))
+      return 0;
+
+    *days = tm_daysfromcivil (year, 1, 1) + day - 1;
+    return p;
+  }
+
+  // Calendar date
+  if (extended ? n != 2 : n != 4)
+    return 0;
+  if (!(p = tm_parsedigits (p, end, 2, &month)))
+    return 0;
+  if (extended && (p >= end || *p++ != '-'))
+    return 0;
+  if (!(p = tm_parsedigits (p, end, 2, &day)) || tm_countdigits (p, end) || month < 1 || month > 12 || day < 1)
+    return 0;
+
+  *days = tm_daysfromcivil (year, (unsigned int) month, (unsigned int) day);
+  if (day > 28 && tm_daysfromcivil (year + (month == 12), (unsigned int) month % 12 + 1, 1) <= *days)
+    return 0;                   // Beyond the end of the month
+
+  return p;
+}
+
+/// Parses an ISO 8601 time of day, in extended (hh:mm:ss, hh:mm) or basic (hhmmss, hhmm, hh) format,
+/// with an optional decimal fraction of second (separated by a dot or a comma, truncated to nanoseconds).
+/// @param [in] p Pointer to the string
+/// @param [in] end Pointer past the end of the string
+/// @param [out] hms Hours (0 through 24, for 24:00:00 only), minutes (0 through 59) and seconds (0 through 60, for leap seconds)
+/// @param [out] nanoseconds Fraction of second, in nanoseconds
+/// @returns Pointer past the time, or 0 if there is no valid time at \p p
+static const char *
+tm_parseisotime (const char *p, const char *end, int hms[3], long int *nanoseconds)
+{
+  hms[0] = hms[1] = hms[2] = 0;
+  *nanoseconds = 0;
+
+  if (!(p = tm_parsedigits (p, end, 2, &hms[0])))
+    return 0;
+
+  int extended = p < end && *p == ':';
+
+  for (int i = 1; i < 3; i++)
+  {
+    if (extended ? p >= end || *p != ':' : !tm_countdigits (p, end))
+      break;
+    if (!(p = tm_parsedigits (p + extended, end, 2, &hms[i])))
+      return 0;
+    if (i == 2 && p < end && (*p == '.' || *p == ','))
+    {
+      int n = tm_countdigits (++p, end);
+
+      if (!n)
+        return 0;
+      for (int d = 0; d < 9; d++)
+        *nanoseconds = *nanoseconds * 10 + (d < n ? p[d] - '0' : 0);
+      p += n;
+    }
+  }
+
+  if (hms[0] > 24 || hms[1] > 59 || hms[2] > 60 || (hms[0] == 24 && (hms[1] || hms[2] || *nanoseconds)))
+    return 0;
+
+  return p;
+}
+
+/// Parses an ISO 8601 offset to UTC: Z, +hh:mm, -hh:mm, +hhmm, -hhmm, +hh or -hh (or +hh:mm:ss, -hh:mm:ss for local mean time).
+/// @param [in] p Pointer to the string
+/// @param [in] end Pointer past the end of the string
+/// @param [out] utcoffset Offset to UTC, in seconds (positive east of Greenwich)
+/// @returns Pointer past the offset, or 0 if there is no valid offset at \p p
+static const char *
+tm_parseisooffset (const char *p, const char *end, long int *utcoffset)
+{
+  int hours, minutes = 0, seconds = 0;
+
+  if (p < end && (*p == 'Z' || *p == 'z'))
+  {
+    *utcoffset = 0;
+    return p + 1;
+  }
+  if (p >= end || (*p != '+' && *p != '-'))
+    return 0;
+
+  int sign = *p == '-' ? -1 : 1;
+
+  if (!(p = tm_parsedigits (p + 1, end, 2, &hours)))
+    return 0;
+  if (p < end && *p == ':')
+  {
+    if (!(p = tm_parsedigits (p + 1, end, 2, &minutes)))
+      return 0;
+    if (p < end && *p == ':' && !(p = tm_parsedigits (p + 1, end, 2, &seconds)))
+      return 0;
+  }
+  else if (tm_countdigits (p, end)
+           && (!(p = tm_parsedigits (p, end, 2, &minutes))
+               || (tm_countdigits (p, end) && !(p = tm_parsedigits (p, end, 2, &seconds)))))
+    return 0;
+  if (hours > 23 || minutes > 59 || seconds > 59)
+    return 0;
+
+  *utcoffset = sign * (hours * 3600 + minutes * 60 + seconds);
+  return p;
+}
+
+/// Pairs of decimal digits, from "00" to "99".
+static const char tm_digitpairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869"
+  "707172737475767778798081828384858687888990919293949596979899";
+
+/// Writes a number between 0 and 99 on two digits.
+/// @returns Pointer past the digits
+static char *
+tm_writedigitpair (char *p, unsigned int value)
+{
+  memcpy (p, &tm_digitpairs[2 * value], 2);
+  return p + 2;
+}
+
+/// Writes an instant in time in ISO 8601 extended format (YYYY-MM-DDThh:mm:ss[.fffffffff]Z or ±hh:mm).
+/// @param [out] str Buffer of at least 64 bytes
+/// @param [in] tm Broken-down time structure, normalized
+/// @param [in] nanoseconds Fraction of second, in nanoseconds
+/// @param [in] digits Number of digits of the fraction of second (0 through 9)
+/// @param [in] utc Nonzero to write Z rather than the offset to UTC
+/// @returns Length of the string written (not null terminated)
+/// @remark Years out of 0000 to 9999 are written with a sign and at least 4 digits (expanded representation).
+/// Offsets to UTC with seconds (local mean time) are written as ±hh:mm:ss.
+static size_t
+tm_writeiso8601 (char *str, const struct tm *tm, long int nanoseconds, int digits, int utc)
+{
+  char *p = str;
+  long long year = (long long) tm->tm_year + 1900;
+
+  if (year >= 0 && year <= 9999)
+  {
+    p = tm_writedigitpair (p, (unsigned int) (year / 100));
+    p = tm_writedigitpair (p, (unsigned int) (year % 100));
+  }
+  else
+  {
+    char reversed[24];
+    int n = 0;
+    unsigned long long y = year < 0 ? 0ULL - (unsigned long long) year : (unsigned long long) year;
+
+    for (; y || n < 4; y /= 10)
+      reversed[n++] = (char) ('0' + y % 10);
+    *p++ = year < 0 ? '-' : '+';
+    while (n)
+      *p++ = reversed[--n];
+  }
+
+  *p++ = '-';
+  p = tm_writedigitpair (p, (unsigned int) tm->tm_mon + 1);
+  *p++ = '-';
+  p = tm_writedigitpair (p, (unsigned int) tm->tm_mday);
+  *p++ = 'T';
+  p = tm_writedigitpair (p, (unsigned int) tm->tm_hour);
+  *p++ = ':';
+  p = tm_writedigitpair (p, (unsigned int) tm->tm_min);
+  *p++ = ':';
+  p = tm_writedigitpair (p, (unsigned int) tm->tm_sec);
+
+  if (digits > 0)
+  {
+    // All 9 digits are written, then truncated to the requested number.
+    unsigned long ns = (unsigned long) nanoseconds;
+
+    *p = '.';
+    p[1] = (char) ('0' + ns / 100000000);
+    tm_writedigitpair (p + 2, (unsigned int) (ns / 1000000 % 100));
+    tm_writedigitpair (p + 4, (unsigned int) (ns / 10000 % 100));
+    tm_writedigitpair (p + 6, (unsigned int) (ns / 100 % 100));
+    tm_writedigitpair (p + 8, (unsigned int) (ns % 100));
+    p += 1 + (digits > 9 ? 9 : digits);
+  }
+
+  if (utc)
+    *p++ = 'Z';
+  else
+  {
+    long int offset = tm->tm_gmtoff;
+
+    *p++ = offset < 0 ? '-' : '+';
+    if (offset < 0)
+      offset = -offset;
+    p = tm_writedigitpair (p, (unsigned int) (offset / 3600 % 100));
+    *p++ = ':';
+    p = tm_writedigitpair (p, (unsigned int) (offset / 60 % 60));
+    if (offset % 60)
+    {
+      *p++ = ':';
+      p = tm_writedigitpair (p, (unsigned int) (offset % 60));
+    }
+  }
+
+  return (size_t) (p - str);
+}
+
+/// Copies a formatted string into a caller buffer, with a terminating null byte.
+/// @returns \p TM_OK or \p TM_ERROR if the string, including the terminating null byte, exceeds \p max bytes
+static tm_status
+tm_copyformatted (const char *formatted, size_t len, char *str, size_t max, size_t *length)
+{
+  if (len >= max)
+    return TM_ERROR;
+
+  memcpy (str, formatted, len);
+  str[len] = 0;
+  if (length)
+    *length = len;
+
+  return TM_OK;
+}
+
+/*****************************************************
+*   CONSTRUCTORS                                     *
+*****************************************************/
+static time_t tm_normalize (struct tm *date);
+static tm_status tm_makelocalfromcalendartime (time_t timep, struct tm *tm);
+
+/// Clock of the calling thread (see tm_setclocksource() and tm_setclockfunction().)
+static _Thread_local clockid_t tm_clockid = CLOCK_REALTIME;
+static _Thread_local tm_clockfunction tm_clockfn = 0;
+static _Thread_local void *tm_clockarg = 0;
+
+tm_status
+tm_setclocksource (tm_clocksource source)
+{
+  switch (source)
+  {
+    case TM_CLOCK_REALTIME:
+      tm_clockid = CLOCK_REALTIME;
+      break;
+    case TM_CLOCK_REALTIME_COARSE:
+#ifdef CLOCK_REALTIME_COARSE
+      tm_clockid = CLOCK_REALTIME_COARSE;
+      break;
+#endif
+    default:
+      errno = EINVAL;
+      return TM_ERROR;
+  }
+
+  tm_clockfn = 0;
+  tm_clockarg = 0;
+
+  return TM_OK;
+}
+
+void
+tm_setclockfunction (tm_clockfunction clock, void *arg)
+{
+  tm_clockfn = clock;
+  tm_clockarg = arg;
+}
+
+/// Reads the clock of the calling thread.
+/// @param [out] now Current calendar time
+/// @returns \p TM_OK or \p TM_ERROR
+static tm_status
+tm_clocknow (struct timespec *now)
+{
+  if (tm_clockfn)
+    return tm_clockfn (now, tm_clockarg);
+
+  return clock_gettime (tm_clockid, now) ? TM_ERROR : TM_OK;
+}
+
+/// Current local date and time, kept by each thread from one call of tm_makenow() to the next.
+static _Thread_local struct
+{
+  time_t now;                   ///< Calendar time of tm
+  struct tm tm;                 ///< Local date and time at now
+  const tm_timezone *tz;        ///< Local timezone, 0 if the cache is empty
+  tm_intervalcache interval;    ///< Interval of tz around now
+  struct tm today;              ///< Beginning of the day of tm
+  const tm_timezone *todaytz;   ///< Local timezone of today, 0 if not computed
+} tm_nowcache;
+
+tm_status
+tm_makenow (struct tm *tm)
+{
+  struct timespec now;
+
+  errno = 0;
+  if (tm_clocknow (&now) == TM_ERROR)
+    return TM_ERROR;
+
+  const tm_timezone *tz = tm_localtimezone ();
+
+  if (tz && tz == tm_nowcache.tz && now.tv_sec >= tm_nowcache.interval.from && now.tv_sec < tm_nowcache.interval.to)
+  {
+    // Same local time type as the previous call: only the seconds are bumped, as long as the minute does not change.
+    long long delta = (long long) now.tv_sec - tm_nowcache.now;
+
+    if (delta && (delta < 0 || delta >= 60 - tm_nowcache.tm.tm_sec))
+    {
+      if (tm_breakdownutc (now.tv_sec + tm_nowcache.interval.type->utcoffset, &tm_nowcache.tm) == TM_ERROR)
+        return TM_ERROR;
+      tm_nowcache.tm.tm_isdst = tm_nowcache.interval.type->isdst;
+      tm_nowcache.tm.tm_gmtoff = tm_nowcache.interval.type->utcoffset;
+      tm_nowcache.tm.tm_zone = tm_nowcache.interval.type->abbreviation;
+    }
+    else
+    {
+      tm_nowcache.tm.tm_sec += (int) delta;
+    }
+    tm_nowcache.now = now.tv_sec;
+    *tm = tm_nowcache.tm;
+
+    return TM_OK;
+  }
+
+  if (tm_makelocalfromcalendartime (now.tv_sec, tm) == TM_ERROR)
+    return TM_ERROR;
+
+  tm_nowcache.tz = tz && tm_getlocaltimetype (tz, now.tv_sec, &tm_nowcache.interval) ? tz : 0;
+  tm_nowcache.now = now.tv_sec;
+  tm_nowcache.tm = *tm;
+
+  return TM_OK;
+}
+
+tm_status
+tm_maketoday (struct tm * tm)
+{
+  if (tm_makenow (tm) == TM_ERROR)
+    return TM_ERROR;
+
+  // The beginning of the day is normalized once per day (and local timezone.)
+  if (tm_nowcache.tz && tm_nowcache.todaytz == tm_nowcache.tz && tm_nowcache.today.tm_mday == tm->tm_mday
+      && tm_nowcache.today.tm_mon == tm->tm_mon && tm_nowcache.today.tm_year == tm->tm_year)
+  {
+    *tm = tm_nowcache.today;
+    return TM_OK;
+  }
+
+  if (tm_trimtime (tm) == TM_ERROR)
+    return TM_ERROR;
+
+  tm_nowcache.today = *tm;
+  tm_nowcache.todaytz = tm_nowcache.tz;
+
+  return TM_OK;
+}
+
+tm_status
+tm_makelocal (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
+{
+  tm->tm_year = year - 1900;
+  tm->tm_mon = month - 1;
+  tm->tm_mday = day;
+  tm->tm_hour = hour;
+  tm->tm_min = min;
+  tm->tm_sec = sec;
+  tm->tm_isdst = -1;            // Let timezone information and system databases define DST flag.
+  tm->tm_zone = 0;              // Local timezone, whatever timezone tm was previously expressed in.
+
+  errno = 0;
+  time_t ret = tm_normalizetolocal (tm);        // Normalize
+
+  if (tm->tm_year == year - 1900 && tm->tm_mon == month - 1 && tm->tm_mday == day && tm->tm_hour == hour
+      && tm->tm_min == min && tm->tm_sec == sec)
+    return ret != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  else
+    return TM_ERROR;
+}
+
+/// Initialize instant in time with absolute calendar time.
+/// @param [in] timep Absolute calendar time
+/// @param [out] tm Pointer to broken-down time structure
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
+/// @remark Default representation is set to local.
+static tm_status
+tm_makelocalfromcalendartime (time_t timep, struct tm *tm)
+{
+  // data type time_t represents calendar time. which is the number of seconds elapsed since 1970-01-01 00:00:00 UTC.
+  const tm_timezone *tz = tm_localtimezone ();
+  int ret = tz ? tm_breakdownintimezone (tz, timep, tm) : 0;
+
+  if (ret)
+    return ret > 0 ? TM_OK : TM_ERROR;
+
+  tzset ();
+  return localtime_r (&timep, tm) ? TM_OK : TM_ERROR;
+}
+
+/// Initializes instant in time with absolute calendar time.
+/// @param [in] timep Absolute calendar time
+/// @param [out] tm Pointer to broken-down time structure
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
+/// @remark Default representation is set to UTC.
+static tm_status
+tm_makeutcfromcalendartime (time_t timep, struct tm *tm)
+{
+  // data type time_t represents calendar time. which is the number of seconds elapsed since 1970-01-01 00:00:00 UTC.
+  return tm_breakdownutc (timep, tm);
+}
+
+tm_status
+tm_makeutc (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
+{
+  struct tm date;
+
+  if (!tm)
+    tm = &date;
+
+  tm->tm_year = year - 1900;
+  tm->tm_mon = month - 1;
+  tm->tm_mday = day;
+  tm->tm_hour = hour;
+  tm->tm_min = min;
+  tm->tm_sec = sec;
+
+  errno = 0;
+  time_t ret = tm_normalizetoutc (tm);  /* Normalize, ignoring date timezone and saving daylight */
+
+  if (tm->tm_year == year - 1900 && tm->tm_mon == month - 1 && tm->tm_mday == day && tm->tm_hour == hour
+      && tm->tm_min == min && tm->tm_sec == sec)
+    return ret != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  else
+    return TM_ERROR;
+}
+
+tm_status
+tm_setdatefromstring (struct tm * tm, const char *buf)
+{
+  const char *end = buf + strlen (buf);
+  long long days;
+
+  if (tm_parseisodate (buf, end, &days) == end)
+  {
+    // ISO 8601 dates are parsed without strptime().
+    long long year;
+    unsigned int month, day;
+
+    tm_civilfromdays (days, &year, &month, &day);
+    tm->tm_year = (int) year - 1900;
+    tm->tm_mon = (int) month - 1;
+    tm->tm_mday = (int) day;
+  }
+  else
+  {
+    char *ret;
+
+    ret = strptime (buf, "%x", tm);
+    if (!ret || *ret)
+      ret = strptime (buf, "%Ex", tm);
+    if (!ret || *ret)
+      ret = strptime (buf, "%Y-%m-%d", tm);
+    if (!ret || *ret)
+      return TM_ERROR;
+  }
+
+  int year = tm->tm_year + 1900;        /* tm_year is the number of years since 1900. */
+
+  if (year >= 0 && year < 100)
+  {
+    time_t now;
+
+    time (&now);
+    int current_year = localtime (&now)->tm_year + 1900;        /* tm_year is the number of years since 1900. */
+
+    tm->tm_year += lround ((current_year - year) / 100.) * 100;
+  }
+
+  tm->tm_isdst = -1;
+
+  struct tm copy = *tm;
+
+  errno = 0;
+  time_t retval = tm_normalize (tm);
+
+  if (tm->tm_year == copy.tm_year && tm->tm_mon == copy.tm_mon && tm->tm_mday == copy.tm_mday
+      && tm->tm_hour == copy.tm_hour && tm->tm_min == copy.tm_min && tm->tm_sec == copy.tm_sec)
+    return retval != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  else
+    return TM_ERROR;
+}
+
+tm_status
+tm_settimefromstring (struct tm * tm, const char *buf)
+{
+  const char *end = buf + strlen (buf);
+  int hms[3];
+  long int nanoseconds;
+
+  if (tm_parseisotime (buf, end, hms, &nanoseconds) == end && hms[0] < 24 && !nanoseconds)
+  {
+    // ISO 8601 times (without fraction of second) are parsed without strptime().
+    tm->tm_hour = hms[0];
+    tm->tm_min = hms[1];
+    tm->tm_sec = hms[2];
+  }
+  else
+  {
+    char *ret;
+
+    tm->tm_hour = tm->tm_min = tm->tm_sec = 0;
+    ret = strptime (buf, "%X", tm);
+    if (!ret || *ret)
+      ret = strptime (buf, "%EX", tm);
+    if (!ret || *ret)
+      ret = strptime (buf, "%T", tm);
+    if (!ret || *ret)
+      ret = strptime (buf, "%R", tm);
+    if (!ret || *ret)
+      return TM_ERROR;
+  }
+
+  tm->tm_isdst = -1;
+
+  struct tm copy = *tm;
+
+  errno = 0;
+  time_t retval = tm_normalize (tm);
+
+  if (tm->tm_year == copy.tm_year && tm->tm_mon == copy.tm_mon && tm->tm_mday == copy.tm_mday
+      && tm->tm_hour == copy.tm_hour && tm->tm_min == copy.tm_min && tm->tm_sec == copy.tm_sec)
+    return retval != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  else
+    return TM_ERROR;
+}
+
+tm_status
+tm_gettimeintostring (struct tm dt, char *str, size_t max)
+{
+  return strftime (str, max, "%X", &dt) ? TM_OK : TM_ERROR;
+}
+
+tm_status
+tm_getdateintostring (struct tm dt, char *str, size_t max)
+{
+  return strftime (str, max, "%x", &dt) ? TM_OK : TM_ERROR;
+}
+
+tm_status
+tm_getiso8601intostring (struct tm dt, char *str, size_t max, size_t *length)
+{
+  char buffer[64];
+
+  // Fields out of range (such as tm_min = -1 or tm_mday = 32) are normalized first, as strftime() callers would do.
+  if (dt.tm_mon < 0 || dt.tm_mon > 11 || dt.tm_mday < 1 || dt.tm_mday > 31 || dt.tm_hour < 0 || dt.tm_hour > 23
+      || dt.tm_min < 0 || dt.tm_min > 59 || dt.tm_sec < 0 || dt.tm_sec > 60 || dt.tm_gmtoff <= -360000 || dt.tm_gmtoff >= 360000)
+  {
+    errno = 0;
+    if (tm_normalize (&dt) == (time_t) - 1 && errno)
+      return TM_ERROR;
+  }
+
+  return tm_copyformatted (buffer, tm_writeiso8601 (buffer, &dt, 0, 0, tm_isutcrepresentation (dt)), str, max, length);
+}
+
+/*****************************************************
+*   CONVERTERS                                       *
+*****************************************************/
+tm_status
+tm_toutcrepresentation (struct tm * date)
+{
+  if (tm_islocalrepresentation_p (date))
+  {
+    errno = 0;
+    time_t local = tm_normalizetolocal (date);
+
+    if (local != (time_t) - 1 || !errno)
+      return tm_makeutcfromcalendartime (local, date);
+    else
+      return TM_ERROR;
+  }
+  else
+    return TM_OK;
+}
+
+tm_status
+tm_tolocalrepresentation (struct tm * date)
+{
+  if (tm_isutcrepresentation_p (date))
+  {
+    errno = 0;
+    time_t utc = tm_normalizetoutc (date);
+
+    if (utc != (time_t) - 1 || !errno)
+      return tm_makelocalfromcalendartime (utc, date);
+    else
+      return TM_ERROR;
+  }
+  else if (tm_timezoneof (date) != tm_localtimezone ())
+    return tm_totimezonerepresentation (date, tm_localtimezone ());
+  else
+    return TM_OK;
+}
+
+/// Normalizes instant in time.
+/// @param [in,out] date Pointer to broken-down time structure
+/// @returns Absolute calendar time
+static time_t
+tm_normalize (struct tm *date)
+{
+  if (tm_isutcrepresentation_p (date))
+    return tm_normalizetoutc (date);
+  else
+    return tm_normalizetolocal (date);
+}
+
+/// Gets the calendar time of an instant in time, without normalizing it.
+/// @param [in] date Pointer to broken-down time structure
+/// @returns Absolute calendar time, as tm_normalize() would return it
+/// @remark The structure is only copied and normalized when calendar time can not be computed directly from the rules of its timezone.
+static time_t
+tm_calendartime (const struct tm *date)
+{
+  long long local = tm_linearseconds (date);
+  long long t = local;
+
+  // Calendar times far away from the rules or whose year would overflow are left to tm_normalize().
+  if (local > -(INT_MAX - 2000LL) * 31556952 && local < (INT_MAX - 2000LL) * 31556952)
+  {
+    const tm_timezone *tz;
+
+    if (tm_isutcrepresentation_p (date) ||
+        ((tz = tm_timezoneof (date)) && tm_localtocalendartimeintimezone (tz, local, date->tm_isdst, &t)))
+      if ((long long) (time_t) t == t)
+        return (time_t) t;
+  }
+
+  struct tm tmp = *date;
+
+  return tm_normalize (&tmp);
+}
+
+/// Converts local date and time into calendar time, in UTC or local representation.
+/// @param [in] representation Representation of \p local
+/// @param [in] tz Local timezone (see tm_localtimezone()), or 0 if unknown to the timezone database
+/// @param [in] local Local date and time, in seconds since 1970-01-01 00:00:00 local time
+/// @param [out] t Calendar time, the earlier instant if \p local is repeated, the first instant after the gap if it is skipped
+/// @returns \p TM_OK or \p TM_ERROR
+static tm_status
+tm_walltocalendartime (tm_representation representation, const tm_timezone *tz, long long local, long long *t)
+{
+  if (representation == TM_REP_UTC)
+  {
+    *t = local;
+    return TM_OK;
+  }
+  if (tz)
+    return tm_localtocalendartimeintimezone (tz, local, -1, t) ? TM_OK : TM_ERROR;
+
+  struct tm wall, date;
+
+  if (tm_breakdownutc (local, &wall) == TM_ERROR || wall.tm_year > INT_MAX - 1900
+      || tm_makelocal (&date, wall.tm_year + 1900, wall.tm_mon + 1, wall.tm_mday, wall.tm_hour, wall.tm_min, wall.tm_sec) == TM_ERROR)
+    return TM_ERROR;
+
+  errno = 0;
+  *t = tm_calendartime (&date);
+
+  return *t != -1 || !errno ? TM_OK : TM_ERROR;
+}
+
+/*****************************************************
+*   CALENDAR PROPERTIES                              *
+*****************************************************/
+// tm_isleapyear(), tm_getdayssinceepoch(), tm_getdayofweekof(), tm_getweeksinisoyear(), tm_getdaysinmonth(),
+// tm_getfirstweekdayinmonth(), tm_getlastweekdayinmonth() and tm_getfirstweekdayinisoyear() are defined in dates.h.
+
+int
+tm_getsecondsinlocalday (int year, tm_month month, int day)
+{
+  long int ret = 0;
+
+  struct tm date;
+
+  if (tm_makelocal (&date, year, month, day, 0, 0, 0) == TM_ERROR)
+    return -1;
+
+  ret = -tm_normalize (&date);
+  tm_adddays (&date, 1);
+  ret += tm_normalize (&date);
+
+  return (int) ret;
+}
+
+/*****************************************************
+*   DATE PROPERTIES                                  *
+*****************************************************/
+
+tm_dayofweek
+tm_getdayofweek (struct tm date)
+{
+  return tm_getdayofweek_p (&date);
+}
+
+tm_month
+tm_getmonth (struct tm date)
+{
+  return tm_getmonth_p (&date);
+}
+
+int
+tm_getyear (struct tm date)
+{
+  return tm_getyear_p (&date);
+}
+
+int
+tm_getday (struct tm date)
+{
+  return tm_getday_p (&date);
+}
+
+int
+tm_gethour (struct tm date)
+{
+  return tm_gethour_p (&date);
+}
+
+int
+tm_getminute (struct tm date)
+{
+  return tm_getminute_p (&date);
+}
+
+int
+tm_getsecond (struct tm date)
+{
+  return tm_getsecond_p (&date);
+}
+
+int
+tm_getdayofyear (struct tm date)
+{
+  return tm_getdayofyear_p (&date);
+}
+
+int
+tm_getisoweek (struct tm date)
+{
+  return tm_getisoweek_p (&date);
+}
+
+int
+tm_getisoyear (struct tm date)
+{
+  return tm_getisoyear_p (&date);
+}
+
+int
+tm_isutcrepresentation (struct tm date)
+{
+  return tm_isutcrepresentation_p (&date);
+}
+
+int
+tm_isutcrepresentation_p (const struct tm *date)
+{
+  return (tm_islocalrepresentation_p (date) ? 0 : 1);
+}
+
+int
+tm_islocalrepresentation (struct tm date)
+{
+  return tm_islocalrepresentation_p (&date);
+}
+
+int
+tm_islocalrepresentation_p (const struct tm *date)
+{
+  return (date->tm_zone && date->tm_zone != tm_utctimezone () ? 1 : 0);
+}
+
+tm_representation
+tm_getrepresentation (struct tm date)
+{
+  return tm_getrepresentation_p (&date);
+}
+
+tm_representation
+tm_getrepresentation_p (const struct tm *date)
+{
+  return tm_islocalrepresentation_p (date) ? TM_REP_LOCAL : TM_REP_UTC;
+}
+
+int
+tm_hasdaylightsavingtimerules (void)
+{
+  tzset ();
+  return daylight;
+}
+
+int
+tm_isdaylightsavingtime (struct tm date)
+{
+  return tm_isdaylightsavingtime_p (&date);
+}
+
+/// Classifies a local date and time repeated by a backward transition of its timezone (overlap at DST cutoff).
+/// @param [in] date Broken-down time structure, in local time representation
+/// @param [out] shift Seconds to add to \p date to get the other occurrence of the same local date and time
+/// @returns 1 for the first occurrence (before the transition), -1 for the second occurrence (after the transition),
+///          0 if \p date is not repeated, or 2 if the rules of the timezone of \p date are not known at \p date
+static int
+tm_getoverlap (const struct tm *date, long long *shift)
+{
+  const tm_timezone *tz = tm_isutcrepresentation_p (date) ? 0 : tm_timezoneof (date);
+  long long local = tm_linearseconds (date);
+  long long t = local - date->tm_gmtoff;
+
+  if (!tz || t < tz->since || t >= tz->until || t > LLONG_MAX / 2 || t < LLONG_MIN / 2)
+    return tz ? 2 : 0;
+
+  // Transitions around t, the only ones that can repeat the local time of date
+  size_t i = tm_counttransitions (tz, t);
+
+  if (i < tz->nbtransitions)
+  {
+    long int before = tm_getintervaltype (tz, (long long) i - 1)->utcoffset;
+    long int after = tm_getintervaltype (tz, (long long) i)->utcoffset;
+
+    if (after < before && local >= tz->transitions[i] + after)
+    {
+      *shift = before - after;
+      return 1;
+    }
+  }
+  if (i > 0)
+  {
+    long int before = tm_getintervaltype (tz, (long long) i - 2)->utcoffset;
+    long int after = tm_getintervaltype (tz, (long long) i - 1)->utcoffset;
+
+    if (after < before && local < tz->transitions[i - 1] + before)
+    {
+      *shift = after - before;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int
+tm_isdaylightsavingextrasummertime (struct tm date)
+{
+  return tm_isdaylightsavingextrasummertime_p (&date);
+}
+
+int
+tm_isdaylightsavingextrasummertime_p (const struct tm *date)
+{
+  if (!date->tm_isdst)
+    return 0;
+
+  long long shift;
+  int overlap = tm_getoverlap (date, &shift);
+
+  if (overlap != 2)
+    return overlap > 0;
+
+  struct tm tmp = *date;
+
+  tmp.tm_isdst = 0;
+  tm_normalize (&tmp);
+
+  // Returns 1 during the hour before DST loses effect (from summer to winter time switch), 0 otherwise.
+  return (tmp.tm_isdst ? 0 : 1);
+}
+
+int
+tm_isdaylightsavingextrawintertime (struct tm date)
+{
+  return tm_isdaylightsavingextrawintertime_p (&date);
+}
+
+int
+tm_isdaylightsavingextrawintertime_p (const struct tm *date)
+{
+  if (date->tm_isdst)
+    return 0;
+
+  long long shift;
+  int overlap = tm_getoverlap (date, &shift);
+
+  if (overlap != 2)
+    return overlap < 0;
+
+  struct tm tmp = *date;
+
+  tmp.tm_isdst = 1;
+  tm_normalize (&tmp);
+
+  // Returns 1 during the hour after DST loses effect (from summer to winter time switch), 0 otherwise.
+  return (tmp.tm_isdst ? 1 : 0);
+}
+
+tm_status
+tm_todaylightsavingextrawintertime (struct tm *date)
+{
+  if (!date->tm_isdst)
+    return TM_ERROR;
+
+  long long shift;
+  int overlap = tm_getoverlap (date, &shift);
+
+  if (overlap == 1)
+    return tm_breakdownintimezone (tm_timezoneof (date), tm_linearseconds (date) - date->tm_gmtoff + shift, date) > 0
+      ? TM_OK : TM_ERROR;
+  if (overlap != 2)
+    return TM_ERROR;
+
+  if (!tm_isdaylightsavingextrasummertime (*date))
+    return TM_ERROR;
+
+  date->tm_isdst = 0;
+  tm_normalize (date);
+
+  // Returns tm_OK during the hour before DST loses effect (from summer to winter time switch), TM_ERROR otherwise.
+  return (date->tm_isdst ? TM_ERROR : TM_OK);
+}
+
+tm_status
+tm_todaylightsavingextrasummertime (struct tm *date)
+{
+  if (date->tm_isdst)
+    return TM_ERROR;
+
+  long long shift;
+  int overlap = tm_getoverlap (date, &shift);
+
+  if (overlap == -1)
+    return tm_breakdownintimezone (tm_timezoneof (date), tm_linearseconds (date) - date->tm_gmtoff + shift, date) > 0
+      ? TM_OK : TM_ERROR;
+  if (overlap != 2)
+    return TM_ERROR;
+
+  if (!tm_isdaylightsavingextrawintertime (*date))
+    return TM_ERROR;
+
+  date->tm_isdst = 1;
+  tm_normalize (date);
+
+  // Returns tm_OK during the hour after DST loses effect (from summer to winter time switch), TM_ERROR otherwise.
+  return (date->tm_isdst ? TM_OK : TM_ERROR);
+}
+
+int
+tm_getutcoffset (struct tm date)
+{
+  return tm_getutcoffset_p (&date);
+}
+
+int
+tm_getutcoffset_p (const struct tm *date)
+{
+  return date->tm_gmtoff;
+}
+
+const char *
+tm_gettimezone (struct tm date)
+{
+  return tm_gettimezone_p (&date);
+}
+
+const char *
+tm_gettimezone_p (const struct tm *date)
+{
+  // Statically allocated.
+  return date->tm_zone;
+}
+
+int
+tm_getsecondsofday (struct tm date)
+{
+  return tm_getsecondsofday_p (&date);
+}
+
+int
+tm_getsecondsofday_p (const struct tm *date)
+{
+  int seconds = (date->tm_hour * 60 + date->tm_min) * 60 + date->tm_sec;
+  const tm_timezone *tz;
+  long long midnight;
+
+  if (tm_isutcrepresentation_p (date))
+    return seconds;
+
+  // Seconds actually elapsed since midnight: the offset to UTC may have changed since then.
+  if ((tz = tm_timezoneof (date)) && tm_localtocalendartimeintimezone (tz, tm_linearseconds (date) - seconds, -1, &midnight))
+    return (int) (tm_linearseconds (date) - date->tm_gmtoff - midnight);
+
+  struct tm tmp = *date;
+
+  tm_set (&tmp, tm_getyear_p (date), tm_getmonth_p (date), tm_getday_p (date), 0, 0, 0);
+
+  return tm_diffseconds_p (&tmp, date);
+}
+
+tm_status
+tm_set (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
+{
+  if (tm_islocalrepresentation_p (tm))
+    return tm_makelocal (tm, year, month, day, hour, min, sec);
+  else
+    return tm_makeutc (tm, year, month, day, hour, min, sec);
+}
+
+/*****************************************************
+*   OPERATORS                                        *
+*****************************************************/
+
+tm_status
+tm_addseconds (struct tm * date, long int nbSecs)
+{
+  date->tm_sec += nbSecs;
+  // Don't modify date->tm_isdst so that absolute number of seconds is added.
+
+  errno = 0;
+  return tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+}
+
+tm_status
+tm_adddays (struct tm * date, int nbDays)
+{
+  date->tm_mday += nbDays;
+  date->tm_isdst = -1;          // Let timezone information and system databases define DST flag.
+
+  errno = 0;
+  return tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+}
+
+tm_status
+tm_addmonths (struct tm * date, int nbMonths)
+{
+  int mday = date->tm_mday;
+
+  date->tm_mon += nbMonths;
+  date->tm_isdst = -1;          // Let timezone information and system databases define DST flag.
+
+  errno = 0;
+  tm_status ret = tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+
+  if (ret == TM_OK && date->tm_mday != mday)
+  {
+    date->tm_mday = 0;
+    ret = tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  }
+
+  return ret;
+}
+
+tm_status
+tm_addyears (struct tm * date, int nbYears)
+{
+  return tm_addmonths (date, 12 * nbYears);
+}
+
+tm_status
+tm_trimtime (struct tm * tm)
+{
+  tm->tm_sec = tm->tm_min = tm->tm_hour = 0;
+  tm->tm_isdst = -1;            // Let timezone information and system databases define DST flag.
+
+  errno = 0;
+  return tm_normalize (tm) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+}
+
+/*****************************************************
+*   COMPARATORS                                      *
+*****************************************************/
+int
+tm_equals (struct tm a, struct tm b)
+{
+  return tm_equals_p (&a, &b);
+}
+
+int
+tm_equals_p (const struct tm *a, const struct tm *b)
+{
+  return (a->tm_sec == b->tm_sec && a->tm_min == b->tm_min && a->tm_hour == b->tm_hour &&
+          a->tm_mday == b->tm_mday && a->tm_mon == b->tm_mon && a->tm_year == b->tm_year && a->tm_gmtoff == b->tm_gmtoff
+          && a->tm_zone == b->tm_zone);
+}
+
+long int
+tm_diffseconds (struct tm debut, struct tm fin)
+{
+  return tm_diffseconds_p (&debut, &fin);
+}
+
+long int
+tm_diffseconds_p (const struct tm *debut, const struct tm *fin)
+{
+  return tm_calendartime (fin) - tm_calendartime (debut);
+}
+
+int
+tm_compare (const void *pdebut, const void *pfin)
+{
+  long int diff = -tm_diffseconds_p (pdebut, pfin);
+
+  return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
+}
+
+/// Sorts indexes by 64-bit keys, with a least significant digit radix sort (stable).
+/// @param [in,out] keys Array of \p n keys, sorted on return
+/// @param [in,out] indexes Array of \p n indexes, permuted as \p keys
+/// @param [in] n Number of keys
+/// @param [out] tmpkeys Work array of \p n keys
+/// @param [out] tmpindexes Work array of \p n indexes
+/// @remark Keys are compared as unsigned integers. Passes on bytes that are identical for all keys are skipped.
+static void
+tm_radixsort (uint64_t *keys, size_t *indexes, size_t n, uint64_t *tmpkeys, size_t *tmpindexes)
+{
+  size_t counts[8][256] = { {0} };
+
+  for (size_t i = 0; i < n; i++)
+    for (int d = 0; d < 8; d++)
+      counts[d][(keys[i] >> (8 * d)) & 0xff]++;
+
+  for (int d = 0; d < 8; d++)
+  {
+    size_t *count = counts[d];
+
+    if (count[(keys[0] >> (8 * d)) & 0xff] == n)
+      continue;                 // Same byte for all keys
+
+    for (size_t b = 0, offset = 0; b < 256; b++)
+    {
+      size_t c = count[b];
+
+      count[b] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+      size_t position = count[(keys[i] >> (8 * d)) & 0xff]++;
+
+      tmpkeys[position] = keys[i];
+      tmpindexes[position] = indexes[i];
+    }
+    memcpy (keys, tmpkeys, n * sizeof (*keys));
+    memcpy (indexes, tmpindexes, n * sizeof (*indexes));
+  }
+}
+
+tm_status
+tm_sortindex (const struct tm *dates, size_t n, size_t *indexes)
+{
+  if (!n)
+    return TM_OK;
+
+  time_t *binaries = malloc (n * sizeof (*binaries));
+  uint64_t *keys = malloc (2 * n * sizeof (*keys));
+  size_t *tmpindexes = malloc (n * sizeof (*tmpindexes));
+  tm_status ret = binaries && keys && tmpindexes ? tm_tobinary_n (binaries, dates, n, 0) : TM_ERROR;
+
+  if (ret == TM_OK)
+  {
+    // Keys computed once per element, with the sign bit flipped so that they sort as unsigned integers.
+    for (size_t i = 0; i < n; i++)
+    {
+      keys[i] = (uint64_t) (int64_t) binaries[i] ^ ((uint64_t) 1 << 63);
+      indexes[i] = i;
+    }
+    tm_radixsort (keys, indexes, n, keys + n, tmpindexes);
+  }
+
+  free (binaries);
+  free (keys);
+  free (tmpindexes);
+
+  return ret;
+}
+
+tm_status
+tm_sort (struct tm *dates, size_t n)
+{
+  size_t *indexes = malloc (n * sizeof (*indexes) + 1);
+  struct tm *sorted = malloc (n * sizeof (*sorted) + 1);
+  tm_status ret = indexes && sorted ? tm_sortindex (dates, n, indexes) : TM_ERROR;
+
+  if (ret == TM_OK)
+  {
+    for (size_t i = 0; i < n; i++)
+      sorted[i] = dates[indexes[i]];
+    memcpy (dates, sorted, n * sizeof (*dates));
+  }
+
+  free (indexes);
+  free (sorted);
+
+  return ret;
+}
+
+/// Number of days elapsed since 1970-01-01 at the day of a broken-down time structure, from its year and day of year.
+static long long
+tm_epochday (const struct tm *date)
+{
+  return tm_daysfromcivil ((long long) date->tm_year + 1900, 1, 1) + date->tm_yday;
+}
+
+int
+tm_diffcalendardays (struct tm debut, struct tm fin)
+{
+  return tm_diffcalendardays_p (&debut, &fin);
+}
+
+int
+tm_diffcalendardays_p (const struct tm *debut, const struct tm *fin)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return (int) (tm_epochday (fin) - tm_epochday (debut));
+}
+
+tm_status
+tm_diffcalendardays_n (int *out, const struct tm *debut, const struct tm *fin, size_t n, tm_status *status)
+{
+  tm_status ret = TM_OK;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    long long days = tm_epochday (&fin[i]) - tm_epochday (&debut[i]);
+    tm_status s = TM_OK;
+
+    if (tm_getrepresentation (debut[i]) != tm_getrepresentation (fin[i]))
+    {
+      errno = EINVAL;
+      s = TM_ERROR;
+    }
+    else if (days > INT_MAX || days < INT_MIN)
+    {
+      errno = ERANGE;
+      s = TM_ERROR;
+    }
+
+    out[i] = s == TM_OK ? (int) days : 0;
+    if (status)
+      status[i] = s;
+    if (s == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  return ret;
+}
+
+int
+tm_diffdays (struct tm debut, struct tm fin, int *seconds)
+{
+  return tm_diffdays_p (&debut, &fin, seconds);
+}
+
+int
+tm_diffdays_p (const struct tm *debut, const struct tm *fin, int *seconds)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  int coeff = 1;
+
+  if (tm_diffseconds_p (debut, fin) < 0)
+  {
+    const struct tm *tmp = debut;
+
+    debut = fin;
+    fin = tmp;
+    coeff = -1;
+  }
+
+  int ret = tm_diffcalendardays_p (debut, fin);
+
+  if (fin->tm_hour < debut->tm_hour || (fin->tm_hour == debut->tm_hour && fin->tm_min < debut->tm_min) ||
+      (fin->tm_hour == debut->tm_hour && fin->tm_min == debut->tm_min && fin->tm_sec < debut->tm_sec))
+    if (ret > 0)
+      ret--;
+
+  if (seconds)
+  {
+    struct tm start = *debut;
+
+    tm_adddays (&start, ret);
+    *seconds = coeff * tm_diffseconds_p (&start, fin);
+  }
+
+  return coeff * ret;
+}
+
+int
+tm_diffweeks (struct tm debut, struct tm fin, int *days, int *seconds)
+{
+  return tm_diffweeks_p (&debut, &fin, days, seconds);
+}
+
+int
+tm_diffweeks_p (const struct tm *debut, const struct tm *fin, int *days, int *seconds)
+{
+  int d = tm_diffdays_p (debut, fin, seconds);
+  int s = seconds ? *seconds : 0;
+
+  if (days)
+    *days = d >= 0 ? d % 7 : -((-d) % 7);
+  else if (seconds)
+    *seconds = s;
+
+  return d / 7;
+}
+
+int
+tm_diffcalendarmonths (struct tm debut, struct tm fin)
+{
+  return tm_diffcalendarmonths_p (&debut, &fin);
+}
+
+int
+tm_diffcalendarmonths_p (const struct tm *debut, const struct tm *fin)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return 12 * (fin->tm_year - debut->tm_year) + fin->tm_mon - debut->tm_mon;
+}
+
+int
+tm_diffmonths (struct tm debut, struct tm fin, int *days, int *seconds)
+{
+  return tm_diffmonths_p (&debut, &fin, days, seconds);
+}
+
+int
+tm_diffmonths_p (const struct tm *debut, const struct tm *fin, int *days, int *seconds)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  int coeff = 1;
+
+  if (tm_diffseconds_p (debut, fin) < 0)
+  {
+    const struct tm *tmp = debut;
+
+    debut = fin;
+    fin = tmp;
+    coeff = -1;
+  }
+
+  int ret = tm_diffcalendarmonths_p (debut, fin);
+
+  if (fin->tm_mday < debut->tm_mday ||
+      (fin->tm_mday == debut->tm_mday && fin->tm_hour < debut->tm_hour) ||
+      (fin->tm_mday == debut->tm_mday && fin->tm_hour == debut->tm_hour && fin->tm_min < debut->tm_min) ||
+      (fin->tm_mday == debut->tm_mday && fin->tm_hour == debut->tm_hour && fin->tm_min == debut->tm_min
+       && fin->tm_sec < debut->tm_sec))
+    if (ret > 0)
+      ret--;
+
+  if (days)
+  {
+    struct tm start = *debut;
+
+    tm_addmonths (&start, ret);
+    *days = coeff * tm_diffdays_p (&start, fin, seconds);
+    if (seconds)
+      *seconds *= coeff;
+  }
+
+  return coeff * ret;
+}
+
+int
+tm_diffcalendaryears (struct tm debut, struct tm fin)
+{
+  return tm_diffcalendaryears_p (&debut, &fin);
+}
+
+int
+tm_diffcalendaryears_p (const struct tm *debut, const struct tm *fin)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return tm_getyear_p (fin) - tm_getyear_p (debut);
+}
+
+int
+tm_diffyears (struct tm debut, struct tm fin, int *months, int *days, int *seconds)
+{
+  return tm_diffyears_p (&debut, &fin, months, days, seconds);
+}
+
+int
+tm_diffyears_p (const struct tm *debut, const struct tm *fin, int *months, int *days, int *seconds)
+{
+  int m = tm_diffmonths_p (debut, fin, days, seconds);
+  int d = days ? *days : 0;
+  int s = seconds ? *seconds : 0;
+
+  if (months)
+    *months = m >= 0 ? m % 12 : -((-m) % 12);
+  else
+  {
+    if (days)
+      *days = d;
+    if (seconds)
+      *seconds = s;
+  }
+  return m / 12;
+}
+
+int
+tm_diffisoyears (struct tm debut, struct tm fin)
+{
+  return tm_diffisoyears_p (&debut, &fin);
+}
+
+int
+tm_diffisoyears_p (const struct tm *debut, const struct tm *fin)
+{
+  if (tm_getrepresentation_p (debut) != tm_getrepresentation_p (fin))
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  return tm_getisoyear_p (fin) - tm_getisoyear_p (debut);
+}
+
+/*****************************************************
+*   ITERATORS                                        *
+*****************************************************/
+
+/// Seconds per unit of steps along the time-line.
+/// @param [in] unit Unit of steps
+/// @returns Seconds per unit, 0 for calendar units (days, weeks and months)
+static long long
+tm_iterseconds (tm_iterunit unit)
+{
+  return unit == TM_ITER_SECOND ? 1 : unit == TM_ITER_MINUTE ? 60 : unit == TM_ITER_HOUR ? 3600 : 0;
+}
+
+/// Gets the local date and time of an element of a range, for calendar units.
+/// @param [in] it Iterator
+/// @param [in] index Index of the element
+/// @returns Local time of the element, in seconds since 1970-01-01 00:00:00 local time, before any shift by a gap
+static long long
+tm_iterwalltime (const tm_iter *it, long long index)
+{
+  if (it->unit != TM_ITER_MONTH)
+    return (it->base + index * it->step) * 86400 + it->secondsofday;
+
+  long long month = it->base + index * it->step;
+  long long year = month >= 0 ? month / 12 : -((-month + 11) / 12);
+  int last = tm_getdaysinmonth ((int) year, (tm_month) (month - 12 * year + 1));
+
+  return tm_daysfromcivil (year, (unsigned int) (month - 12 * year + 1),
+                           (unsigned int) (it->mday < last ? it->mday : last)) * 86400 + it->secondsofday;
+}
+
+/// Gets the number of seconds in the local day of the current element of a range.
+/// @param [in] it Iterator
+/// @returns Number of seconds, as tm_getsecondsinlocalday() counts them
+static long int
+tm_iterdaylength (const tm_iter *it)
+{
+  long long midnight, nextmidnight;
+
+  // No transition during the day
+  if (it->daystart >= it->localfrom && it->daystart + 86400 <= it->localto)
+    return 86400;
+
+  if (it->tz && tm_localtocalendartimeintimezone (it->tz, it->daystart, -1, &midnight)
+      && tm_localtocalendartimeintimezone (it->tz, it->daystart + 86400, -1, &nextmidnight))
+    return (long int) (nextmidnight - midnight);
+
+  return 86400;
+}
+
+/// Computes an element of a range from the start of the range, by the usual operators.
+/// Used out of the rules of the timezone of the range (local timezone unknown to the timezone database, or far instants.)
+/// @param [in,out] it Iterator
+/// @returns 1 if \p it->current is the element of index \p it->index, 0 past the end of the range or on overflow
+static int
+tm_iterslow (tm_iter *it)
+{
+  struct tm date = it->start;
+  long long shift;
+  tm_status ret = TM_OK;
+
+  if (it->index && tm_iterseconds (it->unit))
+    ret = it->index > LONG_MAX / it->step ? TM_ERROR : tm_addseconds (&date, (long int) (it->index * it->step));
+  else if (it->index && it->unit != TM_ITER_MONTH)
+    ret = it->index > INT_MAX / it->step ? TM_ERROR : tm_adddays (&date, (int) (it->index * it->step));
+  else if (it->index)
+    ret = it->index > INT_MAX / it->step ? TM_ERROR : tm_addmonths (&date, (int) (it->index * it->step));
+
+  errno = 0;
+  time_t t = tm_calendartime (&date);
+
+  if (ret == TM_ERROR || (t == (time_t) - 1 && errno) || t >= it->end)
+    return 0;
+
+  int overlap = tm_getoverlap (&date, &shift);
+
+  it->current = date;
+  it->time = t;
+  it->flags = overlap == 1 ? TM_ITER_OVERLAP_FIRST : overlap == -1 ? TM_ITER_OVERLAP_SECOND : 0;
+  it->daylength = tm_islocalrepresentation_p (&date) ?
+    tm_getsecondsinlocalday (tm_getyear_p (&date), tm_getmonth_p (&date), tm_getday_p (&date)) : 86400;
+  it->daystart = LLONG_MAX;     // Out of the cache
+  it->index++;
+
+  return 1;
+}
+
+tm_status
+tm_iter_init (tm_iter * it, const struct tm *start, const struct tm *end, tm_iterunit unit, int step)
+{
+  if (!it || !start || !end || step <= 0 || unit < TM_ITER_SECOND || unit > TM_ITER_MONTH)
+  {
+    errno = EINVAL;
+    return TM_ERROR;
+  }
+
+  errno = 0;
+  it->first = tm_calendartime (start);
+  if (it->first == -1 && errno)
+    return TM_ERROR;
+  it->end = tm_calendartime (end);
+  if (it->end == -1 && errno)
+    return TM_ERROR;
+
+  it->start = *start;
+  it->unit = unit;
+  it->step = tm_iterseconds (unit) ? tm_iterseconds (unit) * step : unit == TM_ITER_WEEK ? 7LL * step : step;
+  it->index = 0;
+  it->flags = 0;
+  it->daylength = 86400;
+  it->daystart = LLONG_MAX;
+
+  // Local date and time of start, which calendar steps keep
+  long long local = tm_linearseconds (start);
+  long long day = local >= 0 ? local / 86400 : -((-local + 86399) / 86400);
+  struct tm date;
+
+  if (tm_breakdownutc (day * 86400, &date) == TM_ERROR)
+    return TM_ERROR;
+  it->secondsofday = (long int) (local - day * 86400);
+  it->mday = date.tm_mday;
+  it->base = unit == TM_ITER_MONTH ? (date.tm_year + 1900LL) * 12 + date.tm_mon : day;
+
+  it->tz = tm_isutcrepresentation_p (start) ? 0 : tm_timezoneof (start);
+  if (it->tz)
+    it->from = it->to = LLONG_MIN;      // Interval looked up on first use
+  else
+  {
+    it->from = it->localfrom = LLONG_MIN;
+    it->to = it->localto = LLONG_MAX;
+    it->utcoffset = 0;
+    it->isdst = 0;
+    it->abbreviation = tm_utctimezone ();
+  }
+
+  return TM_OK;
+}
+
+/// Moves an iterator to its next element (see tm_iter_next()).
+/// @param [in,out] it Iterator, not past the end of its range
+/// @returns 1 if \p it->current is the element of index \p it->index, 0 past the end of the range or on overflow
+static int
+tm_iternext (tm_iter *it)
+{
+  long long t, wall = LLONG_MIN;
+
+  if (tm_islocalrepresentation_p (&it->start) && !it->tz)
+    return tm_iterslow (it);
+
+  if (!it->index)
+    t = it->first;
+  else if (tm_iterseconds (it->unit))
+  {
+    if (it->step >= it->end - it->time)
+      return 0;
+    t = it->time + it->step;
+  }
+  else
+  {
+    wall = tm_iterwalltime (it, it->index);
+    if (wall >= it->localfrom && wall < it->localto)
+      t = wall - it->utcoffset;
+    else if (!tm_localtocalendartimeintimezone (it->tz, wall, -1, &t))
+      return tm_iterslow (it);
+  }
+
+  if (t >= it->end)
+    return 0;
+
+  // Next transition passed: looks up the interval until the following one.
+  if (t < it->from || t >= it->to)
+  {
+    tm_intervalcache cache = { 0 };
+    const tm_localtimetype *type = tm_getlocaltimetype (it->tz, t, &cache);
+
+    if (!type)
+      return tm_iterslow (it);
+
+    it->from = cache.from;
+    it->to = cache.to;
+    it->localfrom = cache.localfrom;
+    it->localto = cache.localto;
+    it->utcoffset = type->utcoffset;
+    it->isdst = type->isdst;
+    it->abbreviation = type->abbreviation;
+  }
+
+  long long local = t + it->utcoffset;
+
+  if (it->daystart <= local && local - it->daystart < 86400)
+  {
+    // Same day as the previous element
+    long int seconds = (long int) (local - it->daystart);
+
+    it->current.tm_hour = (int) (seconds / 3600);
+    it->current.tm_min = (int) (seconds / 60 % 60);
+    it->current.tm_sec = (int) (seconds % 60);
+  }
+  else
+  {
+    if (tm_breakdownutc (local, &it->current) == TM_ERROR)
+      return 0;
+    it->daystart = local - ((it->current.tm_hour * 60 + it->current.tm_min) * 60 + it->current.tm_sec);
+    it->daylength = tm_iterdaylength (it);
+  }
+  it->current.tm_isdst = it->isdst;
+  it->current.tm_gmtoff = it->utcoffset;
+  it->current.tm_zone = it->abbreviation;
+
+  it->time = (time_t) t;
+  it->flags = (local >= it->localto ? TM_ITER_OVERLAP_FIRST : 0) | (local < it->localfrom ? TM_ITER_OVERLAP_SECOND : 0)
+    | (wall != LLONG_MIN && wall != local ? TM_ITER_SHIFTED : 0);
+  it->index++;
+
+  return 1;
+}
+
+int
+tm_iter_next (tm_iter * it)
+{
+  if (it->index >= 0 && tm_iternext (it))
+    return 1;
+
+  it->index = -1;               // Past the end of the range
+  return 0;
+}
+
+/*****************************************************
+*   INDEXES                                          *
+*****************************************************/
+
+/// Entry of the directory of an index: a local day.
+typedef struct
+{
+  long long midnight;           ///< Calendar time of the beginning of the day
+  size_t rank;                  ///< Rank of the first instant at or after the beginning of the day
+} tm_indexday;
+
+struct tm_index
+{
+  size_t n;                     ///< Number of instants
+  int64_t *keys;                ///< Calendar times of the instants, in ascending order
+  size_t *positions;            ///< Positions of the instants in the array the index was built from, in the order of keys
+  tm_representation representation;     ///< Representation of the days of the directory
+  const tm_timezone *tz;        ///< Timezone of the days of the directory in local representation, 0 if unknown
+  long long firstday;           ///< First day of the directory, in days since 1970-01-01
+  size_t nbdays;                ///< Number of days of the directory, 0 if there is no directory
+  tm_indexday *directory;       ///< Days of the directory, and the day after the last one (nbdays + 1 entries)
+};
+
+/// Gets the day of an instant, in the representation of the directory of an index.
+/// @param [in] index Index
+/// @param [in] t Calendar time
+/// @param [out] day Day, in days since 1970-01-01
+/// @returns \p TM_OK, or \p TM_ERROR if the local time of \p t is not known by the rules of the timezone
+static tm_status
+tm_indexdayof (const tm_index *index, long long t, long long *day)
+{
+  const tm_localtimetype *type = 0;
+
+  if (index->representation == TM_REP_LOCAL && (!index->tz || !(type = tm_getlocaltimetype (index->tz, t, 0))))
+    return TM_ERROR;
+
+  long long local = t + (type ? type->utcoffset : 0);
+
+  *day = (local >= 0 ? local : local - 86399) / 86400;
+
+  return TM_OK;
+}
+
+/// Gets the rank of the first instant of an index at or after a calendar time.
+/// @param [in] index Index
+/// @param [in] t Calendar time
+/// @returns Rank, from 0 to the number of instants
+/// @remark The directory narrows the binary search down to the instants of the day of \p t.
+static size_t
+tm_indexlowerbound (const tm_index *index, long long t)
+{
+  size_t lo = 0, hi = index->n;
+
+  if (index->nbdays)
+  {
+    const tm_indexday *directory = index->directory;
+
+    // All instants are in the days of the directory.
+    if (t <= directory[0].midnight)
+      return 0;
+    if (t > directory[index->nbdays].midnight)
+      return index->n;
+
+    // Days are 24 hours long, give or take the transitions of the timezone.
+    long long d = (t - directory[0].midnight) / 86400;
+
+    if (d >= (long long) index->nbdays)
+      d = (long long) index->nbdays - 1;
+    while (d > 0 && directory[d].midnight > t)
+      d--;
+    while (d < (long long) index->nbdays - 1 && directory[d + 1].midnight <= t)
+      d++;
+
+    lo = directory[d].rank;
+    hi = directory[d + 1].rank;
+  }
+
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (index->keys[mid] < t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+tm_index *
+tm_index_build (const struct tm *dates, size_t n, tm_representation representation)
+{
+  tm_index *index = calloc (1, sizeof (*index));
+  time_t *binaries = malloc ((n ? n : 1) * sizeof (*binaries));
+  uint64_t *keys = malloc ((n ? 2 * n : 1) * sizeof (*keys));
+  size_t *tmpindexes = malloc ((n ? n : 1) * sizeof (*tmpindexes));
+
+  if (index)
+  {
+    index->keys = malloc ((n ? n : 1) * sizeof (*index->keys));
+    index->positions = malloc ((n ? n : 1) * sizeof (*index->positions));
+  }
+
+  if (!index || !binaries || !keys || !tmpindexes || !index->keys || !index->positions
+      || tm_tobinary_n (binaries, dates, n, 0) == TM_ERROR)
+  {
+    free (binaries);
+    free (keys);
+    free (tmpindexes);
+    tm_index_free (index);
+    return 0;
+  }
+
+  // Sorted as tm_sortindex() does.
+  for (size_t i = 0; i < n; i++)
+  {
+    keys[i] = (uint64_t) (int64_t) binaries[i] ^ ((uint64_t) 1 << 63);
+    index->positions[i] = i;
+  }
+  tm_radixsort (keys, index->positions, n, keys + n, tmpindexes);
+  for (size_t i = 0; i < n; i++)
+    index->keys[i] = (int64_t) (keys[i] ^ ((uint64_t) 1 << 63));
+
+  free (binaries);
+  free (keys);
+  free (tmpindexes);
+
+  index->n = n;
+  index->representation = representation;
+  index->tz = representation == TM_REP_LOCAL ? tm_localtimezone () : 0;
+
+  // Directory of local days, unless instants are too sparse or out of the rules of the timezone.
+  long long firstday, lastday;
+
+  if (n && tm_indexdayof (index, index->keys[0], &firstday) == TM_OK
+      && tm_indexdayof (index, index->keys[n - 1], &lastday) == TM_OK && (unsigned long long) (lastday - firstday) < 2 * n + 366
+      && (index->directory = malloc ((size_t) (lastday - firstday + 2) * sizeof (*index->directory))))
+  {
+    size_t rank = 0;
+
+    index->firstday = firstday;
+    index->nbdays = (size_t) (lastday - firstday + 1);
+    for (size_t d = 0; d <= index->nbdays; d++)
+    {
+      if (tm_walltocalendartime (representation, index->tz, (firstday + (long long) d) * 86400, &index->directory[d].midnight) == TM_ERROR
+          || (d && index->directory[d].midnight <= index->directory[d - 1].midnight))
+      {
+        free (index->directory);
+        index->directory = 0;
+        index->nbdays = 0;
+        break;
+      }
+      for (; rank < n && index->keys[rank] < index->directory[d].midnight; rank++)
+        ;
+      index->directory[d].rank = rank;
+    }
+  }
+
+  return index;
+}
+
+size_t
+tm_index_at (const tm_index * index, size_t rank)
+{
+  return index->positions[rank];
+}
+
+tm_status
+tm_index_lowerbound (const tm_index * index, const struct tm *date, size_t *rank)
+{
+  errno = 0;
+  time_t t = tm_calendartime (date);
+
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
+
+  *rank = tm_indexlowerbound (index, t);
+
+  return TM_OK;
+}
+
+tm_status
+tm_index_upperbound (const tm_index * index, const struct tm *date, size_t *rank)
+{
+  errno = 0;
+  time_t t = tm_calendartime (date);
+
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
+
+  // Calendar times are whole seconds.
+  *rank = tm_indexlowerbound (index, (long long) t + 1);
+
+  return TM_OK;
+}
+
+tm_status
+tm_index_range (const tm_index * index, const struct tm *from, const struct tm *to, size_t *first, size_t *last)
+{
+  if (tm_index_lowerbound (index, from, first) == TM_ERROR || tm_index_lowerbound (index, to, last) == TM_ERROR)
+    return TM_ERROR;
+
+  if (*last < *first)
+    *last = *first;
+
+  return TM_OK;
+}
+
+tm_status
+tm_index_day (const tm_index * index, int year, tm_month month, int day, size_t *first, size_t *last)
+{
+  if (month < TM_MONTH_JANUARY || month > TM_MONTH_DECEMBER || day < 1 || day > tm_getdaysinmonth (year, month))
+  {
+    errno = EINVAL;
+    return TM_ERROR;
+  }
+
+  long long d = tm_daysfromcivil (year, month, (unsigned int) day);
+  long long begin, end;
+
+  if (index->nbdays)
+  {
+    // Straight from the directory
+    if (d < index->firstday || d >= index->firstday + (long long) index->nbdays)
+      *first = *last = d < index->firstday ? 0 : index->n;
+    else
+    {
+      *first = index->directory[d - index->firstday].rank;
+      *last = index->directory[d - index->firstday + 1].rank;
+    }
+    return TM_OK;
+  }
+
+  if (tm_walltocalendartime (index->representation, index->tz, d * 86400, &begin) == TM_ERROR
+      || tm_walltocalendartime (index->representation, index->tz, (d + 1) * 86400, &end) == TM_ERROR)
+    return TM_ERROR;
+
+  *first = tm_indexlowerbound (index, begin);
+  *last = tm_indexlowerbound (index, end);
+
+  return TM_OK;
+}
+
+void
+tm_index_free (tm_index * index)
+{
+  if (!index)
+    return;
+
+  free (index->keys);
+  free (index->positions);
+  free (index->directory);
+  free (index);
+}
+
+/*****************************************************
+*   TIMEZONES                                        *
+*****************************************************/
+
+const tm_timezone *
+tm_loadtimezone (const char *name)
+{
+  const tm_timezone *tz = name ? tm_findtimezone (name) : 0;
+
+  return tz && tz->since != tz->until ? tz : 0;
+}
+
+const tm_timezone *
+tm_getlocaltimezone (void)
+{
+  const tm_timezone *tz = tm_localtimezone ();
+
+  return tz && tz->since != tz->until ? tz : 0;
+}
+
+const char *
+tm_gettimezonename (const tm_timezone * tz)
+{
+  return tz->name;
+}
+
+const tm_timezone *
+tm_gettimezoneof (struct tm date)
+{
+  return tm_gettimezoneof_p (&date);
+}
+
+const tm_timezone *
+tm_gettimezoneof_p (const struct tm *date)
+{
+  return tm_isutcrepresentation_p (date) ? 0 : tm_timezoneof (date);
+}
+
+tm_status
+tm_makeintimezone (struct tm * tm, const tm_timezone * tz, int year, tm_month month, int day, int hour, int min, int sec)
+{
+  if (!tz)
+    return TM_ERROR;
+
+  tm->tm_year = year - 1900;
+  tm->tm_mon = month - 1;
+  tm->tm_mday = day;
+  tm->tm_hour = hour;
+  tm->tm_min = min;
+  tm->tm_sec = sec;
+
+  long long t;
+
+  if (!tm_localtocalendartimeintimezone (tz, tm_linearseconds (tm), -1, &t) || tm_breakdownintimezone (tz, t, tm) <= 0)
+    return TM_ERROR;
+
+  if (tm->tm_year == year - 1900 && tm->tm_mon == month - 1 && tm->tm_mday == day && tm->tm_hour == hour
+      && tm->tm_min == min && tm->tm_sec == sec)
+    return TM_OK;
+  else
+    return TM_ERROR;
+}
+
+tm_status
+tm_totimezonerepresentation (struct tm * date, const tm_timezone * tz)
+{
+  if (!tz)
+    return TM_ERROR;
+
+  errno = 0;
+  time_t t = tm_normalize (date);
+
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
+
+  struct tm result;
+  int ret = tm_breakdownintimezone (tz, t, &result);
+
+  if (ret == 0 && tz == tm_localtimezone ())
+    return tm_makelocalfromcalendartime (t, date);
+  if (ret <= 0)
+    return TM_ERROR;
+
+  *date = result;
+  return TM_OK;
+}
+
+size_t
+tm_getnbtransitions (const tm_timezone * tz)
+{
+  return tz ? tz->nbtransitions : 0;
+}
+
+tm_status
+tm_gettransition (const tm_timezone * tz, size_t index, tm_transition * transition)
+{
+  if (!tz || index >= tz->nbtransitions)
+    return TM_ERROR;
+
+  const tm_localtimetype *before = tm_getintervaltype (tz, (long long) index - 1);
+  const tm_localtimetype *after = tm_getintervaltype (tz, (long long) index);
+
+  transition->index = index;
+  transition->when = (time_t) tz->transitions[index];
+  transition->utcoffsetbefore = before->utcoffset;
+  transition->utcoffsetafter = after->utcoffset;
+  transition->isdstbefore = before->isdst;
+  transition->isdstafter = after->isdst;
+  transition->abbreviationbefore = before->abbreviation;
+  transition->abbreviationafter = after->abbreviation;
+
+  return TM_OK;
+}
+
+tm_status
+tm_nexttransition (const tm_timezone * tz, tm_instant instant, tm_transition * transition)
+{
+  if (!tz && !(tz = tm_getlocaltimezone ()))
+    return TM_ERROR;
+
+  // Transitions occur at whole seconds: the first transition after instant is the first one after its second.
+  return tm_gettransition (tz, tm_counttransitions (tz, tm_getinstantseconds (instant)), transition);
+}
+
+tm_status
+tm_prevtransition (const tm_timezone * tz, tm_instant instant, tm_transition * transition)
+{
+  if (!tz && !(tz = tm_getlocaltimezone ()))
+    return TM_ERROR;
+
+  size_t i = tm_counttransitions (tz, tm_getinstantseconds (instant));
+
+  return i ? tm_gettransition (tz, i - 1, transition) : TM_ERROR;
+}
+
+void
+tm_getintimezone (struct tm date, const char *tz, int *year, tm_month * month, int *day, int *hour, int *minute,
+                  int *second, int *isdst)
+{
+  const tm_timezone *zone = tm_loadtimezone (tz ? tz : TM_TZDEFAULT);
+
+  if (!zone || tm_totimezonerepresentation (&date, zone) == TM_ERROR)
+  {
+    // Timezone not available in the timezone database: switch environment variable TZ (not thread-safe.)
+    const char *oldtz = getenv ("TZ");
+
+    // Switch to UTC
+    tm_toutcrepresentation (&date);
+
+    // Switch to local time in timezone tz
+    if (tz)
+      setenv ("TZ", tz, 1);
+    else
+      unsetenv ("TZ");
+    tzset ();
+    time_t t = tm_normalizetoutc (&date);
+
+    localtime_r (&t, &date);
+
+    // Back to local timezone
+    if (oldtz)
+      setenv ("TZ", oldtz, 1);
+    else
+      unsetenv ("TZ");
+    tzset ();
+  }
+
+  if (year)
+    *year = tm_getyear (date);
+  if (month)
+    *month = tm_getmonth (date);
+  if (day)
+    *day = tm_getday (date);
+  if (hour)
+    *hour = tm_gethour (date);
+  if (minute)
+    *minute = tm_getminute (date);
+  if (second)
+    *second = tm_getsecond (date);
+  if (isdst)
+    *isdst = tm_isdaylightsavingtime (date);
+}
+
+time_t
+tm_tobinary (struct tm date)
+{
+  return tm_tobinary_p (&date);
+}
+
+time_t
+tm_tobinary_p (const struct tm *date)
+{
+  return tm_calendartime (date);
+}
+
+tm_status
+tm_frombinary (struct tm * date, time_t binary)
+{
+  return tm_makelocalfromcalendartime (binary, date);
+}
+
+/// Number of instants converted at once by tm_frombinary_n(), through the calendar kernels.
+#define TM_BATCHSIZE 256
+
+tm_status
+tm_tobinary_n (time_t * out, const struct tm * in, size_t n, tm_status * status)
+{
+  const tm_timezone *tz = tm_localtimezone ();
+  tm_intervalcache cache = { 0 };
+  tm_status ret = TM_OK;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const struct tm *date = &in[i];
+    long long t = tm_linearseconds (date);
+    tm_status st = TM_OK;
+
+    // Fast paths, for instants whose year can not overflow when broken down (around 68 million years from now):
+    // - UTC representation: no conversion;
+    // - local representation: local time type of the interval of the previous instant, if it applies without ambiguity.
+    int inrange = t > -(INT_MAX - 2000LL) * 31556952LL && t < (INT_MAX - 2000LL) * 31556952LL;
+
+    if (inrange && tm_isutcrepresentation_p (date))
+      out[i] = (time_t) t;
+    else if (inrange && cache.type && t >= cache.localfrom && t < cache.localto
+             && tm_matchesdst (cache.type, date->tm_isdst) && tm_ownsabbreviation (tz, date->tm_zone))
+      out[i] = (time_t) (t - cache.type->utcoffset);
+    else
+    {
+      struct tm copy = *date;
+
+      errno = 0;
+      out[i] = tm_normalize (&copy);
+      if (out[i] == (time_t) - 1 && errno)
+        st = TM_ERROR;
+      else if (tz && tm_islocalrepresentation (copy) && tm_ownsabbreviation (tz, copy.tm_zone))
+        tm_getlocaltimetype (tz, out[i], &cache);       // Keeps the interval for the next instants
+    }
+
+    if (status)
+      status[i] = st;
+    if (st == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  return ret;
+}
+
+tm_status
+tm_frombinary_n (struct tm * out, const time_t * in, size_t n, tm_representation representation, tm_status * status)
+{
+  const tm_timezone *tz = representation == TM_REP_UTC ? 0 : tm_localtimezone ();
+  const char *utc = tm_utctimezone ();
+  tm_intervalcache cache = { 0 };
+  tm_status ret = TM_OK;
+
+  // Instants are converted by blocks: local time types first, then dates all at once through the calendar kernels.
+  for (size_t first = 0; first < n; first += TM_BATCHSIZE)
+  {
+    size_t size = n - first < TM_BATCHSIZE ? n - first : TM_BATCHSIZE;
+    const tm_localtimetype *types[TM_BATCHSIZE];
+    unsigned char slow[TM_BATCHSIZE];
+    int32_t days[TM_BATCHSIZE], secs[TM_BATCHSIZE], year[TM_BATCHSIZE];
+    uint32_t month[TM_BATCHSIZE], day[TM_BATCHSIZE], yday[TM_BATCHSIZE], wday[TM_BATCHSIZE];
+
+    for (size_t i = 0; i < size; i++)
+    {
+      long long t = in[first + i];
+
+      types[i] = 0;
+      slow[i] = representation != TM_REP_UTC
+        && (!tz || t > LLONG_MAX / 2 || t < LLONG_MIN / 2 || !(types[i] = tm_getlocaltimetype (tz, t, &cache)));
+
+      long long local = slow[i] ? 0 : t + (types[i] ? types[i]->utcoffset : 0);
+      long long d = (local >= 0 ? local : local - 86399) / 86400;
+
+      if (d < TM_CIVILMINDAYS || d > TM_CIVILMAXDAYS)
+      {
+        slow[i] = 1;
+        d = 0;
+      }
+      days[i] = (int32_t) d;
+      secs[i] = (int32_t) (local - d * 86400);
+    }
+
+    tm_civilfromdays_n (size, days, year, month, day, yday, wday);
+
+    for (size_t i = 0; i < size; i++)
+    {
+      struct tm *tm = &out[first + i];
+      tm_status st = TM_OK;
+
+      if (slow[i])
+        // Not covered by the compiled rules of the local timezone, or out of the range of the calendar kernels
+        st = representation == TM_REP_UTC ? tm_makeutcfromcalendartime (in[first + i], tm)
+          : tm_makelocalfromcalendartime (in[first + i], tm);
+      else
+      {
+        tm->tm_year = year[i] - 1900;
+        tm->tm_mon = (int) month[i] - 1;
+        tm->tm_mday = (int) day[i];
+        tm->tm_hour = secs[i] / 3600;
+        tm->tm_min = secs[i] / 60 % 60;
+        tm->tm_sec = secs[i] % 60;
+        tm->tm_wday = (int) wday[i];
+        tm->tm_yday = (int) yday[i];
+        tm->tm_isdst = types[i] ? types[i]->isdst : 0;
+        tm->tm_gmtoff = types[i] ? types[i]->utcoffset : 0;
+        tm->tm_zone = types[i] ? types[i]->abbreviation : utc;
+      }
+
+      if (status)
+        status[first + i] = st;
+      if (st == TM_ERROR)
+        ret = TM_ERROR;
+    }
+  }
+
+  return ret;
+}
+
+/// Gets the beginning of the bucket of an instant out of the rules of the local timezone or out of the range of the calendar kernels.
+/// @param [in] representation Representation of buckets
+/// @param [in] t Calendar time
+/// @param [in] unit Unit of buckets
+/// @param [in] width Width of buckets, in seconds, for units of minutes and hours
+/// @param [out] start Calendar time of the beginning of the bucket
+/// @returns \p TM_OK or \p TM_ERROR (overflow)
+static tm_status
+tm_bucketslow (tm_representation representation, time_t t, tm_bucketunit unit, int32_t width, long long *start)
+{
+  struct tm date;
+  long long local;
+
+  if (representation == TM_REP_UTC)
+    local = t;
+  else if (tm_makelocalfromcalendartime (t, &date) == TM_OK)
+    local = (long long) t + date.tm_gmtoff;
+  else
+    return TM_ERROR;
+
+  long long d = (local >= 0 ? local : local - 86399) / 86400;
+
+  if (d < TM_CIVILMINDAYS || d > TM_CIVILMAXDAYS)
+  {
+    errno = EOVERFLOW;
+    return TM_ERROR;
+  }
+
+  int32_t days = (int32_t) d, secs = (int32_t) (local - d * 86400);
+
+  tm_bucketfloor_n (1, &days, &secs, unit, width);
+
+  long long truncated = (long long) days * 86400 + secs;
+
+  if (unit == TM_BUCKET_MINUTE || unit == TM_BUCKET_HOUR)
+  {
+    *start = t - (local - truncated);
+    return TM_OK;
+  }
+
+  return tm_walltocalendartime (representation, 0, truncated, start);
+}
+
+tm_status
+tm_bucket_n (time_t * out, const time_t * in, size_t n, tm_bucketunit unit, int size, tm_representation representation,
+             tm_status * status)
+{
+  if (unit < TM_BUCKET_MINUTE || unit > TM_BUCKET_YEAR || size < 1
+      || size > (unit == TM_BUCKET_MINUTE ? 1440 : unit == TM_BUCKET_HOUR ? 24 : 1))
+  {
+    errno = EINVAL;
+    return TM_ERROR;
+  }
+
+  int32_t width = unit == TM_BUCKET_MINUTE ? 60 * size : 3600 * size;
+  int subday = unit == TM_BUCKET_MINUTE || unit == TM_BUCKET_HOUR;
+  const tm_timezone *tz = representation == TM_REP_UTC ? 0 : tm_localtimezone ();
+  tm_intervalcache cache = { 0 };
+  long long lasttruncated = 0, laststart = 0;       // Bucket looked up last in the timezone database
+  int haslast = 0;
+  tm_status ret = TM_OK;
+
+  // Instants are truncated by blocks: local times first, then all at once through the calendar kernels.
+  for (size_t first = 0; first < n; first += TM_BATCHSIZE)
+  {
+    size_t count = n - first < TM_BATCHSIZE ? n - first : TM_BATCHSIZE;
+    long long offset[TM_BATCHSIZE], from[TM_BATCHSIZE], localfrom[TM_BATCHSIZE];
+    unsigned char slow[TM_BATCHSIZE];
+    int32_t days[TM_BATCHSIZE], secs[TM_BATCHSIZE];
+
+    for (size_t i = 0; i < count; i++)
+    {
+      long long t = in[first + i];
+      const tm_localtimetype *type = 0;
+
+      slow[i] = t > LLONG_MAX / 2 || t < LLONG_MIN / 2
+        || (representation != TM_REP_UTC && (!tz || !(type = tm_getlocaltimetype (tz, t, &cache))));
+      offset[i] = type ? type->utcoffset : 0;
+      from[i] = type ? cache.from : LLONG_MIN;
+      localfrom[i] = type ? cache.localfrom : LLONG_MIN;
+
+      long long local = slow[i] ? 0 : t + offset[i];
+      long long d = (local >= 0 ? local : local - 86399) / 86400;
+
+      if (d < TM_CIVILMINDAYS || d > TM_CIVILMAXDAYS)
+      {
+        slow[i] = 1;
+        d = 0;
+      }
+      days[i] = (int32_t) d;
+      secs[i] = (int32_t) (local - d * 86400);
+    }
+
+    tm_bucketfloor_n (count, days, secs, unit, width);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      long long t = in[first + i];
+      long long start = 0;
+      tm_status st = TM_OK;
+
+      if (slow[i])
+        st = tm_bucketslow (representation, in[first + i], unit, width, &start);
+      else
+      {
+        long long truncated = (long long) days[i] * 86400 + secs[i];
+        long long shift = t + offset[i] - truncated;
+
+        // The beginning of the bucket is in the interval of the instant:
+        // - minutes and hours keep the UTC offset of the instant (repeated hours are distinct buckets);
+        // - days, weeks, months... start at the earliest instant of their first local time, unless it is ambiguous.
+        if (subday ? t - shift >= from[i] : truncated >= localfrom[i])
+          start = t - shift;
+        else if (subday)
+        {
+          // Minutes and hours straddling a change of UTC offset are split at the change, whatever their width:
+          // instants with the same local time on either side of a backward transition never share a bucket.
+          tm_intervalcache before = { 0 };
+          const tm_localtimetype *type = tm_getlocaltimetype (tz, t - shift, &before);
+
+          start = type && type->utcoffset == offset[i] ? t - shift : from[i];
+        }
+        else if (haslast && truncated == lasttruncated)
+          start = laststart;
+        else if ((st = tm_walltocalendartime (representation, tz, truncated, &start)) == TM_OK)
+        {
+          haslast = 1;
+          lasttruncated = truncated;
+          laststart = start;
+        }
+      }
+
+      if (st == TM_OK && (long long) (time_t) start != start)
+      {
+        errno = EOVERFLOW;
+        st = TM_ERROR;
+      }
+
+      out[first + i] = st == TM_OK ? (time_t) start : (time_t) - 1;
+      if (status)
+        status[first + i] = st;
+      if (st == TM_ERROR)
+        ret = TM_ERROR;
+    }
+  }
+
+  return ret;
+}
+
+/// Bit of the flags of a record set for instants in local time representation.
+#define TM_RECORD_LOCAL 1
+/// Bit of the flags of a record set for instants in daylight saving time.
+#define TM_RECORD_DST 2
+/// Bias of UTC offsets in records, stored on 24 bits.
+#define TM_RECORD_OFFSETBIAS 0x800000L
+
+tm_status
+tm_torecord_n (tm_record * out, const struct tm * in, size_t n, tm_status * status)
+{
+  const char *zone = 0;         // Abbreviation of the previous instant
+  const tm_timezone *tz = 0;    // Timezone of the previous instant in local time representation
+  tm_intervalcache cache = { 0 };
+  tm_status ret = TM_OK;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const struct tm *date = &in[i];
+    long long t = 0, offset = 0;
+    unsigned int flags = 0;
+    uint32_t id = 0;
+    tm_status st = TM_OK;
+
+    if (tm_isutcrepresentation_p (date))
+    {
+      errno = 0;
+      t = tm_calendartime (date);
+      if (t == -1 && errno)
+        st = TM_ERROR;
+    }
+    else
+    {
+      if (!tz || date->tm_zone != zone)
+      {
+        const tm_timezone *previous = tz;
+
+        zone = date->tm_zone;
+        if ((tz = tm_timezoneof (date)) != previous)
+          cache.type = 0;
+      }
+
+      long long local = tm_linearseconds (date);
+      const tm_localtimetype *type = 0;
+
+      // Local time type of the interval of the previous instant, if it applies without ambiguity
+      if (tz && cache.type && local >= cache.localfrom && local < cache.localto && tm_matchesdst (cache.type, date->tm_isdst))
+      {
+        type = cache.type;
+        t = local - type->utcoffset;
+      }
+      else
+      {
+        errno = 0;
+        t = tm_calendartime (date);
+        if (t == -1 && errno)
+          st = TM_ERROR;
+        else if (tz && t <= LLONG_MAX / 2 && t >= LLONG_MIN / 2)
+          type = tm_getlocaltimetype (tz, t, &cache);
+      }
+
+      if (st == TM_ERROR || !tz)
+        ;
+      else if (type)
+      {
+        offset = type->utcoffset;
+        flags = TM_RECORD_LOCAL | (type->isdst ? TM_RECORD_DST : 0);
+        id = tz->id;
+      }
+      else
+      {
+        // Out of the rules of the timezone
+        struct tm copy = *date;
+
+        errno = 0;
+        if (tm_normalize (&copy) == -1 && errno)
+          st = TM_ERROR;
+        offset = copy.tm_gmtoff;
+        flags = TM_RECORD_LOCAL | (copy.tm_isdst > 0 ? TM_RECORD_DST : 0);
+        id = tz->id;
+      }
+      if (st == TM_OK && (!tz || !tz->id || offset <= -TM_RECORD_OFFSETBIAS || offset >= TM_RECORD_OFFSETBIAS))
+      {
+        // A timezone without identifier could not be told apart from others when read back.
+        errno = !tz ? ENOMEM : !tz->id ? EINVAL : EOVERFLOW;
+        st = TM_ERROR;
+      }
+    }
+
+    unsigned char *bytes = out[i].bytes;
+
+    if (st == TM_ERROR)
+      memset (bytes, 0, sizeof (out[i].bytes));
+    else
+    {
+      // Big-endian, sign bit of calendar time flipped: records sort as instants, then as UTC offsets.
+      uint64_t u = (uint64_t) t ^ ((uint64_t) 1 << 63);
+      uint32_t o = (uint32_t) (offset + TM_RECORD_OFFSETBIAS);
+
+      for (int b = 0; b < 8; b++)
+        bytes[b] = (unsigned char) (u >> (56 - 8 * b));
+      bytes[8] = (unsigned char) (o >> 16);
+      bytes[9] = (unsigned char) (o >> 8);
+      bytes[10] = (unsigned char) o;
+      bytes[11] = (unsigned char) flags;
+      for (int b = 0; b < 4; b++)
+        bytes[12 + b] = (unsigned char) (id >> (24 - 8 * b));
+    }
+
+    if (status)
+      status[i] = st;
+    if (st == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  return ret;
+}
+
+tm_status
+tm_fromrecord_n (struct tm * out, const tm_record * in, size_t n, tm_status * status)
+{
+  const tm_timezone *tz = 0;    // Timezone of the previous record in local time representation
+  const tm_localtimetype *type = 0;     // Local time type of the previous record in local time representation
+  tm_status ret = TM_OK;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    const unsigned char *bytes = in[i].bytes;
+    uint64_t u = 0;
+    uint32_t id = 0;
+    tm_status st = TM_OK;
+
+    for (int b = 0; b < 8; b++)
+      u = u << 8 | bytes[b];
+    for (int b = 0; b < 4; b++)
+      id = id << 8 | bytes[12 + b];
+
+    long long t = (long long) (u ^ ((uint64_t) 1 << 63));
+    long long offset = (long long) ((uint32_t) bytes[8] << 16 | (uint32_t) bytes[9] << 8 | bytes[10]) - TM_RECORD_OFFSETBIAS;
+    unsigned int flags = bytes[11];
+    struct tm *tm = &out[i];
+
+    if (flags & ~(TM_RECORD_LOCAL | TM_RECORD_DST) || (!(flags & TM_RECORD_LOCAL) && (id || offset || flags))
+        || t > LLONG_MAX / 2 || t < LLONG_MIN / 2)
+    {
+      errno = EINVAL;
+      st = TM_ERROR;
+    }
+    else if (!(flags & TM_RECORD_LOCAL))
+    {
+      if ((st = tm_breakdownutc (t, tm)) == TM_OK)
+      {
+        tm->tm_isdst = 0;
+        tm->tm_gmtoff = 0;
+        tm->tm_zone = tm_utctimezone ();
+      }
+    }
+    else
+    {
+      // The timezone and the local time type are found from the identifier and the UTC offset, without looking up transitions.
+      if (!tz || tz->id != id)
+      {
+        tz = tm_findtimezonebyid (id);
+        type = 0;
+      }
+      if (tz && !(type && type->utcoffset == offset && !type->isdst == !(flags & TM_RECORD_DST)))
+      {
+        type = 0;
+        for (size_t k = 0; !type && k < tz->nbtypes; k++)
+          if (tz->localtimetypes[k].utcoffset == offset && !tz->localtimetypes[k].isdst == !(flags & TM_RECORD_DST))
+            type = &tz->localtimetypes[k];
+      }
+
+      if (type)
+      {
+        if ((st = tm_breakdownutc (t + offset, tm)) == TM_OK)
+        {
+          tm->tm_isdst = type->isdst;
+          tm->tm_gmtoff = type->utcoffset;
+          tm->tm_zone = type->abbreviation;
+        }
+      }
+      else
+      {
+        // Timezone not loaded (see tm_loadtimezone()), or UTC offset unknown to its rules: never guessed from another timezone.
+        errno = tz ? EINVAL : ENOENT;
+        st = TM_ERROR;
+      }
+    }
+
+    if (status)
+      status[i] = st;
+    if (st == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  return ret;
+}
+
+tm_status
+tm_torecord (const struct tm * date, tm_record * record)
+{
+  return tm_torecord_n (record, date, 1, 0);
+}
+
+tm_status
+tm_fromrecord (struct tm * date, const tm_record * record)
+{
+  return tm_fromrecord_n (date, record, 1, 0);
+}
+
+/// Default number of values per block of encoded columns of calendar times.
+#define TM_CODEC_BLOCKSIZE 1024
+/// Maximum number of values per block of encoded columns of calendar times.
+#define TM_CODEC_MAXBLOCKSIZE 65536
+/// Size of the header of a block of an encoded column: size of the block (without header), number of values and first value.
+#define TM_CODEC_HEADERSIZE 16
+
+/// Writes a little-endian unsigned integer.
+static void
+tm_codecwrite (unsigned char *p, uint64_t u, int nbbytes)
+{
+  for (int b = 0; b < nbbytes; b++)
+    p[b] = (unsigned char) (u >> (8 * b));
+}
+
+/// Reads a little-endian unsigned integer.
+static uint64_t
+tm_codecread (const unsigned char *p, int nbbytes)
+{
+  uint64_t u = 0;
+
+  for (int b = nbbytes - 1; b >= 0; b--)
+    u = u << 8 | p[b];
+
+  return u;
+}
+
+/// Makes room for a token at the end of an encoded column.
+/// @returns \p TM_OK, or \p TM_ERROR if out of memory
+static tm_status
+tm_codecreserve (tm_timeencoder *enc, size_t size)
+{
+  if (enc->size + size <= enc->capacity)
+    return TM_OK;
+
+  size_t capacity = enc->capacity ? 2 * enc->capacity : 4096;
+  unsigned char *data;
+
+  while (capacity < enc->size + size)
+    capacity *= 2;
+  if (!(data = realloc (enc->data, capacity)))
+    return TM_ERROR;
+  enc->data = data;
+  enc->capacity = capacity;
+
+  return TM_OK;
+}
+
+/// Appends a token to an encoded column, as a LEB128 varint.
+static void
+tm_codecwritetoken (tm_timeencoder *enc, uint64_t token)
+{
+  while (token >= 0x80)
+  {
+    enc->data[enc->size++] = (unsigned char) (token | 0x80);
+    token >>= 7;
+  }
+  enc->data[enc->size++] = (unsigned char) token;
+}
+
+/// Appends a delta-of-delta to an encoded column.
+/// Tokens are varints of:
+/// - zig-zag(delta-of-delta) << 1, for delta-of-deltas in (-2^62, 2^62);
+/// - run << 1 | 1, for runs of zero delta-of-deltas;
+/// - 1, followed by 8 bytes, for other delta-of-deltas.
+static void
+tm_codecwritedod (tm_timeencoder *enc, uint64_t dod)
+{
+  uint64_t zigzag = dod << 1 ^ (0 - (dod >> 63));
+
+  if (zigzag >> 63)
+  {
+    tm_codecwritetoken (enc, 1);
+    tm_codecwrite (enc->data + enc->size, dod, 8);
+    enc->size += 8;
+  }
+  else
+    tm_codecwritetoken (enc, zigzag << 1);
+}
+
+void
+tm_timeencoder_init (tm_timeencoder * enc, size_t blocksize)
+{
+  memset (enc, 0, sizeof (*enc));
+  enc->blocksize = blocksize == 0 ? TM_CODEC_BLOCKSIZE : blocksize > TM_CODEC_MAXBLOCKSIZE ? TM_CODEC_MAXBLOCKSIZE : blocksize;
+}
+
+tm_status
+tm_timeencoder_flush (tm_timeencoder * enc)
+{
+  if (!enc->count)
+    return TM_OK;
+
+  if (enc->run)
+  {
+    if (tm_codecreserve (enc, 10) == TM_ERROR)
+      return TM_ERROR;
+    tm_codecwritetoken (enc, enc->run << 1 | 1);
+    enc->run = 0;
+  }
+
+  // Header of the current block
+  tm_codecwrite (enc->data + enc->header, enc->size - enc->header - TM_CODEC_HEADERSIZE, 4);
+  tm_codecwrite (enc->data + enc->header + 4, enc->count, 4);
+
+  return TM_OK;
+}
+
+tm_status
+tm_timeencoder_put_n (tm_timeencoder * enc, const time_t * in, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    // Calendar times are differentiated modulo 2^64: any sequence is encoded, without overflow.
+    uint64_t value = (uint64_t) (int64_t) in[i];
+
+    if (enc->count && enc->count < enc->blocksize)
+    {
+      uint64_t delta = value - enc->last;
+      uint64_t dod = delta - enc->delta;
+
+      if (dod == 0)
+        enc->run++;
+      else
+      {
+        if (tm_codecreserve (enc, 20) == TM_ERROR)
+          return TM_ERROR;
+        if (enc->run)
+        {
+          tm_codecwritetoken (enc, enc->run << 1 | 1);
+          enc->run = 0;
+        }
+        tm_codecwritedod (enc, dod);
+      }
+      enc->delta = delta;
+      enc->count++;
+    }
+    else
+    {
+      // New block, starting from its first value
+      if (tm_timeencoder_flush (enc) == TM_ERROR || tm_codecreserve (enc, TM_CODEC_HEADERSIZE) == TM_ERROR)
+        return TM_ERROR;
+      enc->header = enc->size;
+      tm_codecwrite (enc->data + enc->header, 0, 8);
+      tm_codecwrite (enc->data + enc->header + 8, value, 8);
+      enc->size += TM_CODEC_HEADERSIZE;
+      enc->delta = 0;
+      enc->count = 1;
+    }
+    enc->last = value;
+  }
+
+  return TM_OK;
+}
+
+tm_status
+tm_timeencoder_put (tm_timeencoder * enc, time_t t)
+{
+  return tm_timeencoder_put_n (enc, &t, 1);
+}
+
+void
+tm_timeencoder_free (tm_timeencoder * enc)
+{
+  free (enc->data);
+  memset (enc, 0, sizeof (*enc));
+}
+
+void
+tm_timedecoder_init (tm_timedecoder * dec, const unsigned char *data, size_t size)
+{
+  memset (dec, 0, sizeof (*dec));
+  dec->data = data;
+  dec->size = size;
+}
+
+/// Moves a decoder to the next block of its column.
+/// @returns 1 if the block starts with the next value, 0 at the end of the column or if the column is corrupted (errno is then set to EINVAL)
+static int
+tm_codecnextblock (tm_timedecoder *dec)
+{
+  dec->position = dec->blockend;
+  if (dec->size - dec->position < TM_CODEC_HEADERSIZE)
+  {
+    if (dec->position != dec->size)
+      errno = EINVAL;
+    return 0;
+  }
+
+  const unsigned char *header = dec->data + dec->position;
+  uint64_t size = tm_codecread (header, 4);
+  uint64_t count = tm_codecread (header + 4, 4);
+
+  if (count == 0 || size > dec->size - dec->position - TM_CODEC_HEADERSIZE)
+  {
+    errno = EINVAL;
+    return 0;
+  }
+
+  dec->position += TM_CODEC_HEADERSIZE;
+  dec->blockend = dec->position + size;
+  dec->remaining = count - 1;
+  dec->value = tm_codecread (header + 8, 8);
+  dec->delta = 0;
+  dec->run = 0;
+  dec->current = (time_t) (int64_t) dec->value;
+
+  return 1;
+}
+
+/// Reads the next token of the current block of a decoder, and applies it.
+/// @returns 1 on success, 0 if the column is corrupted (errno is then set to EINVAL)
+static int
+tm_codecreadtoken (tm_timedecoder *dec)
+{
+  uint64_t token = 0;
+  int shift = 0;
+  unsigned char byte;
+
+  do
+  {
+    if (dec->position >= dec->blockend || shift > 63)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+    byte = dec->data[dec->position++];
+    token |= (uint64_t) (byte & 0x7F) << shift;
+    shift += 7;
+  }
+  while (byte & 0x80);
+
+  if (token == 1)
+  {
+    // Delta-of-delta out of the range of zig-zag tokens
+    if (dec->blockend - dec->position < 8)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+    dec->delta += tm_codecread (dec->data + dec->position, 8);
+    dec->position += 8;
+  }
+  else if (token & 1)
+  {
+    if ((token >> 1) > dec->remaining)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+    dec->run = (token >> 1) - 1;
+  }
+  else
+  {
+    uint64_t zigzag = token >> 1;
+
+    dec->delta += zigzag >> 1 ^ (0 - (zigzag & 1));
+  }
+
+  dec->value += dec->delta;
+  dec->remaining--;
+  dec->current = (time_t) (int64_t) dec->value;
+
+  return 1;
+}
+
+int
+tm_timedecoder_next (tm_timedecoder * dec)
+{
+  if (dec->run)
+  {
+    dec->run--;
+    dec->remaining--;
+    dec->value += dec->delta;
+    dec->current = (time_t) (int64_t) dec->value;
+    return 1;
+  }
+
+  if (!dec->remaining)
+    return tm_codecnextblock (dec);
+
+  return tm_codecreadtoken (dec);
+}
+
+size_t
+tm_timedecoder_next_n (tm_timedecoder * dec, time_t * out, size_t n)
+{
+  size_t i = 0;
+
+  while (i < n)
+  {
+    if (dec->run)
+    {
+      // Runs of regular values are expanded at once.
+      size_t k = dec->run < n - i ? (size_t) dec->run : n - i;
+      uint64_t value = dec->value, delta = dec->delta;
+
+      for (size_t j = 0; j < k; j++)
+        out[i + j] = (time_t) (int64_t) (value += delta);
+      dec->value = value;
+      dec->run -= k;
+      dec->remaining -= k;
+      i += k;
+      dec->current = out[i - 1];
+    }
+    else if (tm_timedecoder_next (dec))
+      out[i++] = dec->current;
+    else
+      break;
+  }
+
+  return i;
+}
+
+tm_status
+tm_timedecoder_seek (tm_timedecoder * dec, size_t index)
+{
+  // Headers are walked from block to block, then the values of the block are decoded up to index.
+  size_t first = 0;
+
+  tm_timedecoder_init (dec, dec->data, dec->size);
+  while (dec->size - dec->blockend >= TM_CODEC_HEADERSIZE)
+  {
+    const unsigned char *header = dec->data + dec->blockend;
+    size_t count = (size_t) tm_codecread (header + 4, 4);
+
+    if (index < first + count)
+    {
+      for (size_t skip = index - first + 1; skip; skip--)
+        if (!tm_timedecoder_next (dec))
+          return TM_ERROR;
+      return TM_OK;
+    }
+
+    uint64_t size = tm_codecread (header, 4);
+
+    if (!count || size > dec->size - dec->blockend - TM_CODEC_HEADERSIZE)
+      break;
+    first += count;
+    dec->blockend += TM_CODEC_HEADERSIZE + (size_t) size;
+  }
+
+  errno = EINVAL;
+  return TM_ERROR;
+}
+
+/// Magic number of column files.
+#define TM_COLUMN_MAGIC "TMCOLv1\n"
+/// Byte order mark of column files, written in the byte order of the host.
+#define TM_COLUMN_BYTEORDER UINT64_C (0x0102030405060708)
+/// Size of the header of column files.
+#define TM_COLUMN_HEADERSIZE 64
+/// Default number of instants per block of column files.
+#define TM_COLUMN_BLOCKSIZE 4096
+
+/// Header of column files, followed by the zone map (minimum and maximum of each block) and the instants.
+typedef struct
+{
+  char magic[8];                ///< TM_COLUMN_MAGIC
+  uint64_t byteorder;           ///< TM_COLUMN_BYTEORDER
+  uint64_t count;               ///< Number of instants
+  uint64_t nbblocks;            ///< Number of blocks
+  uint32_t blocksize;           ///< Number of instants per block
+  uint32_t zone;                ///< Identifier of the timezone of the representation, 0 for UTC (see tm_timezoneid())
+  unsigned char reserved[TM_COLUMN_HEADERSIZE - 40];
+} tm_columnheader;
+
+struct tm_column
+{
+  void *map;                    ///< Mapped file
+  size_t mapsize;               ///< Size of the mapped file
+  const tm_columnheader *header;        ///< Header
+  const int64_t *zonemap;       ///< Minimum and maximum of each block
+  const time_t *values;         ///< Instants
+};
+
+tm_status
+tm_column_write (const char *path, const time_t * times, size_t n, tm_representation representation, size_t blocksize)
+{
+  const tm_timezone *tz = representation == TM_REP_UTC ? 0 : tm_localtimezone ();
+
+  if (sizeof (time_t) != sizeof (int64_t))
+  {
+    errno = ENOSYS;
+    return TM_ERROR;
+  }
+  if (representation != TM_REP_UTC && !tz)
+    return TM_ERROR;
+  if (tz && !tz->id)
+  {
+    // The local timezone could not be told apart from others when read back.
+    errno = EINVAL;
+    return TM_ERROR;
+  }
+
+  tm_columnheader header = { TM_COLUMN_MAGIC, TM_COLUMN_BYTEORDER, n, 0, 0, tz ? tz->id : 0, {0} };
+
+  header.blocksize = blocksize == 0 ? TM_COLUMN_BLOCKSIZE : blocksize > UINT32_MAX ? UINT32_MAX : (uint32_t) blocksize;
+  header.nbblocks = (n + header.blocksize - 1) / header.blocksize;
+
+  int64_t *zonemap = malloc (header.nbblocks ? 2 * header.nbblocks * sizeof (*zonemap) : 1);
+
+  if (!zonemap)
+    return TM_ERROR;
+
+  for (size_t block = 0; block < header.nbblocks; block++)
+  {
+    size_t first = block * header.blocksize;
+    size_t last = n - first < header.blocksize ? n : first + header.blocksize;
+    int64_t min = INT64_MAX, max = INT64_MIN;
+
+    for (size_t i = first; i < last; i++)
+    {
+      if (times[i] < min)
+        min = times[i];
+      if (times[i] > max)
+        max = times[i];
+    }
+    zonemap[2 * block] = min;
+    zonemap[2 * block + 1] = max;
+  }
+
+  // The file is written aside, then renamed over path: path is left untouched if the file can not be written entirely.
+  static atomic_uint nbtemporaries = 0;
+  char temporary[4096];
+  int fd = snprintf (temporary, sizeof (temporary), "%s.%ld.%u.tmp", path, (long) getpid (), atomic_fetch_add (&nbtemporaries, 1))
+    < (int) sizeof (temporary) ? open (temporary, O_WRONLY | O_CREAT | O_EXCL, 0666) : (errno = ENAMETOOLONG, -1);
+  FILE *f = fd < 0 ? 0 : fdopen (fd, "wb");
+  tm_status ret = f && fwrite (&header, sizeof (header), 1, f) == 1
+    && fwrite (zonemap, sizeof (*zonemap), 2 * header.nbblocks, f) == 2 * header.nbblocks
+    && fwrite (times, sizeof (*times), n, f) == n ? TM_OK : TM_ERROR;
+
+  free (zonemap);
+  if (f && fclose (f))
+    ret = TM_ERROR;
+  else if (!f && fd >= 0)
+    close (fd);
+  if (fd >= 0 && (ret == TM_ERROR || rename (temporary, path)))
+  {
+    int err = errno;
+
+    unlink (temporary);
+    errno = err;
+    ret = TM_ERROR;
+  }
+
+  return ret;
+}
+
+tm_column *
+tm_column_open (const char *path)
+{
+  int fd = open (path, O_RDONLY);
+
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  tm_column *col = calloc (1, sizeof (*col));
+
+  if (!col || fstat (fd, &st))
+    ;
+  else if (st.st_size < TM_COLUMN_HEADERSIZE)
+    errno = EINVAL;             // Too short for a header
+  else if ((col->map = mmap (0, col->mapsize = (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED)
+    col->header = col->map;
+  close (fd);
+  if (!col || !col->header)
+  {
+    free (col);
+    return 0;
+  }
+
+  // The file is checked before any of its instants are trusted.
+  const tm_columnheader *header = col->header;
+  size_t blocksize = header->blocksize;
+
+  if (sizeof (time_t) != sizeof (int64_t) || memcmp (header->magic, TM_COLUMN_MAGIC, sizeof (header->magic))
+      || header->byteorder != TM_COLUMN_BYTEORDER || !blocksize
+      || header->nbblocks != header->count / blocksize + (header->count % blocksize != 0)
+      || header->nbblocks > (col->mapsize - TM_COLUMN_HEADERSIZE) / 16
+      || header->count > (col->mapsize - TM_COLUMN_HEADERSIZE - 16 * header->nbblocks) / 8)
+  {
+    munmap (col->map, col->mapsize);
+    free (col);
+    errno = EINVAL;
+    return 0;
+  }
+
+  col->zonemap = (const int64_t *) ((const unsigned char *) col->map + TM_COLUMN_HEADERSIZE);
+  col->values = (const time_t *) (col->zonemap + 2 * header->nbblocks);
+
+  return col;
+}
+
+size_t
+tm_column_size (const tm_column * col)
+{
+  return (size_t) col->header->count;
+}
+
+const time_t *
+tm_column_values (const tm_column * col)
+{
+  return col->values;
+}
+
+tm_representation
+tm_column_representation (const tm_column * col)
+{
+  return col->header->zone ? TM_REP_LOCAL : TM_REP_UTC;
+}
+
+const tm_timezone *
+tm_column_timezone (const tm_column * col)
+{
+  return tm_findtimezonebyid (col->header->zone);
+}
+
+int
+tm_column_scan (const tm_column * col, time_t from, time_t to, size_t *block, const time_t ** values, size_t *n)
+{
+  const tm_columnheader *header = col->header;
+
+  // Blocks whose range [min, max] does not meet [from, to) are skipped without touching their instants.
+  for (; *block < header->nbblocks; (*block)++)
+    if (col->zonemap[2 * *block] < to && col->zonemap[2 * *block + 1] >= from)
+    {
+      size_t first = *block * header->blocksize;
+
+      *values = col->values + first;
+      *n = header->count - first < header->blocksize ? (size_t) (header->count - first) : header->blocksize;
+      return 1;
+    }
+
+  return 0;
+}
+
+void
+tm_column_close (tm_column * col)
+{
+  if (!col)
+    return;
+
+  munmap (col->map, col->mapsize);
+  free (col);
+}
+
+/*****************************************************
+*   INSTANTS                                         *
+*****************************************************/
+
+/// Number of nanoseconds in a second.
+#define TM_NANOSECONDS_PER_SECOND 1000000000LL
+
+tm_status
+tm_makeinstant (tm_instant * instant, time_t seconds, long int nanoseconds)
+{
+  tm_instant result;
+
+  if (__builtin_mul_overflow ((long long) seconds, TM_NANOSECONDS_PER_SECOND, &result)
+      || __builtin_add_overflow (result, nanoseconds, &result))
+    return TM_ERROR;
+
+  *instant = result;
+  return TM_OK;
+}
+
+tm_status
+tm_makeinstantnow (tm_instant * instant)
+{
+  struct timespec now;
+
+  if (tm_clocknow (&now) == TM_ERROR)
+    return TM_ERROR;
+
+  return tm_makeinstant (instant, now.tv_sec, now.tv_nsec);
+}
+
+tm_status
+tm_toinstant (struct tm date, tm_instant * instant)
+{
+  return tm_toinstant_p (&date, instant);
+}
+
+tm_status
+tm_toinstant_p (const struct tm *date, tm_instant * instant)
+{
+  errno = 0;
+  time_t t = tm_calendartime (date);
+
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
+
+  return tm_makeinstant (instant, t, 0);
+}
+
+tm_status
+tm_frominstant (struct tm * date, tm_instant instant, tm_representation representation)
+{
+  if (representation == TM_REP_UTC)
+    return tm_makeutcfromcalendartime (tm_getinstantseconds (instant), date);
+  else
+    return tm_makelocalfromcalendartime (tm_getinstantseconds (instant), date);
+}
+
+time_t
+tm_getinstantseconds (tm_instant instant)
+{
+  // Division rounded towards the past
+  return instant / TM_NANOSECONDS_PER_SECOND - (instant % TM_NANOSECONDS_PER_SECOND < 0);
+}
+
+long int
+tm_getinstantnanoseconds (tm_instant instant)
+{
+  long int ns = instant % TM_NANOSECONDS_PER_SECOND;
+
+  return ns < 0 ? ns + TM_NANOSECONDS_PER_SECOND : ns;
+}
+
+tm_status
+tm_instantaddseconds (tm_instant * instant, long long int nbSecs)
+{
+  tm_instant result;
+
+  if (__builtin_mul_overflow (nbSecs, TM_NANOSECONDS_PER_SECOND, &result)
+      || __builtin_add_overflow (*instant, result, &result))
+    return TM_ERROR;
+
+  *instant = result;
+  return TM_OK;
+}
+
+tm_status
+tm_instantaddnanoseconds (tm_instant * instant, long long int nbNanosecs)
+{
+  tm_instant result;
+
+  if (__builtin_add_overflow (*instant, nbNanosecs, &result))
+    return TM_ERROR;
+
+  *instant = result;
+  return TM_OK;
+}
+
+int64_t
+tm_instantdiffnanoseconds (tm_instant debut, tm_instant fin)
+{
+  int64_t diff;
+
+  if (__builtin_sub_overflow (fin, debut, &diff))
+  {
+    errno = ERANGE;
+    return fin > debut ? INT64_MAX : INT64_MIN;
+  }
+
+  return diff;
+}
+
+long int
+tm_instantdiffseconds (tm_instant debut, tm_instant fin)
+{
+  // Computed on seconds and fractions of second separately, to avoid overflow.
+  long int secs = tm_getinstantseconds (fin) - tm_getinstantseconds (debut);
+  long int nanosecs = tm_getinstantnanoseconds (fin) - tm_getinstantnanoseconds (debut);
+
+  // Truncated towards zero, as complete seconds
+  if (secs > 0 && nanosecs < 0)
+    secs--;
+  else if (secs < 0 && nanosecs > 0)
+    secs++;
+
+  return secs;
+}
+
+int
+tm_instantcompare (const void *pdebut, const void *pfin)
+{
+  tm_instant debut = *(const tm_instant *) pdebut;
+  tm_instant fin = *(const tm_instant *) pfin;
+
+  return debut < fin ? -1 : (debut > fin ? 1 : 0);
+}
+
+tm_status
+tm_parseiso8601 (const char *str, size_t len, tm_instant * instant, long int *utcoffset)
+{
+  const char *end = str + len, *p;
+  long long days;
+  int hms[3] = { 0, 0, 0 };
+  long int nanoseconds = 0, offset = 0;
+  int local = 1;
+
+  if (!(p = tm_parseisodate (str, end, &days)))
+    return TM_ERROR;
+  if (p < end && (*p == 'T' || *p == 't' || *p == ' '))
+  {
+    if (!(p = tm_parseisotime (p + 1, end, hms, &nanoseconds)))
+      return TM_ERROR;
+    if (p < end)
+    {
+      if (!(p = tm_parseisooffset (p, end, &offset)))
+        return TM_ERROR;
+      local = 0;
+    }
+  }
+  if (p != end)
+    return TM_ERROR;
+
+  long long t = days * 86400 + hms[0] * 3600 + hms[1] * 60 + hms[2];
+
+  if (local)
+  {
+    // No offset to UTC: local time
+    const tm_timezone *tz = tm_localtimezone ();
+    long long localtime = t;
+
+    if (!tz || !tm_localtocalendartimeintimezone (tz, localtime, -1, &t))
+    {
+      struct tm tm;
+
+      if (tm_breakdownutc (localtime, &tm) == TM_ERROR)
+        return TM_ERROR;
+      tm.tm_isdst = -1;
+      errno = 0;
+      t = tm_normalizetolocal (&tm);
+      if (t == -1 && errno)
+        return TM_ERROR;
+    }
+    offset = (long int) (localtime - t);
+  }
+  else
+    t -= offset;
+
+  if ((long long) (time_t) t != t || tm_makeinstant (instant, (time_t) t, nanoseconds) == TM_ERROR)
+    return TM_ERROR;
+
+  if (utcoffset)
+    *utcoffset = offset;
+  return TM_OK;
+}
+
+tm_status
+tm_getinstantiso8601intostring (tm_instant instant, tm_representation representation, int digits, char *str,
+                                size_t max, size_t *length)
+{
+  struct tm tm;
+  char buffer[64];
+
+  if (tm_frominstant (&tm, instant, representation) == TM_ERROR)
+    return TM_ERROR;
+
+  return tm_copyformatted (buffer,
+                           tm_writeiso8601 (buffer, &tm, tm_getinstantnanoseconds (instant), digits,
+                                            representation == TM_REP_UTC), str, max, length);
+}
+
+/*****************************************************
+*   COMPILED FORMATS                                 *
+*****************************************************/
+
+/// Operations of a compiled format.
+typedef enum
+{
+  TM_FORMAT_TEXT,               ///< Literal text
+  TM_FORMAT_STRFTIME,           ///< Conversion delegated to strftime()
+  TM_FORMAT_YEAR,               ///< %Y
+  TM_FORMAT_CENTURY,            ///< %C
+  TM_FORMAT_YEAROFCENTURY,      ///< %y
+  TM_FORMAT_MONTH,              ///< %m
+  TM_FORMAT_DAY,                ///< %d
+  TM_FORMAT_DAYSPACE,           ///< %e
+  TM_FORMAT_HOUR,               ///< %H
+  TM_FORMAT_HOURSPACE,          ///< %k
+  TM_FORMAT_HOUR12,             ///< %I
+  TM_FORMAT_HOUR12SPACE,        ///< %l
+  TM_FORMAT_MINUTE,             ///< %M
+  TM_FORMAT_SECOND,             ///< %S
+  TM_FORMAT_DAYOFYEAR,          ///< %j
+  TM_FORMAT_ISOWEEKDAY,         ///< %u
+  TM_FORMAT_WEEKDAY,            ///< %w
+  TM_FORMAT_WEEKDAYABBREVIATION,        ///< %a
+  TM_FORMAT_WEEKDAYNAME,        ///< %A
+  TM_FORMAT_MONTHABBREVIATION,  ///< %b, %h
+  TM_FORMAT_MONTHNAME,          ///< %B
+  TM_FORMAT_AMPM,               ///< %p
+  TM_FORMAT_AMPMLOWER,          ///< %P
+  TM_FORMAT_UTCOFFSET,          ///< %z
+  TM_FORMAT_TIMEZONE,           ///< %Z
+} tm_formatopcode;
+
+/// Operation of a compiled format.
+typedef struct
+{
+  tm_formatopcode opcode;
+  size_t offset;                ///< Literal text or conversion specification (delegated to strftime() if need be), in the text of the program
+  size_t length;                ///< Length of the literal text or conversion specification
+  char immediate[8];            ///< Copy of short literal texts, padded with null bytes, copied at once
+} tm_formatop;
+
+/// Names of the locale, in the text of the program
+typedef struct
+{
+  size_t offset;
+  size_t length;
+} tm_formatname;
+
+struct tm_format
+{
+  tm_formatop *ops;
+  size_t nbops;
+  char *text;                   ///< Literal texts, names and conversion specifications, null terminated
+  size_t textlength;
+  tm_formatname weekdayabbreviations[7], weekdaynames[7], monthabbreviations[12], monthnames[12], ampm[2], ampmlower[2];
+};
+
+/// Appends a string to the text of a compiled format.
+/// @returns Offset of the string in the text, or (size_t)-1 if out of memory
+static size_t
+tm_formataddtext (tm_format *prog, const char *str, size_t length)
+{
+  char *text = realloc (prog->text, prog->textlength + length + 1);
+
+  if (!text)
+    return (size_t) - 1;
+
+  size_t offset = prog->textlength;
+
+  memcpy (text + offset, str, length);
+  text[offset + length] = 0;
+  prog->text = text;
+  prog->textlength += length + 1;
+
+  return offset;
+}
+
+/// Appends an operation to a compiled format.
+/// @returns \p TM_OK or \p TM_ERROR if out of memory
+static tm_status
+tm_formataddop (tm_format *prog, tm_formatopcode opcode, const char *str, size_t length)
+{
+  size_t offset;
+
+  if (opcode == TM_FORMAT_TEXT && prog->nbops && prog->ops[prog->nbops - 1].opcode == TM_FORMAT_TEXT
+      && prog->ops[prog->nbops - 1].offset + prog->ops[prog->nbops - 1].length + 1 == prog->textlength)
+  {
+    // Consecutive literal texts are merged.
+    tm_formatop *last = &prog->ops[prog->nbops - 1];
+    char *text = realloc (prog->text, prog->textlength + length);
+
+    if (!text)
+      return TM_ERROR;
+    memcpy (text + last->offset + last->length, str, length);
+    text[last->offset + last->length + length] = 0;
+    prog->text = text;
+    prog->textlength += length;
+    last->length += length;
+    memset (last->immediate, 0, sizeof (last->immediate));
+    if (last->length <= sizeof (last->immediate))
+      memcpy (last->immediate, text + last->offset, last->length);
+
+    return TM_OK;
+  }
+
+  // The conversion specification is kept for delegation to strftime().
+  if ((offset = tm_formataddtext (prog, str, length)) == (size_t) - 1)
+    return TM_ERROR;
+
+  tm_formatop *ops = realloc (prog->ops, (prog->nbops + 1) * sizeof (*ops));
+
+  if (!ops)
+    return TM_ERROR;
+
+  ops[prog->nbops].opcode = opcode;
+  ops[prog->nbops].offset = offset;
+  ops[prog->nbops].length = length;
+  memset (ops[prog->nbops].immediate, 0, sizeof (ops[prog->nbops].immediate));
+  if (length <= sizeof (ops[prog->nbops].immediate))
+    memcpy (ops[prog->nbops].immediate, str, length);
+  prog->ops = ops;
+  prog->nbops++;
+
+  return TM_OK;
+}
+
+/// Stores a name of the locale, as formatted by strftime(), in the text of a compiled format.
+/// @returns \p TM_OK or \p TM_ERROR if out of memory
+static tm_status
+tm_formataddname (tm_format *prog, tm_formatname *name, const char *conversion, const struct tm *tm)
+{
+  char buffer[256];
+  size_t length = strftime (buffer, sizeof (buffer), conversion, tm);
+
+  name->length = length;
+  name->offset = tm_formataddtext (prog, buffer, length);
+
+  return name->offset == (size_t) - 1 ? TM_ERROR : TM_OK;
+}
+
+/// Compiles a strftime() format into the operations of a program.
+/// @param [in,out] prog Compiled format
+/// @param [in] fmt Format
+/// @param [in] depth Depth of recursion of composite conversions (such as %c)
+/// @returns \p TM_OK or \p TM_ERROR if out of memory
+static tm_status
+tm_formatcompileops (tm_format *prog, const char *fmt, int depth)
+{
+  // C/POSIX locale: composite conversions are known in advance, without any call to nl_langinfo().
+  const char *locale = setlocale (LC_TIME, 0);
+  int posix = !locale || !strcmp (locale, "C") || !strcmp (locale, "POSIX");
+
+  while (*fmt)
+  {
+    const char *percent = strchr (fmt, '%');
+
+    if (percent != fmt)
+    {
+      size_t length = percent ? (size_t) (percent - fmt) : strlen (fmt);
+
+      if (tm_formataddop (prog, TM_FORMAT_TEXT, fmt, length) == TM_ERROR)
+        return TM_ERROR;
+      fmt += length;
+      continue;
+    }
+
+    // Conversion specification: %[flags][width][modifier]conversion
+    const char *spec = fmt++;
+
+    fmt += strspn (fmt, "_-0^#");
+    fmt += strspn (fmt, "0123456789");
+    if (*fmt == 'E' || *fmt == 'O')
+      fmt++;
+    if (*fmt)
+      fmt++;
+
+    size_t length = (size_t) (fmt - spec);
+    const char *composite = 0;
+    tm_formatopcode opcode = TM_FORMAT_STRFTIME;
+
+    // Conversions with flags, width or modifier are delegated to strftime().
+    if (length == 2)
+      switch (spec[1])
+      {
+        case '%':
+          opcode = TM_FORMAT_TEXT;
+          spec++;
+          length = 1;
+          break;
+        case 'n':
+          opcode = TM_FORMAT_TEXT;
+          spec = "\n";
+          length = 1;
+          break;
+        case 't':
+          opcode = TM_FORMAT_TEXT;
+          spec = "\t";
+          length = 1;
+          break;
+        case 'Y':
+          opcode = TM_FORMAT_YEAR;
+          break;
+        case 'C':
+          opcode = TM_FORMAT_CENTURY;
+          break;
+        case 'y':
+          opcode = TM_FORMAT_YEAROFCENTURY;
+          break;
+        case 'm':
+          opcode = TM_FORMAT_MONTH;
+          break;
+        case 'd':
+          opcode = TM_FORMAT_DAY;
+          break;
+        case 'e':
+          opcode = TM_FORMAT_DAYSPACE;
+          break;
+        case 'H':
+          opcode = TM_FORMAT_HOUR;
+          break;
+        case 'k':
+          opcode = TM_FORMAT_HOURSPACE;
+          break;
+        case 'I':
+          opcode = TM_FORMAT_HOUR12;
+          break;
+        case 'l':
+          opcode = TM_FORMAT_HOUR12SPACE;
+          break;
+        case 'M':
+          opcode = TM_FORMAT_MINUTE;
+          break;
+        case 'S':
+          opcode = TM_FORMAT_SECOND;
+          break;
+        case 'j':
+          opcode = TM_FORMAT_DAYOFYEAR;
+          break;
+        case 'u':
+          opcode = TM_FORMAT_ISOWEEKDAY;
+          break;
+        case 'w':
+          opcode = TM_FORMAT_WEEKDAY;
+          break;
+        case 'a':
+          opcode = TM_FORMAT_WEEKDAYABBREVIATION;
+          break;
+        case 'A':
+          opcode = TM_FORMAT_WEEKDAYNAME;
+          break;
+        case 'b':
+        case 'h':
+          opcode = TM_FORMAT_MONTHABBREVIATION;
+          break;
+        case 'B':
+          opcode = TM_FORMAT_MONTHNAME;
+          break;
+        case 'p':
+          opcode = TM_FORMAT_AMPM;
+          break;
+        case 'P':
+          opcode = TM_FORMAT_AMPMLOWER;
+          break;
+        case 'z':
+          opcode = TM_FORMAT_UTCOFFSET;
+          break;
+        case 'Z':
+          opcode = TM_FORMAT_TIMEZONE;
+          break;
+        case 'D':
+          composite = "%m/%d/%y";
+          break;
+        case 'F':
+          composite = "%Y-%m-%d";
+          break;
+        case 'R':
+          composite = "%H:%M";
+          break;
+        case 'T':
+          composite = "%H:%M:%S";
+          break;
+        case 'c':
+          composite = posix ? "%a %b %e %H:%M:%S %Y" : nl_langinfo (D_T_FMT);
+          break;
+        case 'x':
+          composite = posix ? "%m/%d/%y" : nl_langinfo (D_FMT);
+          break;
+        case 'X':
+          composite = posix ? "%H:%M:%S" : nl_langinfo (T_FMT);
+          break;
+        case 'r':
+          composite = posix ? "%I:%M:%S %p" : nl_langinfo (T_FMT_AMPM);
+          break;
+      }
+
+    if (composite && depth < 4 && *composite)
+    {
+      if (tm_formatcompileops (prog, composite, depth + 1) == TM_ERROR)
+        return TM_ERROR;
+    }
+    else if (tm_formataddop (prog, opcode, spec, length) == TM_ERROR)
+      return TM_ERROR;
+  }
+
+  return TM_OK;
+}
+
+tm_format *
+tm_format_compile (const char *fmt)
+{
+  tm_format *prog = calloc (1, sizeof (*prog));
+
+  if (!prog)
+    return 0;
+
+  // Names of the current locale
+  struct tm tm = { 0 };
+  tm_status ret = tm_formataddtext (prog, "", 0) == (size_t) - 1 ? TM_ERROR : TM_OK;
+
+  for (int i = 0; i < 7 && ret == TM_OK; i++)
+  {
+    tm.tm_wday = i;
+    if (tm_formataddname (prog, &prog->weekdayabbreviations[i], "%a", &tm) == TM_ERROR
+        || tm_formataddname (prog, &prog->weekdaynames[i], "%A", &tm) == TM_ERROR)
+      ret = TM_ERROR;
+  }
+  for (int i = 0; i < 12 && ret == TM_OK; i++)
+  {
+    tm.tm_mon = i;
+    if (tm_formataddname (prog, &prog->monthabbreviations[i], "%b", &tm) == TM_ERROR
+        || tm_formataddname (prog, &prog->monthnames[i], "%B", &tm) == TM_ERROR)
+      ret = TM_ERROR;
+  }
+  for (int i = 0; i < 2 && ret == TM_OK; i++)
+  {
+    tm.tm_hour = 12 * i;
+    if (tm_formataddname (prog, &prog->ampm[i], "%p", &tm) == TM_ERROR
+        || tm_formataddname (prog, &prog->ampmlower[i], "%P", &tm) == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  if (ret == TM_ERROR || tm_formatcompileops (prog, fmt, 0) == TM_ERROR)
+  {
+    tm_format_free (prog);
+    return 0;
+  }
+
+  return prog;
+}
+
+void
+tm_format_free (tm_format * prog)
+{
+  if (!prog)
+    return;
+
+  free (prog->ops);
+  free (prog->text);
+  free (prog);
+}
+
+/// Applies a conversion delegated to strftime(), straight into the output buffer.
+/// @param [out] p Output
+/// @param [in] end End of the output buffer
+/// @param [in] conversion Conversion specification
+/// @param [in] tm Broken-down time structure
+/// @returns Pointer past the output of the conversion, or 0 if it does not fit in the buffer
+static char *
+tm_formatstrftime (char *p, char *end, const char *conversion, const struct tm *tm)
+{
+  size_t length = strftime (p, (size_t) (end - p), conversion, tm);
+
+  if (length)
+    return p + length;
+
+  // strftime() returns 0 for empty outputs as well as for outputs that do not fit: told apart by a leading character.
+  size_t size = strlen (conversion) + 2;
+  char probe[2], local[64];
+  char *fmt = size <= sizeof (local) ? local : malloc (size);
+
+  if (!fmt)
+    return 0;
+  fmt[0] = 'x';
+  memcpy (fmt + 1, conversion, size - 1);
+  length = strftime (probe, sizeof (probe), fmt, tm);
+  if (fmt != local)
+    free (fmt);
+
+  return length == 1 ? p : 0;
+}
+
+/// Formats date and time according to a compiled format (see tm_format_exec()).
+/// @returns The number of bytes placed in \p buf, not including the terminating null byte (possibly 0 for an empty result),
+/// or (size_t) -1 if the result string, including the terminating null byte, exceeds \p len bytes
+static size_t
+tm_formatrun (const tm_format *prog, const struct tm *tm, char *buf, size_t len)
+{
+  char *p = buf;
+  char *end = buf + len;        // The terminating null byte must fit as well.
+
+  for (size_t i = 0; i < prog->nbops; i++)
+  {
+    const tm_formatop *op = &prog->ops[i];
+    const tm_formatname *name = 0;
+    const char *text = 0;
+    size_t length = 0;
+    char digits[16];
+    int number = 0, value = 0, width = 2, pad = '0';
+
+    // Values out of their usual range are delegated to strftime(), which formats them its own way.
+    switch (op->opcode)
+    {
+      case TM_FORMAT_TEXT:
+        if (op->length <= sizeof (op->immediate) && (size_t) (end - p) > sizeof (op->immediate))
+        {
+          memcpy (p, op->immediate, sizeof (op->immediate));
+          p += op->length;
+          continue;
+        }
+        text = prog->text + op->offset;
+        length = op->length;
+        break;
+      case TM_FORMAT_YEAR:
+      case TM_FORMAT_CENTURY:
+      case TM_FORMAT_YEAROFCENTURY:
+        number = tm->tm_year >= 1000 - 1900 && tm->tm_year <= 9999 - 1900;
+        value = tm->tm_year + 1900;
+        if (op->opcode == TM_FORMAT_YEAR)
+          width = 4;
+        else
+          value = op->opcode == TM_FORMAT_CENTURY ? value / 100 : value % 100;
+        break;
+      case TM_FORMAT_MONTH:
+        number = tm->tm_mon >= 0 && tm->tm_mon <= 11;
+        value = tm->tm_mon + 1;
+        break;
+      case TM_FORMAT_DAYSPACE:
+        pad = ' ';
+        /* FALLTHRU */
+      case TM_FORMAT_DAY:
+        number = tm->tm_mday >= 1 && tm->tm_mday <= 31;
+        value = tm->tm_mday;
+        break;
+      case TM_FORMAT_HOURSPACE:
+        pad = ' ';
+        /* FALLTHRU */
+      case TM_FORMAT_HOUR:
+        number = tm->tm_hour >= 0 && tm->tm_hour <= 23;
+        value = tm->tm_hour;
+        break;
+      case TM_FORMAT_HOUR12SPACE:
+        pad = ' ';
+        /* FALLTHRU */
+      case TM_FORMAT_HOUR12:
+        number = tm->tm_hour >= 0 && tm->tm_hour <= 23;
+        value = tm->tm_hour % 12 ? tm->tm_hour % 12 : 12;
+        break;
+      case TM_FORMAT_MINUTE:
+        number = tm->tm_min >= 0 && tm->tm_min <= 59;
+        value = tm->tm_min;
+        break;
+      case TM_FORMAT_SECOND:
+        number = tm->tm_sec >= 0 && tm->tm_sec <= 60;
+        value = tm->tm_sec;
+        break;
+      case TM_FORMAT_DAYOFYEAR:
+        number = tm->tm_yday >= 0 && tm->tm_yday <= 365;
+        value = tm->tm_yday + 1;
+        width = 3;
+        break;
+      case TM_FORMAT_ISOWEEKDAY:
+      case TM_FORMAT_WEEKDAY:
+        number = tm->tm_wday >= 0 && tm->tm_wday <= 6;
+        value = op->opcode == TM_FORMAT_ISOWEEKDAY && tm->tm_wday == 0 ? 7 : tm->tm_wday;
+        width = 1;
+        break;
+      case TM_FORMAT_WEEKDAYABBREVIATION:
+        if (tm->tm_wday >= 0 && tm->tm_wday <= 6)
+          name = &prog->weekdayabbreviations[tm->tm_wday];
+        break;
+      case TM_FORMAT_WEEKDAYNAME:
+        if (tm->tm_wday >= 0 && tm->tm_wday <= 6)
+          name = &prog->weekdaynames[tm->tm_wday];
+        break;
+      case TM_FORMAT_MONTHABBREVIATION:
+        if (tm->tm_mon >= 0 && tm->tm_mon <= 11)
+          name = &prog->monthabbreviations[tm->tm_mon];
+        break;
+      case TM_FORMAT_MONTHNAME:
+        if (tm->tm_mon >= 0 && tm->tm_mon <= 11)
+          name = &prog->monthnames[tm->tm_mon];
+        break;
+      case TM_FORMAT_AMPM:
+        if (tm->tm_hour >= 0 && tm->tm_hour <= 23)
+          name = &prog->ampm[tm->tm_hour >= 12];
+        break;
+      case TM_FORMAT_AMPMLOWER:
+        if (tm->tm_hour >= 0 && tm->tm_hour <= 23)
+          name = &prog->ampmlower[tm->tm_hour >= 12];
+        break;
+      case TM_FORMAT_UTCOFFSET:
+        if (tm->tm_isdst >= 0 && tm->tm_gmtoff > -100 * 3600 && tm->tm_gmtoff < 100 * 3600)
+        {
+          // +hhmm, seconds truncated
+          long int minutes = (tm->tm_gmtoff < 0 ? -tm->tm_gmtoff : tm->tm_gmtoff) / 60;
+
+          digits[0] = tm->tm_gmtoff < 0 ? '-' : '+';
+          tm_writedigitpair (digits + 1, (unsigned int) (minutes / 60));
+          tm_writedigitpair (digits + 3, (unsigned int) (minutes % 60));
+          text = digits;
+          length = 5;
+        }
+        break;
+      case TM_FORMAT_TIMEZONE:
+        if (tm->tm_zone)
+        {
+          text = tm->tm_zone;
+          length = strlen (text);
+        }
+        break;
+      case TM_FORMAT_STRFTIME:
+        break;
+    }
+
+    if (name)
+    {
+      text = prog->text + name->offset;
+      length = name->length;
+    }
+    else if (number)
+    {
+      // Number in range, written on its exact width
+      if (width >= end - p)
+        return (size_t) - 1;
+      switch (width)
+      {
+        case 1:
+          *p = (char) ('0' + value);
+          break;
+        case 2:
+          tm_writedigitpair (p, (unsigned int) value);
+          if (value < 10)
+            p[0] = (char) pad;
+          break;
+        case 3:
+          *p = (char) ('0' + value / 100);
+          tm_writedigitpair (p + 1, (unsigned int) (value % 100));
+          break;
+        case 4:
+          tm_writedigitpair (p, (unsigned int) (value / 100));
+          tm_writedigitpair (p + 2, (unsigned int) (value % 100));
+          break;
+      }
+      p += width;
+      continue;
+    }
+    else if (!text)
+    {
+      // Delegated to strftime(), straight into the buffer
+      if (!(p = tm_formatstrftime (p, end, prog->text + op->offset, tm)))
+        return (size_t) - 1;
+      continue;
+    }
+
+    if (length >= (size_t) (end - p))
+      return (size_t) - 1;
+    memcpy (p, text, length);
+    p += length;
+  }
+
+  if (p >= end)
+    return (size_t) - 1;
+  *p = 0;
+
+  return (size_t) (p - buf);
+}
+
+size_t
+tm_format_exec (const tm_format * prog, const struct tm *tm, char *buf, size_t len)
+{
+  size_t n = tm_formatrun (prog, tm, buf, len);
+
+  return n == (size_t) - 1 ? 0 : n;
+}
+
+/*****************************************************
+*   COMPILED PARSERS                                 *
+*****************************************************/
+
+/// Operations of a compiled parser.
+typedef enum
+{
+  TM_PARSE_TEXT,                ///< Literal text
+  TM_PARSE_SPACE,               ///< Zero or more white spaces (white space, %n, %t)
+  TM_PARSE_NUMBER,              ///< Number, of at most width digits
+  TM_PARSE_NAME,                ///< Name of month, day of week or AM/PM
+  TM_PARSE_UTCOFFSET,           ///< %z
+} tm_parseopcode;
+
+/// Fields of a date and time filled by a compiled parser.
+typedef enum
+{
+  TM_FIELD_YEAR,                ///< %Y
+  TM_FIELD_YEAROFCENTURY,       ///< %y
+  TM_FIELD_MONTH,               ///< %m, %b, %B
+  TM_FIELD_DAY,                 ///< %d, %e
+  TM_FIELD_DAYOFYEAR,           ///< %j
+  TM_FIELD_HOUR,                ///< %H
+  TM_FIELD_HOUR12,              ///< %I
+  TM_FIELD_PM,                  ///< %p
+  TM_FIELD_MINUTE,              ///< %M
+  TM_FIELD_SECOND,              ///< %S
+  TM_FIELD_WEEKDAY,             ///< %a, %A (checked, then ignored)
+  TM_FIELD_UTCOFFSET,           ///< %z
+  TM_NBFIELDS
+} tm_parsefield;
+
+/// Operation of a compiled parser.
+typedef struct
+{
+  tm_parseopcode opcode;
+  tm_parsefield field;
+  int width;                    ///< Maximum number of digits, or root of the trie of names
+  int min, max;                 ///< Range of numbers
+  size_t offset, length;        ///< Literal text, in the text of the parser
+} tm_parseop;
+
+/// Node of a trie of names (case insensitive).
+typedef struct
+{
+  unsigned char c;              ///< Character (lower case)
+  int child;                    ///< First node of the following characters, or -1
+  int sibling;                  ///< Next node for another character at the same position, or -1
+  int value;                    ///< Value of the name ending at this node, or -1
+} tm_parsenode;
+
+struct tm_parser
+{
+  tm_parseop *ops;
+  size_t nbops;
+  char *text;
+  size_t textlength;
+  tm_parsenode *nodes;
+  int nbnodes;
+  int months, weekdays, ampm;   ///< Roots of the tries of names, -1 if empty
+};
+
+/// Lower case of an ASCII character.
+static unsigned char
+tm_parselower (unsigned char c)
+{
+  return c >= 'A' && c <= 'Z' ? (unsigned char) (c - 'A' + 'a') : c;
+}
+
+/// Inserts a name into a trie.
+/// @param [in,out] parser Compiled parser
+/// @param [in,out] root Root of the trie (-1 if empty)
+/// @param [in] name Name
+/// @param [in] value Value of the name
+/// @returns \p TM_OK or \p TM_ERROR if out of memory
+static tm_status
+tm_parseaddname (tm_parser *parser, int *root, const char *name, int value)
+{
+  int parent = -1;              // Node of the previous character, -1 for the root
+  int node = -1;
+
+  for (; *name; name++)
+  {
+    unsigned char c = tm_parselower ((unsigned char) *name);
+    int previous = -1;          // Previous sibling
+
+    for (node = parent < 0 ? *root : parser->nodes[parent].child; node >= 0 && parser->nodes[node].c != c;
+         node = parser->nodes[node].sibling)
+      previous = node;
+
+    if (node < 0)
+    {
+      tm_parsenode *nodes = realloc (parser->nodes, (size_t) (parser->nbnodes + 1) * sizeof (*nodes));
+
+      if (!nodes)
+        return TM_ERROR;
+      parser->nodes = nodes;
+      node = parser->nbnodes++;
+      nodes[node].c = c;
+      nodes[node].child = nodes[node].sibling = nodes[node].value = -1;
+      if (previous >= 0)
+        nodes[previous].sibling = node;
+      else if (parent >= 0)
+        nodes[parent].child = node;
+      else
+        *root = node;
+    }
+
+    parent = node;
+  }
+
+  if (node >= 0 && parser->nodes[node].value < 0)
+    parser->nodes[node].value = value;
+
+  return TM_OK;
+}
+
+/// Matches the longest name of a trie at the beginning of a string.
+/// @returns Pointer past the name, or 0 if no name matches
+static const char *
+tm_parsematchname (const tm_parser *parser, int root, const char *p, const char *end, int *value)
+{
+  const char *match = 0;
+
+  for (int node = root; node >= 0 && p < end; p++)
+  {
+    unsigned char c = tm_parselower ((unsigned char) *p);
+
+    while (node >= 0 && parser->nodes[node].c != c)
+      node = parser->nodes[node].sibling;
+    if (node < 0)
+      break;
+    if (parser->nodes[node].value >= 0)
+    {
+      match = p + 1;
+      *value = parser->nodes[node].value;
+    }
+    node = parser->nodes[node].child;
+  }
+
+  return match;
+}
+
+/// Appends an operation to a compiled parser.
+/// @returns \p TM_OK or \p TM_ERROR if out of memory
+static tm_status
+tm_parseaddop (tm_parser *parser, tm_parseopcode opcode, tm_parsefield field, int width, int min, int max,
+               const char *text, size_t length)
+{
+  if (opcode == TM_PARSE_SPACE && parser->nbops && parser->ops[parser->nbops - 1].opcode == TM_PARSE_SPACE)
+    return TM_OK;
+
+  tm_parseop *ops = realloc (parser->ops, (parser->nbops + 1) * sizeof (*ops));
+
+  if (!ops)
+    return TM_ERROR;
+  parser->ops = ops;
+
+  tm_parseop *op = &ops[parser->nbops++];
+
+  op->opcode = opcode;
+  op->field = field;
+  op->width = width;
+  op->min = min;
+  op->max = max;
+  op->offset = parser->textlength;
+  op->length = length;
+
+  if (length)
+  {
+    char *buffer = realloc (parser->text, parser->textlength + length);
+
+    if (!buffer)
+      return TM_ERROR;
+    memcpy (buffer + parser->textlength, text, length);
+    parser->text = buffer;
+    parser->textlength += length;
+  }
+
+  return TM_OK;
+}
+
+/// Compiles a strptime() format into the operations of a parser.
+/// @returns \p TM_OK, or \p TM_ERROR if out of memory or if the format contains an unsupported conversion
+static tm_status
+tm_parsecompileops (tm_parser *parser, const char *fmt)
+{
+  while (*fmt)
+  {
+    tm_status ret;
+
+    if (*fmt == ' ' || (*fmt >= '\t' && *fmt <= '\r'))
+    {
+      ret = tm_parseaddop (parser, TM_PARSE_SPACE, 0, 0, 0, 0, 0, 0);
+      fmt++;
+    }
+    else if (*fmt != '%' || fmt[1] == '%')
+    {
+      ret = tm_parseaddop (parser, TM_PARSE_TEXT, 0, 0, 0, 0, fmt, 1);
+      fmt += *fmt == '%' ? 2 : 1;
+    }
+    else
+    {
+      const char *composite = 0;
+
+      ret = TM_OK;
+      switch (fmt[1])
+      {
+        case 'Y':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_YEAR, 4, 0, 9999, 0, 0);
+          break;
+        case 'y':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_YEAROFCENTURY, 2, 0, 99, 0, 0);
+          break;
+        case 'm':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_MONTH, 2, 1, 12, 0, 0);
+          break;
+        case 'd':
+        case 'e':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_DAY, 2, 1, 31, 0, 0);
+          break;
+        case 'j':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_DAYOFYEAR, 3, 1, 366, 0, 0);
+          break;
+        case 'H':
+        case 'k':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_HOUR, 2, 0, 23, 0, 0);
+          break;
+        case 'I':
+        case 'l':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_HOUR12, 2, 1, 12, 0, 0);
+          break;
+        case 'M':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_MINUTE, 2, 0, 59, 0, 0);
+          break;
+        case 'S':
+          ret = tm_parseaddop (parser, TM_PARSE_NUMBER, TM_FIELD_SECOND, 2, 0, 59, 0, 0);
+          break;
+        case 'b':
+        case 'B':
+        case 'h':
+          ret = tm_parseaddop (parser, TM_PARSE_NAME, TM_FIELD_MONTH, parser->months, 0, 0, 0, 0);
+          break;
+        case 'a':
+        case 'A':
+          ret = tm_parseaddop (parser, TM_PARSE_NAME, TM_FIELD_WEEKDAY, parser->weekdays, 0, 0, 0, 0);
+          break;
+        case 'p':
+          ret = tm_parseaddop (parser, TM_PARSE_NAME, TM_FIELD_PM, parser->ampm, 0, 0, 0, 0);
+          break;
+        case 'z':
+          ret = tm_parseaddop (parser, TM_PARSE_UTCOFFSET, TM_FIELD_UTCOFFSET, 0, 0, 0, 0, 0);
+          break;
+        case 'n':
+        case 't':
+          ret = tm_parseaddop (parser, TM_PARSE_SPACE, 0, 0, 0, 0, 0, 0);
+          break;
+        case 'D':
+          composite = "%m/%d/%y";
+          break;
+        case 'F':
+          composite = "%Y-%m-%d";
+          break;
+        case 'R':
+          composite = "%H:%M";
+          break;
+        case 'T':
+          composite = "%H:%M:%S";
+          break;
+        default:
+          // Conversion not supported (locale dependent composite conversions, flags, modifiers E and O, ...)
+          errno = EINVAL;
+          return TM_ERROR;
+      }
+      if (composite)
+        ret = tm_parsecompileops (parser, composite);
+      fmt += 2;
+    }
+
+    if (ret == TM_ERROR)
+      return TM_ERROR;
+  }
+
+  return TM_OK;
+}
+
+tm_parser *
+tm_parse_compile (const char *fmt)
+{
+  tm_parser *parser = calloc (1, sizeof (*parser));
+
+  if (!parser)
+    return 0;
+  parser->months = parser->weekdays = parser->ampm = -1;
+
+  // Tries of the names of the current locale, full names and abbreviations
+  struct tm tm = { 0 };
+  char name[256];
+  tm_status ret = TM_OK;
+
+  for (int i = 0; i < 12 && ret == TM_OK; i++)
+  {
+    tm.tm_mon = i;
+    if ((strftime (name, sizeof (name), "%B", &tm) && tm_parseaddname (parser, &parser->months, name, i + 1) == TM_ERROR)
+        || (strftime (name, sizeof (name), "%b", &tm)
+            && tm_parseaddname (parser, &parser->months, name, i + 1) == TM_ERROR))
+      ret = TM_ERROR;
+  }
+  for (int i = 0; i < 7 && ret == TM_OK; i++)
+  {
+    tm.tm_wday = i;
+    if ((strftime (name, sizeof (name), "%A", &tm) && tm_parseaddname (parser, &parser->weekdays, name, i) == TM_ERROR)
+        || (strftime (name, sizeof (name), "%a", &tm)
+            && tm_parseaddname (parser, &parser->weekdays, name, i) == TM_ERROR))
+      ret = TM_ERROR;
+  }
+  for (int i = 0; i < 2 && ret == TM_OK; i++)
+  {
+    tm.tm_hour = 12 * i;
+    if (strftime (name, sizeof (name), "%p", &tm) && tm_parseaddname (parser, &parser->ampm, name, i) == TM_ERROR)
+      ret = TM_ERROR;
+  }
+
+  if (ret == TM_ERROR || tm_parsecompileops (parser, fmt) == TM_ERROR)
+  {
+    tm_parse_free (parser);
+    return 0;
+  }
+
+  return parser;
+}
+
+void
+tm_parse_free (tm_parser * parser)
+{
+  if (!parser)
+    return;
+
+  free (parser->ops);
+  free (parser->text);
+  free (parser->nodes);
+  free (parser);
+}
+
+/// Runs a compiled parser on a string.
+/// @param [in] parser Compiled parser
+/// @param [in] str String, not necessarily null terminated
+/// @param [in] len Length of \p str
+/// @param [out] local Local date and time, in seconds since 1970-01-01 00:00:00 (local time or time at offset \p utcoffset)
+/// @param [out] utcoffset Offset to UTC (%z)
+/// @returns 1 if the string matches and has an offset to UTC, 0 if it matches without offset to UTC, -1 otherwise
+static int
+tm_parserun (const tm_parser *parser, const char *str, size_t len, long long *local, long int *utcoffset)
+{
+  const char *p = str, *end = str + len;
+  int fields[TM_NBFIELDS];
+  unsigned int given = 0;
+
+  for (size_t i = 0; i < parser->nbops; i++)
+  {
+    const tm_parseop *op = &parser->ops[i];
+
+    switch (op->opcode)
+    {
+      case TM_PARSE_TEXT:
+        if ((size_t) (end - p) < op->length || memcmp (p, parser->text + op->offset, op->length))
+          return -1;
+        p += op->length;
+        break;
+      case TM_PARSE_SPACE:
+        while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r')))
+          p++;
+        break;
+      case TM_PARSE_NUMBER:
+        {
+          int value = 0, n = 0;
+
+          while (p < end && *p == ' ')  // Leading spaces, as for %e
+            p++;
+          for (; n < op->width && p < end && *p >= '0' && *p <= '9'; n++, p++)
+            value = value * 10 + *p - '0';
+          if (!n || value < op->min || value > op->max)
+            return -1;
+          fields[op->field] = value;
+          given |= 1U << op->field;
+        }
+        break;
+      case TM_PARSE_NAME:
+        if (!(p = tm_parsematchname (parser, op->width, p, end, &fields[op->field])))
+          return -1;
+        given |= 1U << op->field;
+        break;
+      case TM_PARSE_UTCOFFSET:
+        {
+          long int offset;
+
+          if (!(p = tm_parseisooffset (p, end, &offset)))
+            return -1;
+          fields[op->field] = (int) offset;
+          given |= 1U << op->field;
+        }
+        break;
+    }
+  }
+
+  if (p != end)
+    return -1;
+
+  // Missing fields default to 1970-01-01 00:00:00.
+#define TM_GIVEN(field) (given & (1U << (field)))
+  long long year = 1970;
+  int month = 1, day = 1, hour = 0;
+
+  if (TM_GIVEN (TM_FIELD_YEAR))
+    year = fields[TM_FIELD_YEAR];
+  else if (TM_GIVEN (TM_FIELD_YEAROFCENTURY))
+    year = fields[TM_FIELD_YEAROFCENTURY] + (fields[TM_FIELD_YEAROFCENTURY] < 69 ? 2000 : 1900);
+  if (TM_GIVEN (TM_FIELD_MONTH))
+    month = fields[TM_FIELD_MONTH];
+  if (TM_GIVEN (TM_FIELD_DAY))
+    day = fields[TM_FIELD_DAY];
+
+  long long days;
+
+  if (TM_GIVEN (TM_FIELD_DAYOFYEAR) && !TM_GIVEN (TM_FIELD_MONTH) && !TM_GIVEN (TM_FIELD_DAY))
+  {
+    if (fields[TM_FIELD_DAYOFYEAR] > 365 + tm_isleapyear ((int) year))
+      return -1;
+    days = tm_daysfromcivil (year, 1, 1) + fields[TM_FIELD_DAYOFYEAR] - 1;
+  }
+  else
+  {
+    days = tm_daysfromcivil (year, (unsigned int) month, (unsigned int) day);
+    if (day > 28 && tm_daysfromcivil (year + (month == 12), (unsigned int) month % 12 + 1, 1) <= days)
+      return -1;                // Beyond the end of the month
+  }
+
+  if (TM_GIVEN (TM_FIELD_HOUR))
+    hour = fields[TM_FIELD_HOUR];
+  else if (TM_GIVEN (TM_FIELD_HOUR12))
+    hour = fields[TM_FIELD_HOUR12] % 12 + (TM_GIVEN (TM_FIELD_PM) && fields[TM_FIELD_PM] ? 12 : 0);
+  else if (TM_GIVEN (TM_FIELD_PM))
+    hour = fields[TM_FIELD_PM] ? 12 : 0;
+
+  *local = ((days * 24 + hour) * 60 + (TM_GIVEN (TM_FIELD_MINUTE) ? fields[TM_FIELD_MINUTE] : 0)) * 60
+    + (TM_GIVEN (TM_FIELD_SECOND) ? fields[TM_FIELD_SECOND] : 0);
+  *utcoffset = TM_GIVEN (TM_FIELD_UTCOFFSET) ? fields[TM_FIELD_UTCOFFSET] : 0;
+
+  return TM_GIVEN (TM_FIELD_UTCOFFSET) ? 1 : 0;
+#undef TM_GIVEN
+}
+
+/// Converts local date and time parsed by a compiled parser into calendar time, validated as tm_makelocal() does.
+/// @param [in] local Local date and time, in seconds since 1970-01-01 00:00:00 local time
+/// @param [out] dt Pointer to broken-down time structure, in local time representation
+/// @param [out] t Calendar time
+/// @returns \p TM_OK, or \p TM_ERROR if \p local is skipped by daylight saving time
+static tm_status
+tm_parselocaltime (long long local, struct tm *dt, long long *t)
+{
+  // Lines of a file are usually close in time: the interval of the previous local time is tried first.
+  static _Thread_local const tm_timezone *cachedtz = 0;
+  static _Thread_local tm_intervalcache cache = { 0 };
+  const tm_timezone *tz = tm_localtimezone ();
+
+  if (tz && tz == cachedtz && cache.type && local >= cache.localfrom && local < cache.localto)
+  {
+    if (tm_breakdownutc (local, dt) == TM_ERROR)
+      return TM_ERROR;
+    dt->tm_isdst = cache.type->isdst;
+    dt->tm_gmtoff = cache.type->utcoffset;
+    dt->tm_zone = cache.type->abbreviation;
+    *t = local - cache.type->utcoffset;
+    return TM_OK;
+  }
+
+  if (tz && tm_localtocalendartimeintimezone (tz, local, -1, t))
+  {
+    cachedtz = tm_getlocaltimetype (tz, *t, &cache) ? tz : 0;
+    return tm_breakdownintimezone (tz, *t, dt) > 0 && tm_linearseconds (dt) == local ? TM_OK : TM_ERROR;
+  }
+
+  struct tm tm;
+
+  if (tm_breakdownutc (local, &tm) == TM_ERROR
+      || tm_makelocal (dt, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec) == TM_ERROR)
+    return TM_ERROR;
+
+  *t = tm_tobinary (*dt);
+  return TM_OK;
+}
+
+tm_status
+tm_parse_exec (const tm_parser * parser, const char *str, size_t len, struct tm * dt)
+{
+  long long local, t;
+  long int offset;
+  int ret = tm_parserun (parser, str, len, &local, &offset);
+
+  if (ret < 0)
+    return TM_ERROR;
+  if (ret > 0)
+    // Time at an offset to UTC, presented in local time (years are within 0 and 9999 and cannot overflow time_t.)
+    return tm_makelocalfromcalendartime ((time_t) (local - offset), dt);
+
+  return tm_parselocaltime (local, dt, &t);
+}
+
+tm_status
+tm_parse_execinstant (const tm_parser * parser, const char *str, size_t len, tm_instant * instant)
+{
+  long long local, t;
+  long int offset;
+  int ret = tm_parserun (parser, str, len, &local, &offset);
+  struct tm tm;
+
+  if (ret < 0)
+    return TM_ERROR;
+  if (ret > 0)
+    t = local - offset;
+  else if (tm_parselocaltime (local, &tm, &t) == TM_ERROR)
+    return TM_ERROR;
+
+  return tm_makeinstant (instant, (time_t) t, 0);
+}
+
+/*****************************************************
+*   LOG TIME STAMPS                                  *
+*****************************************************/
+
+/// Maximum number of %S and %N conversions in a log time stamp format.
+#define TM_LOGFIELDS 8
+
+/// Maximum length of a log time stamp (including the terminating null byte.)
+#define TM_LOGMAXLENGTH 256
+
+struct tm_logformat
+{
+  unsigned long id;             ///< Unique identifier, distinguishing formats in the caches of the threads
+  size_t nbfields;
+  tm_format *segments[TM_LOGFIELDS + 1];        ///< Parts of the format around the fields (0 if empty)
+  int digits[TM_LOGFIELDS];     ///< Number of digits of fraction of second (%N), or 0 for seconds (%S)
+  int patchable;                ///< Nonzero if the rest of the format does not depend on the second
+};
+
+/// Log time stamp rendered last by the calling thread.
+static _Thread_local struct
+{
+  unsigned long id;             ///< Identifier of the format, 0 if the cache is empty
+  tm_representation representation;
+  const tm_timezone *tz;
+  tm_intervalcache interval;    ///< Interval of tz around second
+  time_t second;                ///< Second of text
+  int sec;                      ///< Field tm_sec at second
+  char text[TM_LOGMAXLENGTH];
+  size_t length;
+  size_t positions[TM_LOGFIELDS];       ///< Positions of the fields in text
+} tm_logcache;
+
+/// Expands the composite conversions of a strftime() format that contain seconds (%T, %X, %c, %r.)
+/// @param [in] fmt Format
+/// @param [out] buf Expanded format
+/// @param [in] len Size of \p buf
+/// @param [in] depth Maximum depth of expansion
+/// @returns Length of the expanded format, or (size_t)-1 if it exceeds \p len
+static size_t
+tm_logexpand (const char *fmt, char *buf, size_t len, int depth)
+{
+  size_t n = 0;
+
+  while (*fmt)
+  {
+    const char *composite = 0;
+
+    if (*fmt == '%' && depth)
+      switch (fmt[1])
+      {
+        case 'T':
+          composite = "%H:%M:%S";
+          break;
+        case 'X':
+          composite = nl_langinfo (T_FMT);
+          break;
+        case 'c':
+          composite = nl_langinfo (D_T_FMT);
+          break;
+        case 'r':
+          composite = nl_langinfo (T_FMT_AMPM);
+          break;
+      }
+
+    if (composite && *composite)
+    {
+      size_t m = tm_logexpand (composite, buf + n, len - n, depth - 1);
+
+      if (m == (size_t) - 1)
+        return m;
+      n += m;
+      fmt += 2;
+    }
+    else
+    {
+      // Conversions are copied as a whole, so that %%T is not expanded.
+      size_t m = *fmt == '%' && fmt[1] ? 2 : 1;
+
+      if (n + m >= len)
+        return (size_t) - 1;
+      memcpy (buf + n, fmt, m);
+      n += m;
+      fmt += m;
+    }
+  }
+
+  buf[n] = 0;
+  return n;
+}
+
+tm_logformat *
+tm_logformat_compile (const char *fmt)
+{
+  static atomic_ulong ids = 0;
+  char expanded[TM_LOGMAXLENGTH];
+  tm_logformat *log = calloc (1, sizeof (*log));
+
+  if (!log)
+    return 0;
+  log->id = atomic_fetch_add (&ids, 1) + 1;
+  log->patchable = 1;
+
+  if (tm_logexpand (fmt ? fmt : "%x %X", expanded, sizeof (expanded), 2) == (size_t) - 1)
+  {
+    errno = EINVAL;
+    tm_logformat_free (log);
+    return 0;
+  }
+
+  // The expanded format is split at each %S and %N conversion.
+  char *segment = expanded;
+
+  for (char *p = expanded; *p;)
+  {
+    if (*p != '%')
+    {
+      p++;
+      continue;
+    }
+
+    char *spec = p++;
+    int digits = -1;
+
+    while (*p && strchr ("_-0^#", *p))
+      p++;
+    int width = 0, haswidth = 0;
+
+    for (; *p >= '0' && *p <= '9'; p++, haswidth = 1)
+      width = width * 10 + *p - '0';
+    if (*p == 'E' || *p == 'O')
+    {
+      log->patchable = 0;
+      p++;
+    }
+    if (*p == 'N' && p == spec + 1 + haswidth && (!haswidth || (width >= 1 && width <= 9)))
+      digits = haswidth ? width : 9;
+    else if (*p == 'S' && p == spec + 1)
+      digits = 0;
+    else if (*p == 'S' || *p == 's' || *p == '+' || *p == 'T' || *p == 'X' || *p == 'c' || *p == 'r')
+      log->patchable = 0;       // Other conversions depending on the second
+    if (*p)
+      p++;
+
+    if (digits < 0)
+      continue;
+    if (log->nbfields == TM_LOGFIELDS)
+    {
+      errno = EINVAL;
+      tm_logformat_free (log);
+      return 0;
+    }
+
+    *spec = 0;
+    if (*segment && !(log->segments[log->nbfields] = tm_format_compile (segment)))
+    {
+      tm_logformat_free (log);
+      return 0;
+    }
+    log->digits[log->nbfields++] = digits;
+    segment = p;
+  }
+
+  if (*segment && !(log->segments[log->nbfields] = tm_format_compile (segment)))
+  {
+    tm_logformat_free (log);
+    return 0;
+  }
+
+  return log;
+}
+
+void
+tm_logformat_free (tm_logformat *log)
+{
+  if (!log)
+    return;
+
+  for (size_t i = 0; i <= log->nbfields; i++)
+    tm_format_free (log->segments[i]);
+  free (log);
+}
+
+/// Renders a log time stamp entirely into the cache of the calling thread.
+/// @returns \p TM_OK or \p TM_ERROR
+static tm_status
+tm_logrender (const tm_logformat *log, time_t second, tm_representation representation, const tm_timezone *tz)
+{
+  struct tm tm;
+
+  tm_logcache.id = 0;
+  if (representation == TM_REP_LOCAL && tz && tm_getlocaltimetype (tz, second, &tm_logcache.interval))
+  {
+    if (tm_breakdownintimezone (tz, second, &tm) <= 0)
+      return TM_ERROR;
+  }
+  else
+  {
+    tz = 0;
+    if ((representation == TM_REP_LOCAL ? tm_makelocalfromcalendartime (second, &tm)
+         : tm_makeutcfromcalendartime (second, &tm)) == TM_ERROR)
+      return TM_ERROR;
+  }
+
+  char *p = tm_logcache.text;
+  size_t left = sizeof (tm_logcache.text);
+
+  for (size_t i = 0; i <= log->nbfields; i++)
+  {
+    if (log->segments[i])
+    {
+      // A segment may render to nothing (such as %p in a locale without AM/PM strings): only overflows are errors.
+      size_t n = tm_formatrun (log->segments[i], &tm, p, left);
+
+      if (n == (size_t) - 1)
+        return TM_ERROR;
+      p += n;
+      left -= n;
+    }
+    if (i == log->nbfields)
+      break;
+
+    size_t n = log->digits[i] ? (size_t) log->digits[i] : 2;
+
+    if (n >= left)
+      return TM_ERROR;
+    tm_logcache.positions[i] = (size_t) (p - tm_logcache.text);
+    if (!log->digits[i])
+      tm_writedigitpair (p, (unsigned int) tm.tm_sec);
+    p += n;
+    left -= n;
+  }
+
+  tm_logcache.id = log->id;
+  tm_logcache.representation = representation;
+  tm_logcache.tz = tz;
+  tm_logcache.second = second;
+  tm_logcache.sec = tm.tm_sec;
+  tm_logcache.length = (size_t) (p - tm_logcache.text);
+
+  return TM_OK;
+}
+
+size_t
+tm_logformat_exec (const tm_logformat *log, tm_instant instant, tm_representation representation, char *buf, size_t len)
+{
+  time_t second = (time_t) tm_getinstantseconds (instant);
+  long int nanoseconds = tm_getinstantnanoseconds (instant);
+  const tm_timezone *tz = representation == TM_REP_LOCAL ? tm_localtimezone () : 0;
+
+  if (tm_logcache.id != log->id || tm_logcache.representation != representation || tm_logcache.tz != tz
+      || (tz && (second < tm_logcache.interval.from || second >= tm_logcache.interval.to)))
+  {
+    if (tm_logrender (log, second, representation, tz) == TM_ERROR)
+      return 0;
+  }
+  else if (second != tm_logcache.second)
+  {
+    long long sec = (long long) tm_logcache.sec + (second - tm_logcache.second);
+
+    if (log->patchable && sec >= 0 && sec < 60)
+    {
+      // Same minute: only the seconds change.
+      for (size_t i = 0; i < log->nbfields; i++)
+        if (!log->digits[i])
+          tm_writedigitpair (tm_logcache.text + tm_logcache.positions[i], (unsigned int) sec);
+      tm_logcache.second = second;
+      tm_logcache.sec = (int) sec;
+    }
+    else if (tm_logrender (log, second, representation, tz) == TM_ERROR)
+      return 0;
+  }
+
+  if (tm_logcache.length >= len)
+    return 0;
+
+  memcpy (buf, tm_logcache.text, tm_logcache.length);
+  buf[tm_logcache.length] = 0;
+
+  // Fractions of second, truncated to the number of digits
+  for (size_t i = 0; i < log->nbfields; i++)
+    if (log->digits[i])
+    {
+      long int fraction = nanoseconds;
+
+      for (int d = log->digits[i]; d < 9; d++)
+        fraction /= 10;
+      for (char *p = buf + tm_logcache.positions[i] + log->digits[i]; p > buf + tm_logcache.positions[i]; fraction /= 10)
+        *--p = (char) ('0' + fraction % 10);
+    }
+
+  return tm_logcache.length;
+}
+
+/*****************************************************
+*   RECURRENCE RULES                                 *
+*****************************************************/
+
+/// Maximum number of values of BYDAY and of BYSETPOS in a recurrence rule.
+#define TM_RRULEMAXVALUES 64
 
-  // Returns tm_OK during the hour after DST loses effect (from summer to winter time switch), TM_ERROR otherwise.
-  return (date->tm_isdst ? TM_OK : TM_ERROR);
-}
+/// Frequencies of recurrence rules.
+typedef enum
+{
+  TM_RRULE_DAILY,
+  TM_RRULE_WEEKLY,
+  TM_RRULE_MONTHLY,
+  TM_RRULE_YEARLY,
+} tm_rrulefreq;
+
+/// Day of week of BYDAY, with its ordinal.
+typedef struct
+{
+  int ordinal;                  ///< Occurrence of the day of week in the month or year (negative from the end), 0 for every one
+  int wday;                     ///< Day of week (0 = Sunday, as tm_wday)
+} tm_rruleday;
 
-int
-tm_getutcoffset (struct tm date)
+struct tm_rrule
+{
+  struct tm dtstart;            ///< First instant of the recurrence (DTSTART)
+  tm_rrulefreq freq;            ///< FREQ
+  long long interval;           ///< INTERVAL
+  long long count;              ///< COUNT, 0 if none
+  int hasuntil;                 ///< 1 if UNTIL is set
+  time_t until;                 ///< UNTIL, included
+  unsigned int bymonth;         ///< BYMONTH, bit 1 for January to bit 12 for December, 0 if none
+  uint32_t bymonthday;          ///< BYMONTHDAY, bit 1 for the first day of month to bit 31, 0 if none
+  uint32_t bymonthdayneg;       ///< BYMONTHDAY, bit 1 for the last day of month (-1) to bit 31, 0 if none
+  tm_rruleday byday[TM_RRULEMAXVALUES]; ///< BYDAY
+  int nbbyday;
+  int bysetpos[TM_RRULEMAXVALUES];      ///< BYSETPOS
+  int nbbysetpos;
+  int wkst;                     ///< WKST (0 = Sunday, as tm_wday)
+  long long startday;           ///< Day of DTSTART, in days since 1970-01-01
+  long long lastday;            ///< Last day that can hold an occurrence (day of UNTIL, or end of year 9999)
+  time_t *exdates;              ///< EXDATE, in ascending order
+  size_t nbexdates;
+};
+
+/// Floor of a division.
+/// @param [in] a Dividend
+/// @param [in] b Divisor (positive)
+static long long
+tm_rrulefloordiv (long long a, long long b)
 {
-  return date.tm_gmtoff;
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
 }
 
-const char *
-tm_gettimezone (struct tm date)
+/// Day of week of a day.
+/// @param [in] day Day since 1970-01-01
+/// @returns Day of week (0 = Sunday, as tm_wday)
+static int
+tm_rruleweekday (long long day)
 {
-  // Statically allocated.
-  return date.tm_zone;
+  return (int) ((day % 7 + 11) % 7);    /* 1970-01-01 was a Thursday */
 }
 
-int
-tm_getsecondsofday (struct tm date)
+/// Indicates whether a part of a recurrence rule is a keyword (case insensitive).
+static int
+tm_rrulekeyword (const char *s, size_t len, const char *keyword)
 {
-  struct tm tmp = date;
-
-  tm_set (&tmp, tm_getyear (date), tm_getmonth (date), tm_getday (date), 0, 0, 0);
+  if (len != strlen (keyword))
+    return 0;
+  for (size_t i = 0; i < len; i++)
+    if (tm_parselower ((unsigned char) s[i]) != tm_parselower ((unsigned char) keyword[i]))
+      return 0;
 
-  return tm_diffseconds (tmp, date);
+  return 1;
 }
 
-tm_status
-tm_set (struct tm * tm, int year, tm_month month, int day, int hour, int min, int sec)
+/// Parses a signed integer of a list of values of a recurrence rule.
+/// @param [in,out] s Pointer to the integer, moved after it
+/// @param [in] end End of the list
+/// @param [out] value Integer
+/// @returns 1 on success, 0 on error
+static int
+tm_rruleparseint (const char **s, const char *end, int *value)
 {
-  if (tm_islocalrepresentation (*tm))
-    return tm_makelocal (tm, year, month, day, hour, min, sec);
-  else
-    return tm_makeutc (tm, year, month, day, hour, min, sec);
-}
+  int sign = 1, n = 0;
+  const char *p = *s;
 
-/*****************************************************
-*   OPERATORS                                        *
-*****************************************************/
+  if (p < end && (*p == '+' || *p == '-'))
+    sign = *p++ == '-' ? -1 : 1;
+  if (p >= end || *p < '0' || *p > '9')
+    return 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+    if ((n = n * 10 + *p - '0') > 100000)
+      return 0;
 
-tm_status
-tm_addseconds (struct tm * date, long int nbSecs)
-{
-  date->tm_sec += nbSecs;
-  // Don't modify date->tm_isdst so that absolute number of seconds is added.
+  *value = sign * n;
+  *s = p;
 
-  errno = 0;
-  return tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  return 1;
 }
 
-tm_status
-tm_adddays (struct tm * date, int nbDays)
+/// Parses a day of week of a recurrence rule (SU, MO, TU, WE, TH, FR or SA).
+/// @returns Day of week (0 = Sunday, as tm_wday), or -1 on error
+static int
+tm_rruleparseweekday (const char *s, const char *end)
 {
-  date->tm_mday += nbDays;
-  date->tm_isdst = -1;          // Let timezone information and system databases define DST flag.
+  static const char *const days[] = { "SU", "MO", "TU", "WE", "TH", "FR", "SA" };
 
-  errno = 0;
-  return tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  for (int i = 0; i < 7; i++)
+    if (tm_rrulekeyword (s, (size_t) (end - s), days[i]))
+      return i;
+
+  return -1;
 }
 
-tm_status
-tm_addmonths (struct tm * date, int nbMonths)
+/// Parses UNTIL (YYYYMMDD, YYYYMMDDTHHMMSS in the timezone of DTSTART, or YYYYMMDDTHHMMSSZ in UTC).
+/// @returns 1 on success, 0 on error
+static int
+tm_rruleparseuntil (tm_rrule *rrule, const char *s, const char *end)
 {
-  int mday = date->tm_mday;
-
-  date->tm_mon += nbMonths;
-  date->tm_isdst = -1;          // Let timezone information and system databases define DST flag.
-
-  errno = 0;
-  tm_status ret = tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  int f[6] = { 0, 0, 0, 23, 59, 59 };   // A date alone includes the whole day.
+  static const int widths[] = { 4, 2, 2, 2, 2, 2 };
+  int utc = 0;
 
-  if (ret == TM_OK && date->tm_mday != mday)
+  for (int i = 0; i < 6; i++)
   {
-    date->tm_mday = 0;
-    ret = tm_normalize (date) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+    if (i == 3)
+    {
+      if (s == end)
+        break;
+      if (*s != 'T' && *s != 't')
+        return 0;
+      s++;
+    }
+    f[i] = 0;
+    for (int w = 0; w < widths[i]; w++, s++)
+      if (s >= end || *s < '0' || *s > '9')
+        return 0;
+      else
+        f[i] = f[i] * 10 + *s - '0';
+  }
+  if (s < end && (*s == 'Z' || *s == 'z'))
+  {
+    utc = 1;
+    s++;
   }
+  if (s != end)
+    return 0;
 
-  return ret;
-}
+  struct tm until;
+  const tm_timezone *tz = tm_gettimezoneof_p (&rrule->dtstart);
+  tm_status ret = utc || tm_isutcrepresentation_p (&rrule->dtstart) ? tm_makeutc (&until, f[0], f[1], f[2], f[3], f[4], f[5]) :
+    tz ? tm_makeintimezone (&until, tz, f[0], f[1], f[2], f[3], f[4], f[5]) : tm_makelocal (&until, f[0], f[1], f[2], f[3], f[4], f[5]);
 
-tm_status
-tm_addyears (struct tm * date, int nbYears)
-{
-  return tm_addmonths (date, 12 * nbYears);
-}
+  errno = 0;
+  if (ret == TM_ERROR || ((rrule->until = tm_calendartime (&until)) == (time_t) - 1 && errno))
+    return 0;
 
-tm_status
-tm_trimtime (struct tm * tm)
-{
-  tm->tm_sec = tm->tm_min = tm->tm_hour = 0;
-  tm->tm_isdst = -1;            // Let timezone information and system databases define DST flag.
+  rrule->hasuntil = 1;
+  // The local date of UTC may be the day after in the timezone of DTSTART.
+  rrule->lastday = tm_daysfromcivil (f[0], (unsigned int) f[1], (unsigned int) f[2]) + utc;
 
-  errno = 0;
-  return tm_normalize (tm) != (time_t) - 1 || !errno ? TM_OK : TM_ERROR;
+  return 1;
 }
 
-/*****************************************************
-*   COMPARATORS                                      *
-*****************************************************/
-int
-tm_equals (struct tm a, struct tm b)
+/// Parses a part NAME=VALUE of a recurrence rule.
+/// @returns 1 on success, 0 on error
+static int
+tm_rruleparsepart (tm_rrule *rrule, const char *name, size_t namelen, const char *s, const char *end)
 {
-  return (a.tm_sec == b.tm_sec && a.tm_min == b.tm_min && a.tm_hour == b.tm_hour &&
-          a.tm_mday == b.tm_mday && a.tm_mon == b.tm_mon && a.tm_year == b.tm_year && a.tm_gmtoff == b.tm_gmtoff
-          && !strcmp (a.tm_zone, b.tm_zone));
-}
+  int value;
 
-long int
-tm_diffseconds (struct tm debut, struct tm fin)
-{
-  return tm_normalize (&fin) - tm_normalize (&debut);
-}
+  if (tm_rrulekeyword (name, namelen, "FREQ"))
+  {
+    static const char *const freqs[] = { "DAILY", "WEEKLY", "MONTHLY", "YEARLY" };
+
+    for (int i = 0; i < 4; i++)
+      if (tm_rrulekeyword (s, (size_t) (end - s), freqs[i]))
+      {
+        rrule->freq = (tm_rrulefreq) i;
+        return 1;
+      }
+    return 0;                   // SECONDLY, MINUTELY and HOURLY are not supported.
+  }
+  if (tm_rrulekeyword (name, namelen, "INTERVAL"))
+    return tm_rruleparseint (&s, end, &value) && s == end && value >= 1 && (rrule->interval = value);
+  if (tm_rrulekeyword (name, namelen, "COUNT"))
+    return tm_rruleparseint (&s, end, &value) && s == end && value >= 1 && (rrule->count = value);
+  if (tm_rrulekeyword (name, namelen, "UNTIL"))
+    return tm_rruleparseuntil (rrule, s, end);
+  if (tm_rrulekeyword (name, namelen, "WKST"))
+    return (rrule->wkst = tm_rruleparseweekday (s, end)) >= 0;
+
+  // Lists of values
+  for (const char *item = s, *next; item < end; item = next + 1)
+  {
+    if (!(next = memchr (item, ',', (size_t) (end - item))))
+      next = end;
 
-int
-tm_compare (const void *pdebut, const void *pfin)
-{
-  long int diff = -tm_diffseconds (*(struct tm *) pdebut, *(struct tm *) pfin);
+    if (tm_rrulekeyword (name, namelen, "BYMONTH"))
+    {
+      if (!tm_rruleparseint (&item, next, &value) || item != next || value < 1 || value > 12)
+        return 0;
+      rrule->bymonth |= 1U << value;
+    }
+    else if (tm_rrulekeyword (name, namelen, "BYMONTHDAY"))
+    {
+      if (!tm_rruleparseint (&item, next, &value) || item != next || !value || value > 31 || value < -31)
+        return 0;
+      if (value > 0)
+        rrule->bymonthday |= (uint32_t) 1 << value;
+      else
+        rrule->bymonthdayneg |= (uint32_t) 1 << -value;
+    }
+    else if (tm_rrulekeyword (name, namelen, "BYDAY"))
+    {
+      tm_rruleday day = { 0, 0 };
+
+      if (rrule->nbbyday >= TM_RRULEMAXVALUES
+          || (next - item > 2 && (!tm_rruleparseint (&item, next - 2, &day.ordinal) || item != next - 2 || !day.ordinal
+                                  || abs (day.ordinal) > 53))
+          || (day.wday = tm_rruleparseweekday (item, next)) < 0)
+        return 0;
+      rrule->byday[rrule->nbbyday++] = day;
+    }
+    else if (tm_rrulekeyword (name, namelen, "BYSETPOS"))
+    {
+      if (rrule->nbbysetpos >= TM_RRULEMAXVALUES || !tm_rruleparseint (&item, next, &value) || item != next || !value
+          || value > 366 || value < -366)
+        return 0;
+      rrule->bysetpos[rrule->nbbysetpos++] = value;
+    }
+    else
+      return 0;                 // BYSECOND, BYMINUTE, BYHOUR, BYYEARDAY and BYWEEKNO are not supported.
+  }
 
-  return diff < 0 ? -1 : (diff > 0 ? 1 : 0);
+  return s < end;
 }
 
-int
-tm_diffcalendardays (struct tm debut, struct tm fin)
+/// Gets the days of a period of a recurrence rule.
+/// @param [in] rrule Recurrence rule
+/// @param [in] period Index of the period (day, week, month or year, depending on the frequency), 0 for the period of DTSTART
+/// @param [out] first First day of the period, in days since 1970-01-01
+/// @param [out] last Last day of the period
+static void
+tm_rruleperiod (const tm_rrule *rrule, long long period, long long *first, long long *last)
 {
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
+  long long n = period * rrule->interval;
+  long long month = (rrule->dtstart.tm_year + 1900LL) * 12 + rrule->dtstart.tm_mon;
+
+  switch (rrule->freq)
   {
-    errno = EINVAL;
-    return 0;
+    case TM_RRULE_DAILY:
+      *first = *last = rrule->startday + n;
+      break;
+    case TM_RRULE_WEEKLY:
+      *first = rrule->startday - (tm_rruleweekday (rrule->startday) - rrule->wkst + 7) % 7 + 7 * n;
+      *last = *first + 6;
+      break;
+    case TM_RRULE_MONTHLY:
+      month += n;
+      *first = tm_daysfromcivil (tm_rrulefloordiv (month, 12), (unsigned int) (month - 12 * tm_rrulefloordiv (month, 12) + 1), 1);
+      month++;
+      *last = tm_daysfromcivil (tm_rrulefloordiv (month, 12), (unsigned int) (month - 12 * tm_rrulefloordiv (month, 12) + 1), 1) - 1;
+      break;
+    case TM_RRULE_YEARLY:
+      *first = tm_daysfromcivil (rrule->dtstart.tm_year + 1900LL + n, 1, 1);
+      *last = tm_daysfromcivil (rrule->dtstart.tm_year + 1900LL + n + 1, 1, 1) - 1;
+      break;
   }
+}
 
-  int coeff = 1;
-  int ret = 0;
-
-  if (fin.tm_year < debut.tm_year)
-  {
-    struct tm tmp = debut;
+/// Gets the period of a recurrence rule that contains a day.
+/// @returns Index of the period, possibly negative (see tm_rruleperiod())
+static long long
+tm_rruleperiodof (const tm_rrule *rrule, long long day)
+{
+  long long first, last, year;
+  unsigned int month, mday;
 
-    debut = fin;
-    fin = tmp;
-    coeff = -1;
-  }
-  ret = fin.tm_yday - debut.tm_yday;
+  tm_rruleperiod (rrule, 0, &first, &last);
+  tm_civilfromdays (day, &year, &month, &mday);
 
-  debut.tm_mon = 11;
-  debut.tm_mday = 31;
-  for (; debut.tm_year < fin.tm_year; debut.tm_year++)
+  switch (rrule->freq)
   {
-    tm_normalize (&debut);
-    ret += debut.tm_yday + 1;
+    case TM_RRULE_DAILY:
+      return tm_rrulefloordiv (day - first, rrule->interval);
+    case TM_RRULE_WEEKLY:
+      return tm_rrulefloordiv (tm_rrulefloordiv (day - first, 7), rrule->interval);
+    case TM_RRULE_MONTHLY:
+      return tm_rrulefloordiv (year * 12 + month - 1 - (rrule->dtstart.tm_year + 1900LL) * 12 - rrule->dtstart.tm_mon,
+                               rrule->interval);
+    default:
+      return tm_rrulefloordiv (year - 1900 - rrule->dtstart.tm_year, rrule->interval);
   }
-
-  return coeff * ret;
 }
 
-int
-tm_diffdays (struct tm debut, struct tm fin, int *seconds)
+/// Indicates whether a day matches the BYMONTH, BYMONTHDAY and BYDAY parts of a recurrence rule
+/// (or the day of week, day of month and month of DTSTART by default, depending on the frequency).
+static int
+tm_rrulematches (const tm_rrule *rrule, long long day)
 {
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
-  {
-    errno = EINVAL;
+  long long year;
+  unsigned int month, mday;
+
+  tm_civilfromdays (day, &year, &month, &mday);
+  if (rrule->bymonth && !(rrule->bymonth >> month & 1))
     return 0;
-  }
 
-  int coeff = 1;
+  int wday = tm_rruleweekday (day);
+  int last = tm_getdaysinmonth ((int) year, (tm_month) month);
 
-  if (tm_diffseconds (debut, fin) < 0)
-  {
-    struct tm tmp = debut;
+  if ((rrule->bymonthday || rrule->bymonthdayneg) && !(rrule->bymonthday >> mday & 1)
+      && !(rrule->bymonthdayneg >> (last - mday + 1) & 1))
+    return 0;
 
-    debut = fin;
-    fin = tmp;
-    coeff = -1;
+  if (rrule->nbbyday)
+  {
+    int found = 0;
+
+    for (int i = 0; !found && i < rrule->nbbyday; i++)
+      if (rrule->byday[i].wday == wday)
+      {
+        if (!rrule->byday[i].ordinal)
+          found = 1;
+        else if (rrule->freq == TM_RRULE_MONTHLY || rrule->bymonth)
+          // n-th day of week of the month
+          found = rrule->byday[i].ordinal == (int) (mday - 1) / 7 + 1 || rrule->byday[i].ordinal == -((last - (int) mday) / 7 + 1);
+        else
+        {
+          // n-th day of week of the year
+          int yday = (int) (day - tm_daysfromcivil (year, 1, 1));
+          int days = 365 + tm_isleapyear ((int) year);
+
+          found = rrule->byday[i].ordinal == yday / 7 + 1 || rrule->byday[i].ordinal == -((days - 1 - yday) / 7 + 1);
+        }
+      }
+    if (!found)
+      return 0;
   }
+  else if (!rrule->bymonthday && !rrule->bymonthdayneg)
+    switch (rrule->freq)
+    {
+      case TM_RRULE_WEEKLY:
+        return wday == rrule->dtstart.tm_wday;
+      case TM_RRULE_MONTHLY:
+        return (int) mday == rrule->dtstart.tm_mday;
+      case TM_RRULE_YEARLY:
+        return (int) mday == rrule->dtstart.tm_mday && (rrule->bymonth || (int) month == rrule->dtstart.tm_mon + 1);
+      default:
+        break;
+    }
 
-  int ret = tm_diffcalendardays (debut, fin);
+  return 1;
+}
 
-  if (fin.tm_hour < debut.tm_hour || (fin.tm_hour == debut.tm_hour && fin.tm_min < debut.tm_min) ||
-      (fin.tm_hour == debut.tm_hour && fin.tm_min == debut.tm_min && fin.tm_sec < debut.tm_sec))
-    if (ret > 0)
-      ret--;
+/// Indicates whether the n-th matching day of a period is selected by BYSETPOS.
+/// @param [in] rrule Recurrence rule
+/// @param [in] position Rank of the day among the matching days of the period (from 1)
+/// @param [in] nbmatches Number of matching days of the period
+static int
+tm_rrulesetpos (const tm_rrule *rrule, int position, int nbmatches)
+{
+  if (!rrule->nbbysetpos)
+    return 1;
 
-  if (seconds)
-  {
-    tm_adddays (&debut, ret);
-    *seconds = coeff * tm_diffseconds (debut, fin);
-  }
+  for (int i = 0; i < rrule->nbbysetpos; i++)
+    if (rrule->bysetpos[i] == position || rrule->bysetpos[i] == position - nbmatches - 1)
+      return 1;
 
-  return coeff * ret;
+  return 0;
 }
 
-int
-tm_diffweeks (struct tm debut, struct tm fin, int *days, int *seconds)
+/// Finds the next day of a recurrence rule, before COUNT, UNTIL and EXDATE apply.
+/// @param [in,out] it Iterator
+/// @param [out] day Day, in days since 1970-01-01
+/// @returns 1 if a day was found, 0 otherwise
+static int
+tm_rrulenextday (tm_rruleiter *it, long long *day)
 {
-  int d = tm_diffdays (debut, fin, seconds);
-  int s = seconds ? *seconds : 0;
+  const tm_rrule *rrule = it->rrule;
 
-  if (days)
-    *days = d >= 0 ? d % 7 : -((-d) % 7);
-  else if (seconds)
-    *seconds = s;
+  for (;;)
+  {
+    if (it->day > it->last)
+    {
+      // Next period
+      tm_rruleperiod (rrule, ++it->period, &it->day, &it->last);
+      if (it->day > rrule->lastday)
+        return 0;
+      it->position = it->nbmatches = 0;
+      if (rrule->nbbysetpos)
+        for (long long d = it->day; d <= it->last; d++)
+          it->nbmatches += tm_rrulematches (rrule, d);
+    }
 
-  return d / 7;
+    for (; it->day <= it->last; it->day++)
+      if (tm_rrulematches (rrule, it->day) && tm_rrulesetpos (rrule, ++it->position, it->nbmatches)
+          && it->day >= rrule->startday && it->day <= rrule->lastday)
+      {
+        *day = it->day++;
+        return 1;
+      }
+  }
 }
 
-int
-tm_diffcalendarmonths (struct tm debut, struct tm fin)
+/// Indicates whether an instant is excluded from a recurrence rule (EXDATE).
+static int
+tm_rruleexcluded (const tm_rrule *rrule, time_t t)
 {
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
+  size_t lo = 0, hi = rrule->nbexdates;
+
+  while (lo < hi)
   {
-    errno = EINVAL;
-    return 0;
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (rrule->exdates[mid] < t)
+      lo = mid + 1;
+    else
+      hi = mid;
   }
 
-  return 12 * (fin.tm_year - debut.tm_year) + fin.tm_mon - debut.tm_mon;
+  return lo < rrule->nbexdates && rrule->exdates[lo] == t;
 }
 
-int
-tm_diffmonths (struct tm debut, struct tm fin, int *days, int *seconds)
+tm_rrule *
+tm_rrule_compile (const char *rule, const struct tm *dtstart)
 {
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
+  if (!rule || !dtstart)
   {
     errno = EINVAL;
     return 0;
   }
 
-  int coeff = 1;
+  tm_rrule *rrule = calloc (1, sizeof (*rrule));
 
-  if (tm_diffseconds (debut, fin) < 0)
-  {
-    struct tm tmp = debut;
+  if (!rrule)
+    return 0;
 
-    debut = fin;
-    fin = tmp;
-    coeff = -1;
+  rrule->dtstart = *dtstart;
+  rrule->freq = (tm_rrulefreq) - 1;
+  rrule->interval = 1;
+  rrule->wkst = 1;              // Monday
+  rrule->lastday = tm_daysfromcivil (9999, 12, 31);
+
+  errno = 0;
+  if (tm_normalize (&rrule->dtstart) == (time_t) - 1 && errno)
+  {
+    free (rrule);
+    return 0;
   }
+  rrule->startday = tm_rrulefloordiv (tm_linearseconds (&rrule->dtstart), 86400);
 
-  int ret = tm_diffcalendarmonths (debut, fin);
+  if (tm_rrulekeyword (rule, strlen (rule) < 6 ? 0 : 6, "RRULE:"))
+    rule += 6;
 
-  if (fin.tm_mday < debut.tm_mday ||
-      (fin.tm_mday == debut.tm_mday && fin.tm_hour < debut.tm_hour) ||
-      (fin.tm_mday == debut.tm_mday && fin.tm_hour == debut.tm_hour && fin.tm_min < debut.tm_min) ||
-      (fin.tm_mday == debut.tm_mday && fin.tm_hour == debut.tm_hour && fin.tm_min == debut.tm_min
-       && fin.tm_sec < debut.tm_sec))
-    if (ret > 0)
-      ret--;
+  int ok = 1;
 
-  if (days)
+  for (const char *part = rule, *end; ok && *part; part = *end ? end + 1 : end)
   {
-    tm_addmonths (&debut, ret);
-    *days = coeff * tm_diffdays (debut, fin, seconds);
-    if (seconds)
-      *seconds *= coeff;
+    const char *equal;
+
+    if (!(end = strchr (part, ';')))
+      end = part + strlen (part);
+    if (!(equal = memchr (part, '=', (size_t) (end - part))))
+      ok = 0;
+    else
+      ok = tm_rruleparsepart (rrule, part, (size_t) (equal - part), equal + 1, end);
   }
 
-  return coeff * ret;
-}
+  // Ordinals of BYDAY are only meaningful within months and years.
+  for (int i = 0; ok && i < rrule->nbbyday; i++)
+    if (rrule->byday[i].ordinal && rrule->freq != TM_RRULE_MONTHLY && rrule->freq != TM_RRULE_YEARLY)
+      ok = 0;
 
-int
-tm_diffcalendaryears (struct tm debut, struct tm fin)
-{
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
+  if (!ok || (int) rrule->freq < 0 || (rrule->count && rrule->hasuntil))
   {
+    free (rrule);
     errno = EINVAL;
     return 0;
   }
 
-  return tm_getyear (fin) - tm_getyear (debut);
+  return rrule;
 }
 
-int
-tm_diffyears (struct tm debut, struct tm fin, int *months, int *days, int *seconds)
+tm_status
+tm_rrule_exclude (tm_rrule * rrule, const struct tm *exdate)
 {
-  int m = tm_diffmonths (debut, fin, days, seconds);
-  int d = days ? *days : 0;
-  int s = seconds ? *seconds : 0;
+  errno = 0;
+  time_t t = tm_calendartime (exdate);
 
-  if (months)
-    *months = m >= 0 ? m % 12 : -((-m) % 12);
-  else
-  {
-    if (days)
-      *days = d;
-    if (seconds)
-      *seconds = s;
-  }
-  return m / 12;
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
+  if (tm_rruleexcluded (rrule, t))
+    return TM_OK;
+
+  time_t *exdates = realloc (rrule->exdates, (rrule->nbexdates + 1) * sizeof (*exdates));
+
+  if (!exdates)
+    return TM_ERROR;
+
+  size_t i = rrule->nbexdates;
+
+  for (; i > 0 && exdates[i - 1] > t; i--)
+    exdates[i] = exdates[i - 1];
+  exdates[i] = t;
+  rrule->exdates = exdates;
+  rrule->nbexdates++;
+
+  return TM_OK;
+}
+
+void
+tm_rrule_iter_init (tm_rruleiter * it, const tm_rrule * rrule)
+{
+  it->rrule = rrule;
+  it->period = -1;
+  it->day = 1;
+  it->last = 0;                 // The first period is entered on the first call of tm_rrule_iter_next().
+  it->position = it->nbmatches = 0;
+  it->count = 0;
+  it->end = 0;
 }
 
 int
-tm_diffisoyears (struct tm debut, struct tm fin)
+tm_rrule_iter_next (tm_rruleiter * it)
 {
-  if (tm_getrepresentation (debut) != tm_getrepresentation (fin))
+  const tm_rrule *rrule = it->rrule;
+  long long day;
+
+  while (!it->end && (!rrule->count || it->count < rrule->count) && tm_rrulenextday (it, &day))
   {
-    errno = EINVAL;
-    return 0;
+    struct tm occurrence = rrule->dtstart;
+
+    it->count++;
+
+    // Same local time of day as DTSTART, and same handling of daylight saving time as tm_adddays().
+    if (day != rrule->startday && tm_adddays (&occurrence, (int) (day - rrule->startday)) == TM_ERROR)
+      break;
+
+    // Normalized by tm_adddays(): calendar time follows from the offset to UTC.
+    time_t t = (time_t) (tm_linearseconds (&occurrence) - occurrence.tm_gmtoff);
+
+    if (rrule->hasuntil && t > rrule->until)
+      break;
+    if (tm_rruleexcluded (rrule, t))
+      continue;
+
+    it->current = occurrence;
+    return 1;
   }
 
-  return tm_getisoyear (fin) - tm_getisoyear (debut);
+  it->end = 1;
+  return 0;
 }
 
-void
-tm_getintimezone (struct tm date, const char *tz, int *year, tm_month * month, int *day, int *hour, int *minute,
-                  int *second, int *isdst)
+tm_status
+tm_rrule_next (const tm_rrule * rrule, const struct tm *after, struct tm *occurrence)
 {
-  const char *oldtz = getenv ("TZ");
+  errno = 0;
+  time_t t = tm_calendartime (after);
 
-  // Switch to UTC
-  tm_toutcrepresentation (&date);
+  if (t == (time_t) - 1 && errno)
+    return TM_ERROR;
 
-  // Switch to local time in timezone tz
-  if (tz)
-    setenv ("TZ", tz, 1);
-  else
-    unsetenv ("TZ");
-  tm_tolocalrepresentation (&date);
+  tm_rruleiter it;
 
-  if (year)
-    *year = tm_getyear (date);
-  if (month)
-    *month = tm_getmonth (date);
-  if (day)
-    *day = tm_getday (date);
-  if (hour)
-    *hour = tm_gethour (date);
-  if (minute)
-    *minute = tm_getminute (date);
-  if (second)
-    *second = tm_getsecond (date);
-  if (isdst)
-    *isdst = tm_isdaylightsavingtime (date);
+  tm_rrule_iter_init (&it, rrule);
 
-  // Back to local timezone
-  if (oldtz)
-    setenv ("TZ", oldtz, 1);
-  else
-    unsetenv ("TZ");
-}
+  if (!rrule->count)
+  {
+    // Without COUNT, the occurrences before the period of the day before the local date of after can be skipped.
+    struct tm local = *after;
+    const tm_timezone *tz = tm_gettimezoneof_p (&rrule->dtstart);
+    tm_status ret = tm_isutcrepresentation_p (&rrule->dtstart) ? tm_toutcrepresentation (&local) :
+      tz ? tm_totimezonerepresentation (&local, tz) : tm_tolocalrepresentation (&local);
+    long long period = tm_rruleperiodof (rrule, tm_rrulefloordiv (tm_linearseconds (&local), 86400) - 1);
+
+    if (ret == TM_OK && period > 0)
+      it.period = period - 1;
+  }
 
-time_t
-tm_tobinary (struct tm date)
-{
-  return tm_normalize (&date);
+  while (tm_rrule_iter_next (&it))
+    if (tm_linearseconds (&it.current) - it.current.tm_gmtoff > t)
+    {
+      *occurrence = it.current;
+      return TM_OK;
+    }
+
+  return TM_ERROR;
 }
 
-tm_status
-tm_frombinary (struct tm * date, time_t binary)
+void
+tm_rrule_free (tm_rrule * rrule)
 {
-  return tm_makelocalfromcalendartime (binary, date);
+  if (!rrule)
+    return;
+
+  free (rrule->exdates);
+  free (rrule);
 }
@@ -5,6 +5,9 @@
 #define TM_DATES_H
 #pragma once
 
+#include <stdint.h>
+#include <time.h>
+
 ///@page Introduction
 /// This library is a tool box that facilitates the management of dates and times. It is a superset of lower level POSIX functions.
 /// The functions of this toolbox manipulate instants (points) in time expressed as a date and time of day, in Gregorian calendar.
@@ -36,6 +39,9 @@
 /// Functions for calculation are tm_add... and tm_diff....
 /// Functions for comparison are tm_compare() and tm_equals().
 /// Functions for persistance are tm_tobinary() and tm_frombinary().
+///
+/// Instants can also be stored in the compact type \p tm_instant (8 bytes, nanosecond resolution),
+/// suitable for time stamps of events. They are converted from and to \p struct \p tm with tm_toinstant() and tm_frominstant().
 
 ///@page Usage
 /// Usage requires including
@@ -48,6 +54,19 @@
 ///@name Data types
 ///@{
 
+/// Storage of the calendar functions defined in this header (such as tm_getdaysinmonth()): inlined by callers,
+/// and compiled once into the library for callers that take their address or do not inline them.
+#ifndef TM_INLINE
+#  if defined(__GNUC__)
+#    define TM_INLINE extern inline __attribute__ ((__gnu_inline__))
+#  else
+#    define TM_INLINE static inline
+#  endif
+#endif
+
+/// Size of a buffer large enough for any string formatted by tm_getiso8601intostring() or tm_getinstantiso8601intostring().
+#define TM_ISO8601MAXLENGTH 64
+
 ///@typedef tm_status
 /// Values of status
 typedef enum
@@ -95,6 +114,180 @@ typedef enum
   TM_MONTH_DECEMBER,            ///< December (12)
 } tm_month;
 
+///@typedef tm_timezone
+/// Timezone rules, loaded once with tm_loadtimezone() and shared by all threads.
+typedef struct tm_timezone tm_timezone;
+
+///@typedef tm_format
+/// Format compiled by tm_format_compile().
+typedef struct tm_format tm_format;
+
+///@typedef tm_parser
+/// Parser compiled by tm_parse_compile().
+typedef struct tm_parser tm_parser;
+
+///@typedef tm_logformat
+/// Format of log time stamps compiled by tm_logformat_compile().
+typedef struct tm_logformat tm_logformat;
+
+///@typedef tm_transition
+/// Transition of a timezone, from one local time type (offset to UTC, daylight saving time flag and abbreviation) to another.
+/// A transition with \p utcoffsetafter greater than \p utcoffsetbefore skips local times (gap, such as at a spring daylight savings cutover),
+/// a transition with \p utcoffsetafter less than \p utcoffsetbefore repeats local times (overlap, such as at an autumn daylight savings cutover).
+typedef struct
+{
+  size_t index;                 ///< Index of the transition in the transition table of the timezone
+  time_t when;                  ///< Instant of the transition, in seconds since 1970-01-01 00:00:00 UTC
+  long int utcoffsetbefore;     ///< Offset to UTC before the transition, in seconds (positive east of Greenwich)
+  long int utcoffsetafter;      ///< Offset to UTC from the transition on, in seconds
+  int isdstbefore;              ///< Daylight saving time flag before the transition
+  int isdstafter;               ///< Daylight saving time flag from the transition on
+  const char *abbreviationbefore;       ///< Abbreviation of the timezone before the transition
+  const char *abbreviationafter;        ///< Abbreviation of the timezone from the transition on
+} tm_transition;
+
+///@typedef tm_instant
+/// Compact instant in time: number of nanoseconds elapsed since 1970-01-01 00:00:00 UTC (leap seconds excluded).
+/// It covers instants from 1677-09-21 00:12:43.145224192 UTC to 2262-04-11 23:47:16.854775807 UTC.
+typedef int64_t tm_instant;
+
+///@typedef tm_clocksource
+/// System clocks read by tm_makenow(), tm_maketoday() and tm_makeinstantnow().
+typedef enum
+{
+  TM_CLOCK_REALTIME,            ///< System real time clock (CLOCK_REALTIME), by default
+  TM_CLOCK_REALTIME_COARSE,     ///< Faster but coarser system real time clock (CLOCK_REALTIME_COARSE, Linux specific)
+} tm_clocksource;
+
+///@typedef tm_clockfunction
+/// Clock defined by the user, read by tm_makenow(), tm_maketoday() and tm_makeinstantnow() (see tm_setclockfunction().)
+/// It stores current calendar time into \p now and returns \p TM_OK, or \p TM_ERROR on failure.
+struct timespec;
+typedef tm_status (*tm_clockfunction) (struct timespec *now, void *arg);
+
+///@typedef tm_iterunit
+/// Units of the steps of range iterators (see tm_iter_init()).
+typedef enum
+{
+  TM_ITER_SECOND,               ///< Seconds, along the time-line (as tm_addseconds())
+  TM_ITER_MINUTE,               ///< Minutes, along the time-line
+  TM_ITER_HOUR,                 ///< Hours, along the time-line: local days with DST change count 23 or 25 of them
+  TM_ITER_DAY,                  ///< Days, keeping the local time of day (as tm_adddays())
+  TM_ITER_WEEK,                 ///< Weeks, keeping the local time of day
+  TM_ITER_MONTH,                ///< Months, keeping the day of month (or the last day of shorter months) and the local time of day (as tm_addmonths())
+} tm_iterunit;
+
+///@typedef tm_iterflag
+/// Properties of the current element of a range iterator (see tm_iter_next()).
+typedef enum
+{
+  TM_ITER_OVERLAP_FIRST = 1,    ///< Local time repeated later by a backward transition (before DST loses effect)
+  TM_ITER_OVERLAP_SECOND = 2,   ///< Local time already occurred before a backward transition (after DST lost effect)
+  TM_ITER_SHIFTED = 4,          ///< Local time skipped by a forward transition: the element is shifted by the gap (days, weeks and months)
+} tm_iterflag;
+
+///@typedef tm_bucketunit
+/// Units of the buckets instants are truncated to (see tm_bucket_n()).
+typedef enum
+{
+  TM_BUCKET_MINUTE,             ///< Minutes, or several minutes from midnight
+  TM_BUCKET_HOUR,               ///< Hours, or several hours from midnight
+  TM_BUCKET_DAY,                ///< Days, from midnight (23 or 25 hours long at DST cutovers)
+  TM_BUCKET_WEEK,               ///< ISO 8601 weeks, from Monday (as tm_getisoweek())
+  TM_BUCKET_MONTH,              ///< Months, from the first day
+  TM_BUCKET_QUARTER,            ///< Quarters, from January, April, July and October 1st
+  TM_BUCKET_YEAR,               ///< Years, from January 1st
+} tm_bucketunit;
+
+///@typedef tm_record
+/// Compact binary record of an instant in time and of its representation (see tm_torecord()).
+typedef struct
+{
+  unsigned char bytes[16];      ///< Calendar time, UTC offset, representation and timezone, in an order that sorts as instants
+} tm_record;
+
+///@typedef tm_timeencoder
+/// Encoder of a column of calendar times (see tm_timeencoder_init()).
+/// Members \p data and \p size are the encoded column, complete after tm_timeencoder_flush(); the other members are private.
+typedef struct
+{
+  unsigned char *data;          ///< Encoded column, allocated by the encoder
+  size_t size;                  ///< Size of the encoded column, in bytes
+  size_t capacity;              ///< Allocated size of data
+  size_t blocksize;             ///< Number of values per block
+  size_t header;                ///< Offset of the header of the current block
+  size_t count;                 ///< Number of values in the current block
+  uint64_t last, delta;         ///< Last value, and difference between the last two values
+  uint64_t run;                 ///< Number of zero delta-of-deltas not written yet
+} tm_timeencoder;
+
+///@typedef tm_timedecoder
+/// Decoder of a column of calendar times encoded by a \p tm_timeencoder (see tm_timedecoder_init()).
+/// Member \p current is the current value, the other members are private.
+typedef struct
+{
+  time_t current;               ///< Current value
+  const unsigned char *data;    ///< Encoded column
+  size_t size;                  ///< Size of the encoded column, in bytes
+  size_t position;              ///< Offset of the next token
+  size_t blockend;              ///< Offset of the end of the current block
+  size_t remaining;             ///< Number of values left in the current block
+  uint64_t value, delta;        ///< Current value, and difference between the last two values
+  uint64_t run;                 ///< Number of zero delta-of-deltas left in the current run
+} tm_timedecoder;
+
+///@typedef tm_column
+/// Column file of instants mapped in memory by tm_column_open().
+typedef struct tm_column tm_column;
+
+///@typedef tm_iter
+/// Iterator over the instants of a range [start, end), by steps of seconds, minutes, hours, days, weeks or months.
+/// Members \p current, \p time, \p flags and \p daylength describe the current element, the other members are private.
+typedef struct
+{
+  struct tm current;            ///< Current element, in the representation of the start of the range
+  time_t time;                  ///< Calendar time of the current element
+  int flags;                    ///< Properties of the current element (\p tm_iterflag)
+  long int daylength;           ///< Number of seconds in the day of the current element (86400, or 82800 or 90000 at DST cutovers)
+  const tm_timezone *tz;        ///< Timezone of the range, 0 in UTC representation
+  struct tm start;              ///< Start of the range
+  tm_iterunit unit;             ///< Unit of steps
+  long long step;               ///< Step, in seconds along the time-line, or in days or months
+  long long index;              ///< Index of the next element, -1 past the end of the range
+  long long first, end;         ///< Calendar times of the start and end of the range
+  long long base;               ///< Day since 1970-01-01 or month since year 0 of the start of the range
+  long int secondsofday;        ///< Local time of day of the start of the range
+  int mday;                     ///< Day of month of the start of the range
+  long long from, to;           ///< Calendar times [from, to) of the interval between transitions of the current element
+  long long localfrom, localto; ///< Local times [localfrom, localto) mapped to this interval without ambiguity
+  long int utcoffset;           ///< Offset to UTC in this interval
+  int isdst;                    ///< Daylight saving time flag in this interval
+  const char *abbreviation;     ///< Abbreviation of the timezone in this interval
+  long long daystart;           ///< Local time of the beginning of the day of the current element
+} tm_iter;
+
+///@typedef tm_rrule
+/// Recurrence rule compiled by tm_rrule_compile().
+typedef struct tm_rrule tm_rrule;
+
+///@typedef tm_rruleiter
+/// Iterator over the occurrences of a recurrence rule (see tm_rrule_iter_init()).
+/// Member \p current is the current occurrence, the other members are private.
+typedef struct
+{
+  struct tm current;            ///< Current occurrence
+  const tm_rrule *rrule;        ///< Recurrence rule
+  long long period;             ///< Index of the current period (day, week, month or year) of the rule, 0 for the period of DTSTART
+  long long day, last;          ///< Next day to scan and last day of the current period, in days since 1970-01-01
+  int position, nbmatches;      ///< Rank of the last matching day in the current period, and number of matching days in the period (BYSETPOS)
+  long long count;              ///< Number of occurrences generated so far (COUNT)
+  int end;                      ///< 1 past the last occurrence
+} tm_rruleiter;
+
+///@typedef tm_index
+/// Sorted index of instants built by tm_index_build().
+typedef struct tm_index tm_index;
+
 ///@}
 
 /*****************************************************
@@ -108,6 +301,8 @@ typedef enum
 /// @param [out] dt Pointer to broken-down time structure
 /// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
 /// @remark The instant (point in time) is initialized in local time representation by default.
+/// @remark Each thread keeps the last local date and time it got: as long as the local time type (offset to UTC) does not change,
+/// only the seconds are updated from one call to the next, without any timezone lookup.
 tm_status tm_makenow (struct tm *dt);
 
 /// Initializes (or reinitializes) instant in time with current date, beginning of day, local time.
@@ -117,6 +312,18 @@ tm_status tm_makenow (struct tm *dt);
 /// @remark The instant (point in time) is initialized in local time representation by default.
 tm_status tm_maketoday (struct tm *dt);
 
+/// Selects the system clock read by tm_makenow(), tm_maketoday() and tm_makeinstantnow() in the calling thread.
+/// @param [in] source System clock
+/// @returns \p TM_OK, or \p TM_ERROR if the clock is not available on the system (errno is then set to EINVAL)
+/// @remark A clock function previously set by tm_setclockfunction() is discarded.
+tm_status tm_setclocksource (tm_clocksource source);
+
+/// Sets a clock defined by the user, read by tm_makenow(), tm_maketoday() and tm_makeinstantnow() in the calling thread
+/// (to replay recorded events or drive benchmarks with a synthetic clock, for instance.)
+/// @param [in] clock Clock function, or 0 to use the system clock selected by tm_setclocksource() again
+/// @param [in] arg Argument passed to \p clock
+void tm_setclockfunction (tm_clockfunction clock, void *arg);
+
 /// Initializes (or reinitializes) instant intime with local date and time attributes.
 /// @param [in] year The year, specified as a 4-digit number (for example, 1996), interpreted as a year in the Gregorian calendar (local time)
 /// @param [in] month The month (local time)
@@ -163,7 +370,8 @@ tm_status tm_makeutc (struct tm *dt, int year, tm_month month, int day, int hour
 tm_status tm_set (struct tm *dt, int year, tm_month month, int day, int hour, int min, int sec);
 
 /// Sets time from string.
-/// Recognized formats are : the locale's time format, the locale's alternative time representation, HH:MM:SS, HH:MM, (where HH is between 0 and 23)
+/// Recognized formats are : ISO 8601 times without fraction of second (HH:MM:SS, HH:MM, HHMMSS, HHMM, HH, where HH is between 0 and 23),
+/// the locale's time format, the locale's alternative time representation, H:MM:SS, H:MM.
 /// @param [in] str string representation of time (without date)
 /// @param [out] dt Pointer to broken-down time structure
 /// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
@@ -171,12 +379,13 @@ tm_status tm_set (struct tm *dt, int year, tm_month month, int day, int hour, in
 tm_status tm_settimefromstring (struct tm *dt, const char *str);
 
 /// Sets date from string.
-/// Recognized formats are : the locale's date format, the locale's alternative date representation, the ISO 8601 date format (YYYY-mm-dd).
+/// Recognized formats are : ISO 8601 dates (calendar YYYY-mm-dd, ordinal YYYY-ddd or week YYYY-Www-d, in extended or basic format),
+/// the locale's date format, the locale's alternative date representation, YYYY-m-d.
 /// A year specified on 2 digits is converted to the closest year on 4 digits.
 /// @param [in] str string representation of date (without time)
 /// @param [out] dt Pointer to broken-down time structure
 /// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
-/// @remark Behavior depends on time representation. Time representation is kept unchanged. Makes use of strptime().
+/// @remark Behavior depends on time representation. Time representation is kept unchanged. Makes use of strptime() for other formats than ISO 8601.
 tm_status tm_setdatefromstring (struct tm *dt, const char *str);
 
 ///@}
@@ -209,6 +418,120 @@ tm_status tm_getdateintostring (struct tm dt, char *str, size_t max);
 /// @remark Behavior depends on time representation. Makes call to strftime().
 tm_status tm_gettimeintostring (struct tm dt, char *str, size_t max);
 
+/// Formats date and time into an ISO 8601 / RFC 3339 string (YYYY-MM-DDThh:mm:ssZ in UTC representation, YYYY-MM-DDThh:mm:ss±hh:mm otherwise)
+/// and places the result in the character array \p str of size \p max. \p str should have been previously allocated elsewhere.
+/// @param [in] dt Broken-down time structure
+/// @param [in] max Size of the previously allocated string \p str (TM_ISO8601MAXLENGTH is always enough)
+/// @param [out] str null terminated string
+/// @param [out] length Length of the string \p str, without the terminating null byte, or 0
+/// @returns \p TM_OK if the result string, including the terminating null byte, does not exceed \p max bytes,
+///          \p TM_ERROR otherwise (and the contents of the string \p str are then unchanged.)
+/// @remark Independent of the locale. Years out of 0000 to 9999 are written with a sign and at least 4 digits (expanded representation).
+/// @remark Dates with fields out of range (such as \p tm_min = -1) are written as their normalized instant.
+tm_status tm_getiso8601intostring (struct tm dt, char *str, size_t max, size_t *length);
+
+///@}
+
+/*****************************************************
+*   COMPILED FORMATS                                 *
+*****************************************************/
+///@name Compiled formats
+/// A format of strftime() can be compiled once, and then applied many times without parsing it again.
+///@{
+
+/// Compiles a format of strftime().
+/// @param [in] fmt Format, as for strftime()
+/// @returns Compiled format, to be released by tm_format_free(), or 0 if out of memory
+/// @remark The names of days, months and AM/PM and the composite formats (%c, %x, %X, %r) of the current locale (LC_TIME)
+/// are resolved at compilation: a compiled format keeps formatting for the locale in effect when it was compiled.
+tm_format *tm_format_compile (const char *fmt);
+
+/// Formats date and time according to a compiled format, as strftime() would with the original format.
+/// @param [in] prog Compiled format
+/// @param [in] dt Pointer to broken-down time structure
+/// @param [out] buf null terminated string
+/// @param [in] len Size of the previously allocated string \p buf
+/// @returns The number of bytes placed in \p buf, not including the terminating null byte,
+///          or 0 if the result string, including the terminating null byte, exceeds \p len bytes (the contents of \p buf are then undefined.)
+/// @remark Output is byte-identical to strftime(). The most common conversions are formatted directly from the fields of \p dt;
+/// the other ones (such as %G, %V, %s, or conversions with flags, width or modifiers E and O) and values out of range are delegated to strftime().
+size_t tm_format_exec (const tm_format *prog, const struct tm *dt, char *buf, size_t len);
+
+/// Releases a compiled format.
+/// @param [in] prog Compiled format, or 0
+void tm_format_free (tm_format *prog);
+
+///@}
+
+///@name Compiled parsers
+/// A format of strptime() can be compiled once into a specialized parser, and then applied many times without parsing it again.
+///@{
+
+/// Compiles a format of strptime().
+/// @param [in] fmt Format, as for strptime()
+/// @returns Compiled parser, to be released by tm_parse_free(), or 0 if out of memory or if the format contains an unsupported conversion (errno is then set to EINVAL)
+/// @remark Supported conversions are %Y, %y, %m, %d, %e, %j, %H, %k, %I, %l, %M, %S, %b, %B, %h, %a, %A, %p, %z, %n, %t, %%
+/// and the composite conversions %D, %F, %R and %T.
+/// Numbers have at most the number of digits of the conversion (4 for %Y, 3 for %j, 2 otherwise), as strptime() reads them.
+/// The names of days, months and AM/PM of the current locale (LC_TIME) are resolved at compilation and matched case insensitively.
+tm_parser *tm_parse_compile (const char *fmt);
+
+/// Parses local date and time according to a compiled parser.
+/// @param [in] parser Compiled parser
+/// @param [in] str String, not necessarily null terminated
+/// @param [in] len Length of \p str
+/// @param [out] dt Pointer to broken-down time structure, in local time representation
+/// @returns \p TM_OK or \p TM_ERROR if \p str does not match the format entirely or is not a valid local date and time
+/// @remark Fields missing from the format default to 1970-01-01 00:00:00.
+/// Dates and times are validated as tm_makelocal() does: invalid dates (such as 2016-02-30) and local times skipped by daylight saving time are rejected.
+/// If the format contains %z, the date and time is taken at that offset to UTC and presented in local time.
+tm_status tm_parse_exec (const tm_parser *parser, const char *str, size_t len, struct tm *dt);
+
+/// Parses an instant according to a compiled parser.
+/// @param [in] parser Compiled parser
+/// @param [in] str String, not necessarily null terminated
+/// @param [in] len Length of \p str
+/// @param [out] instant Instant
+/// @returns \p TM_OK or \p TM_ERROR
+/// @remark Same as tm_parse_exec(), without breaking the instant down into local time if the format contains %z.
+tm_status tm_parse_execinstant (const tm_parser *parser, const char *str, size_t len, tm_instant *instant);
+
+/// Releases a compiled parser.
+/// @param [in] parser Compiled parser, or 0
+void tm_parse_free (tm_parser *parser);
+
+///@}
+
+///@name Log time stamps
+/// Time stamps of consecutive log lines usually share the same second or minute: the rendered time stamp is kept by each thread
+/// and only the digits that changed are patched.
+///@{
+
+/// Compiles a format of log time stamps.
+/// @param [in] fmt Format, as for strftime(), where %N stands for nanoseconds (9 digits) and %<n>N for the first <n> digits of the fraction of second (%3N for milliseconds, for instance),
+///                 or 0 for the format of tm_getdateintostring() and tm_gettimeintostring() ("%x %X")
+/// @returns Compiled format, to be released by tm_logformat_free(), or 0 if out of memory or if the format is too long or contains more than 8 conversions %S and %N (errno is then set to EINVAL)
+/// @remark Composite conversions containing seconds (%T, %X, %c and %r) are expanded at compilation, so that seconds can be patched.
+tm_logformat *tm_logformat_compile (const char *fmt);
+
+/// Formats an instant as a log time stamp.
+/// @param [in] log Compiled format
+/// @param [in] instant Instant
+/// @param [in] representation Local time (\p TM_REP_LOCAL) or UTC (\p TM_REP_UTC)
+/// @param [out] buf null terminated string
+/// @param [in] len Size of the previously allocated string \p buf
+/// @returns The number of bytes placed in \p buf, not including the terminating null byte,
+///          or 0 if the result string, including the terminating null byte, exceeds \p len bytes or on overflow.
+/// @remark The result is the same as strftime() would give, with the fraction of second in place of %N.
+/// Each thread keeps the last time stamp it rendered: if \p instant falls in the same second, it is copied and only the fraction of second is patched;
+/// if it falls in the same minute, the seconds are patched as well. The format is only applied again when the minute changes
+/// (or when the rest of the format depends on the second, such as %s.)
+size_t tm_logformat_exec (const tm_logformat *log, tm_instant instant, tm_representation representation, char *buf, size_t len);
+
+/// Releases a compiled format of log time stamps.
+/// @param [in] log Compiled format, or 0
+void tm_logformat_free (tm_logformat *log);
+
 ///@}
 
 /*****************************************************
@@ -314,6 +637,11 @@ tm_status tm_todaylightsavingextrawintertime (struct tm *date);
 /// @returns 1 if the two broken-down time have the same value, 0 otherwise.
 int tm_equals (struct tm a, struct tm b);
 
+/// Same as tm_equals(), without copying the broken-down time structures.
+/// @param [in] a Pointer to broken-down time structure
+/// @param [in] b Pointer to broken-down time structure
+int tm_equals_p (const struct tm *a, const struct tm *b);
+
 /// Gets number of seconds between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -322,6 +650,12 @@ int tm_equals (struct tm a, struct tm b);
 /// @remark A difference of 0 seconds means \p debut and \p fin correspond to the same instant, independently of representation.
 long int tm_diffseconds (struct tm debut, struct tm fin);
 
+/// Same as tm_diffseconds(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+/// @remark Calendar time is computed from the rules of the timezone, without normalizing a copy of \p debut and \p fin.
+long int tm_diffseconds_p (const struct tm *debut, const struct tm *fin);
+
 /// Compares two dates.
 /// @param [in] debut Pointer to broken-down time structure
 /// @param [in] fin Pointer to broken-down time structure
@@ -330,6 +664,21 @@ long int tm_diffseconds (struct tm debut, struct tm fin);
 /// @remark Compatible for use with qsort().
 int tm_compare (const void *debut, const void *fin);
 
+/// Sorts an array of dates in chronological order.
+/// @param [in,out] dates Array of \p n broken-down time structures, either in local timezone or UTC representation
+/// @param [in] n Number of dates
+/// @returns \p TM_OK, or \p TM_ERROR (out of memory, or dates that could not be converted to calendar time) with \p dates unchanged
+/// @remark Same order as qsort() with tm_compare(), much faster: the calendar time of each date is computed once (see tm_tobinary_n()),
+/// and dates are sorted with a radix sort on those keys, in O(n). The sort is stable: dates at the same instant keep their order.
+tm_status tm_sort (struct tm *dates, size_t n);
+
+/// Sorts the indexes of an array of dates in chronological order, without moving the dates (see tm_sort()).
+/// @param [in] dates Array of \p n broken-down time structures, either in local timezone or UTC representation
+/// @param [in] n Number of dates
+/// @param [out] indexes Array of \p n indexes: \p dates[\p indexes[0]] is the earliest date, \p dates[\p indexes[n - 1]] the latest
+/// @returns \p TM_OK, or \p TM_ERROR (out of memory, or dates that could not be converted to calendar time)
+tm_status tm_sortindex (const struct tm *dates, size_t n, size_t *indexes);
+
 /// Gets number of partial days between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -337,8 +686,23 @@ int tm_compare (const void *debut, const void *fin);
 /// @remark Partial days are counted as 1.
 /// @remark Behavior depends on time representation.
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
+/// @remark Computed in constant time from the years and days of year of \p debut and \p fin.
 int tm_diffcalendardays (struct tm debut, struct tm fin);
 
+/// Same as tm_diffcalendardays(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+int tm_diffcalendardays_p (const struct tm *debut, const struct tm *fin);
+
+/// Gets numbers of partial days between pairs of dates (see tm_diffcalendardays()).
+/// @param [out] out Array of \p n numbers of partial or complete days between \p debut[i] and \p fin[i], 0 for pairs in error
+/// @param [in] debut Array of \p n broken-down time structures
+/// @param [in] fin Array of \p n broken-down time structures
+/// @param [in] n Number of pairs of dates
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR (different representations, or overflow) for each pair, or 0
+/// @returns TM_OK if all pairs were computed, TM_ERROR otherwise.
+tm_status tm_diffcalendardays_n (int *out, const struct tm *debut, const struct tm *fin, size_t n, tm_status *status);
+
 /// Gets number of complete days between two dates.
 /// In case representation for both indtants of time is local, days including between standard time and daylight saving time count for 23 or 25 hours rather than 24.
 /// I.e., difference between march the 14th, 9 am and march the 28th, 9 am, 2016, local Paris time, is 14 days, even though it includes only 335 hours.
@@ -351,6 +715,12 @@ int tm_diffcalendardays (struct tm debut, struct tm fin);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffdays (struct tm debut, struct tm fin, int *seconds);
 
+/// Same as tm_diffdays(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+/// @param [out] seconds Remainder in seconds (optional)
+int tm_diffdays_p (const struct tm *debut, const struct tm *fin, int *seconds);
+
 /// Gets number of complete weeks between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -361,6 +731,13 @@ int tm_diffdays (struct tm debut, struct tm fin, int *seconds);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffweeks (struct tm debut, struct tm fin, int *days, int *seconds);
 
+/// Same as tm_diffweeks(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+/// @param [out] days Remainder in days (optional)
+/// @param [out] seconds Remainder in seconds (optional)
+int tm_diffweeks_p (const struct tm *debut, const struct tm *fin, int *days, int *seconds);
+
 /// Gets number of partial months between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -370,6 +747,11 @@ int tm_diffweeks (struct tm debut, struct tm fin, int *days, int *seconds);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffcalendarmonths (struct tm debut, struct tm fin);
 
+/// Same as tm_diffcalendarmonths(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+int tm_diffcalendarmonths_p (const struct tm *debut, const struct tm *fin);
+
 /// Gets number of complete months between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -381,6 +763,13 @@ int tm_diffcalendarmonths (struct tm debut, struct tm fin);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffmonths (struct tm debut, struct tm fin, int *days, int *seconds);
 
+/// Same as tm_diffmonths(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+/// @param [out] days Remainder in days (optional)
+/// @param [out] seconds Remainder in seconds (optional)
+int tm_diffmonths_p (const struct tm *debut, const struct tm *fin, int *days, int *seconds);
+
 /// Gets number of partial years between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -390,6 +779,11 @@ int tm_diffmonths (struct tm debut, struct tm fin, int *days, int *seconds);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffcalendaryears (struct tm debut, struct tm fin);
 
+/// Same as tm_diffcalendaryears(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+int tm_diffcalendaryears_p (const struct tm *debut, const struct tm *fin);
+
 /// Gets number of complete years between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -402,6 +796,14 @@ int tm_diffcalendaryears (struct tm debut, struct tm fin);
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffyears (struct tm debut, struct tm fin, int *months, int *days, int *seconds);
 
+/// Same as tm_diffyears(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+/// @param [out] months Remainder in months (optional)
+/// @param [out] days Remainder in days (optional)
+/// @param [out] seconds Remainder in seconds (optional)
+int tm_diffyears_p (const struct tm *debut, const struct tm *fin, int *months, int *days, int *seconds);
+
 /// Gets number of partial ISO years between two dates.
 /// @param [in] debut Broken-down time structure
 /// @param [in] fin Broken-down time structure
@@ -411,6 +813,175 @@ int tm_diffyears (struct tm debut, struct tm fin, int *months, int *days, int *s
 /// @remark Both \p debut and \p fin should have identical representation, otherwise result is unspecified.
 int tm_diffisoyears (struct tm debut, struct tm fin);
 
+/// Same as tm_diffisoyears(), without copying the broken-down time structures.
+/// @param [in] debut Pointer to broken-down time structure
+/// @param [in] fin Pointer to broken-down time structure
+int tm_diffisoyears_p (const struct tm *debut, const struct tm *fin);
+
+///@}
+
+/*****************************************************
+*   ITERATORS                                        *
+*****************************************************/
+///@name Iterators
+/// Range iterators walk through instants in time without normalizing each element:
+///@verbatim
+/// tm_iter it;
+///
+/// for (tm_iter_init (&it, &start, &end, TM_ITER_HOUR, 1); tm_iter_next (&it);)
+///   printf ("%02i:00%s\n", tm_gethour_p (&it.current), it.flags & TM_ITER_OVERLAP_SECOND ? " (again)" : "");
+///@endverbatim
+///@{
+
+/// Initializes an iterator over the instants of the range [\p start, \p end).
+/// The element of index \p k is \p start plus \p k * \p step units, as tm_addseconds(), tm_adddays() or tm_addmonths() would compute it:
+/// - steps of seconds, minutes and hours are absolute, along the time-line;
+/// - steps of days, weeks and months keep the local time of day (and day of month) of \p start.
+/// @param [out] it Iterator
+/// @param [in] start Pointer to broken-down time structure, first element of the range
+/// @param [in] end Pointer to broken-down time structure, excluded from the range
+/// @param [in] unit Unit of steps
+/// @param [in] step Number of units per step (positive)
+/// @returns \p TM_OK, or \p TM_ERROR (invalid arguments, or dates that could not be converted to calendar time)
+/// @remark Elements are represented as \p start (UTC, local time or another timezone).
+tm_status tm_iter_init (tm_iter * it, const struct tm *start, const struct tm *end, tm_iterunit unit, int step);
+
+/// Moves an iterator to the next element of its range.
+/// The first call moves it to the start of the range.
+/// @param [in,out] it Iterator
+/// @returns 1 if \p it->current is the next element, 0 at the end of the range (or on overflow)
+/// @remark The next element is computed from the previous one, within the interval between the transitions of the timezone around it:
+/// elements are broken down and flagged in a few integer operations, and timezone rules are only looked up once per transition.
+int tm_iter_next (tm_iter * it);
+
+///@}
+
+///@name Recurrence rules
+/// Recurrence rules of iCalendar (RFC 5545), such as "FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=-1" (last workday of the month),
+/// are compiled once and their occurrences expanded lazily:
+///@verbatim
+/// tm_rrule *rrule = tm_rrule_compile ("FREQ=WEEKLY;INTERVAL=2;BYDAY=TU,TH;COUNT=8", &dtstart);
+/// tm_rruleiter it;
+///
+/// for (tm_rrule_iter_init (&it, rrule); tm_rrule_iter_next (&it);)
+///   ... it.current ...
+/// tm_rrule_free (rrule);
+///@endverbatim
+///@{
+
+/// Compiles a recurrence rule.
+/// @param [in] rule Recurrence rule (RRULE), with or without the prefix "RRULE:"
+/// @param [in] dtstart Pointer to broken-down time structure, first instant of the recurrence (DTSTART)
+/// @returns Compiled recurrence rule, to be released by tm_rrule_free(), or 0 if out of memory or if the rule is not valid or not supported (errno is then set to EINVAL)
+/// @remark Supported parts are FREQ (DAILY, WEEKLY, MONTHLY or YEARLY), INTERVAL, COUNT, UNTIL, BYMONTH, BYMONTHDAY, BYDAY, BYSETPOS and WKST.
+/// Occurrences are at the local time of day of \p dtstart, in its representation (UTC, local time or another timezone),
+/// on the days matching the rule from the day of \p dtstart on.
+/// An UNTIL without 'Z' is a local date and time in the timezone of \p dtstart.
+tm_rrule *tm_rrule_compile (const char *rule, const struct tm *dtstart);
+
+/// Excludes an instant from the occurrences of a recurrence rule (EXDATE).
+/// @param [in,out] rrule Compiled recurrence rule
+/// @param [in] exdate Pointer to broken-down time structure, excluded instant
+/// @returns \p TM_OK, or \p TM_ERROR (out of memory, or date that could not be converted to calendar time)
+/// @remark Excluded occurrences still count for COUNT, as RFC 5545 specifies.
+tm_status tm_rrule_exclude (tm_rrule *rrule, const struct tm *exdate);
+
+/// Initializes an iterator over the occurrences of a recurrence rule.
+/// @param [out] it Iterator
+/// @param [in] rrule Compiled recurrence rule, not modified while iterated over
+void tm_rrule_iter_init (tm_rruleiter * it, const tm_rrule *rrule);
+
+/// Moves an iterator to the next occurrence of its recurrence rule.
+/// The first call moves it to the first occurrence.
+/// @param [in,out] it Iterator
+/// @returns 1 if \p it->current is the next occurrence, 0 after the last occurrence
+/// @remark Occurrences are computed one at a time, as tm_adddays() would from \p dtstart: daylight saving time is taken into account the same way.
+int tm_rrule_iter_next (tm_rruleiter * it);
+
+/// Gets the first occurrence of a recurrence rule after an instant.
+/// @param [in] rrule Compiled recurrence rule
+/// @param [in] after Pointer to broken-down time structure
+/// @param [out] occurrence First occurrence strictly after \p after
+/// @returns \p TM_OK, or \p TM_ERROR if there is no occurrence after \p after
+/// @remark Without COUNT, the periods of the rule before \p after are skipped, not expanded.
+tm_status tm_rrule_next (const tm_rrule *rrule, const struct tm *after, struct tm *occurrence);
+
+/// Releases a compiled recurrence rule.
+/// @param [in] rrule Compiled recurrence rule, or 0
+void tm_rrule_free (tm_rrule *rrule);
+
+///@}
+
+///@name Indexes
+/// An index sorts instants once for repeated range and point queries.
+/// Queries return ranks in the sorted order, from 0 to the number of instants,
+/// and tm_index_at() gives back the position of the instant of a rank in the array the index was built from:
+///@verbatim
+/// tm_index *index = tm_index_build (events, n, TM_REP_LOCAL);
+/// size_t first, last;
+///
+/// if (tm_index_day (index, 2024, TM_MONTH_MARCH, 31, &first, &last) == TM_OK)
+///   for (size_t rank = first; rank < last; rank++)
+///     ... events[tm_index_at (index, rank)] ...
+/// tm_index_free (index);
+///@endverbatim
+///@{
+
+/// Builds a sorted index of instants.
+/// @param [in] dates Array of broken-down time structures
+/// @param [in] n Number of elements of \p dates
+/// @param [in] representation Representation (UTC or local time) of the days of tm_index_day()
+/// @returns Index, to be released by tm_index_free(), or 0 if out of memory or if a date could not be converted to calendar time
+/// @remark Instants are sorted as tm_sortindex() does, on their calendar times (equal instants in their order in \p dates).
+/// The index keeps, for each day from the first to the last instant, the rank of its first instant,
+/// which narrows queries down to a day (unless instants are spread over many more days than there are instants).
+/// \p dates is not referenced after the call.
+tm_index *tm_index_build (const struct tm *dates, size_t n, tm_representation representation);
+
+/// Gets the position of an instant of an index in the array it was built from.
+/// @param [in] index Index
+/// @param [in] rank Rank of the instant in the sorted order, less than the number of instants
+/// @returns Position of the instant
+size_t tm_index_at (const tm_index * index, size_t rank);
+
+/// Gets the rank of the first instant of an index not earlier than a date.
+/// @param [in] index Index
+/// @param [in] date Pointer to broken-down time structure
+/// @param [out] rank Rank of the first instant at or after \p date, the number of instants if there is none
+/// @returns \p TM_OK, or \p TM_ERROR if \p date could not be converted to calendar time
+tm_status tm_index_lowerbound (const tm_index * index, const struct tm *date, size_t *rank);
+
+/// Gets the rank of the first instant of an index later than a date.
+/// @param [in] index Index
+/// @param [in] date Pointer to broken-down time structure
+/// @param [out] rank Rank of the first instant strictly after \p date, the number of instants if there is none
+/// @returns \p TM_OK, or \p TM_ERROR if \p date could not be converted to calendar time
+tm_status tm_index_upperbound (const tm_index * index, const struct tm *date, size_t *rank);
+
+/// Gets the ranks of the instants of an index in a range of dates.
+/// @param [in] index Index
+/// @param [in] from Pointer to broken-down time structure, beginning of the range
+/// @param [in] to Pointer to broken-down time structure, end of the range (excluded)
+/// @param [out] first Rank of the first instant in [\p from, \p to)
+/// @param [out] last Rank following the last instant in [\p from, \p to), equal to \p first if the range is empty
+/// @returns \p TM_OK, or \p TM_ERROR if a date could not be converted to calendar time
+tm_status tm_index_range (const tm_index * index, const struct tm *from, const struct tm *to, size_t *first, size_t *last);
+
+/// Gets the ranks of the instants of an index on a day, in the representation the index was built with.
+/// @param [in] index Index
+/// @param [in] year Year
+/// @param [in] month Month
+/// @param [in] day Day of month
+/// @param [out] first Rank of the first instant of the day
+/// @param [out] last Rank following the last instant of the day, equal to \p first if there is none
+/// @returns \p TM_OK, or \p TM_ERROR (invalid date, errno is then set to EINVAL)
+/// @remark Days in local time last from local midnight (or the first instant after it if skipped) to the next one, 23 or 25 hours on daylight saving time transitions.
+tm_status tm_index_day (const tm_index * index, int year, tm_month month, int day, size_t *first, size_t *last);
+
+/// Releases an index.
+/// @param [in] index Index, or 0
+void tm_index_free (tm_index * index);
+
 ///@}
 
 /*****************************************************
@@ -429,6 +1000,7 @@ tm_status tm_toutcrepresentation (struct tm *date);
 /// Switches representation of instant in time to local time
 /// @param [in,out] date Pointer to broken-down time structure
 /// @remark Has no effect if time representation is local time already.
+/// @remark An instant in time represented in another timezone (see tm_totimezonerepresentation()) is switched to the local timezone.
 tm_status tm_tolocalrepresentation (struct tm *date);
 
 /// Indicates that the representation of instant in time is UTC.
@@ -436,16 +1008,28 @@ tm_status tm_tolocalrepresentation (struct tm *date);
 /// @returns 1 if \p date is in UTC representation, 0 otherwise.
 int tm_isutcrepresentation (struct tm date);
 
+/// Same as tm_isutcrepresentation(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_isutcrepresentation_p (const struct tm *date);
+
 /// Indicates that the representation of instant in time is local time.
 /// @param [in] date Broken-down time structure
 /// @returns 1 if \p date is in local time representation, 0 otherwise.
 int tm_islocalrepresentation (struct tm date);
 
+/// Same as tm_islocalrepresentation(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_islocalrepresentation_p (const struct tm *date);
+
 /// Gets the current representation of instant in time.
 /// @param [in] date Broken-down time structure
 /// @returns Date and time representation (\p TM_LOCAL or \p TM_UTC)
 tm_representation tm_getrepresentation (struct tm date);
 
+/// Same as tm_getrepresentation(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+tm_representation tm_getrepresentation_p (const struct tm *date);
+
 ///@}
 
 /*****************************************************
@@ -465,104 +1049,238 @@ int tm_hasdaylightsavingtimerules (void);
 /// @remark Behavior depends on time representation. In UTC represntation, 0 is returned.
 int tm_isdaylightsavingtime (struct tm date);
 
+/// Same as tm_isdaylightsavingtime(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_isdaylightsavingtime_p (const struct tm *date)
+{
+  return date->tm_isdst;
+}
+
 /// Indicates that (local) date and time occurs during the overlapping period at DST cutoff and will be repeated after DST looses effect.
 /// @param [in] date Broken-down time structure
 /// @returns 1 if time is duplicated (before DST change), 0 otherwise.
 /// @remark Behavior depends on time representation.
 int tm_isdaylightsavingextrasummertime (struct tm date);
 
+/// Same as tm_isdaylightsavingextrasummertime(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_isdaylightsavingextrasummertime_p (const struct tm *date);
+
 /// Indicates that (local) date and time occurs during the overlapping period at DST cutoff and has already occured before DST lost effect.
 /// @param [in] date Broken-down time structure
 /// @returns 1 if time is duplicated (after DST change), 0 otherwise.
 /// @remark Behavior depends on time representation.
 int tm_isdaylightsavingextrawintertime (struct tm date);
 
+/// Same as tm_isdaylightsavingextrawintertime(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_isdaylightsavingextrawintertime_p (const struct tm *date);
+
 ///@}
 
 /*****************************************************
 *   PROPERTIES GETTERS                               *
 *****************************************************/
 ///@name Getters
+/// Functions suffixed with \p _p take a pointer to the broken-down time structure rather than a copy of it.
 ///@{
 
+TM_INLINE int tm_isleapyear (int year);
+
 /// Gets the year, in the Gregorian calendar.
 /// @param [in] date Broken-down time structure
 /// @returns Year
 /// @remark Behavior depends on time representation.
 int tm_getyear (struct tm date);
 
+/// Same as tm_getyear(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getyear_p (const struct tm *date)
+{
+  return date->tm_year + 1900;
+}
+
 /// Gets the month in year, in the Gregorian calendar.
 /// @param [in] date Broken-down time structure
 /// @returns Month (1 = January, ..., 12=December)
 /// @remark Behavior depends on time representation.
 tm_month tm_getmonth (struct tm date);
 
+/// Same as tm_getmonth(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE tm_month
+tm_getmonth_p (const struct tm *date)
+{
+  return (tm_month) (date->tm_mon + 1);      /* January = 1, December = 12 */
+}
+
 /// Gets the day of the month, in the Gregorian calendar.
 /// @param [in] date Broken-down time structure
 /// @returns Day of month
 /// @remark Behavior depends on time representation.
 int tm_getday (struct tm date);
 
+/// Same as tm_getday(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getday_p (const struct tm *date)
+{
+  return date->tm_mday;
+}
+
 /// Gets hours.
 /// @param [in] date Broken-down time structure
 /// @returns Hours (between 0 and 23)
 /// @remark Behavior depends on time representation.
 int tm_gethour (struct tm date);
 
+/// Same as tm_gethour(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_gethour_p (const struct tm *date)
+{
+  return date->tm_hour;
+}
+
 /// Gets minutes.
 /// @param [in] date Broken-down time structure
 /// @returns Minutes (between 0 and 59)
 /// @remark Behavior depends on time representation.
 int tm_getminute (struct tm date);
 
+/// Same as tm_getminute(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getminute_p (const struct tm *date)
+{
+  return date->tm_min;
+}
+
 /// Gets seconds.
 /// @param [in] date Broken-down time structure
 /// @returns Seconds (between 0 and 59)
 /// @remark Behavior depends on time representation.
 int tm_getsecond (struct tm date);
 
+/// Same as tm_getsecond(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getsecond_p (const struct tm *date)
+{
+  return date->tm_sec;
+}
+
 /// Gets day of year.
 /// @param [in] date Broken-down time structure
 /// @returns Day of year (1 = January, the 1st)
 /// @remark Behavior depends on time representation.
 int tm_getdayofyear (struct tm date);
 
+/// Same as tm_getdayofyear(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getdayofyear_p (const struct tm *date)
+{
+  return date->tm_yday + 1;      /* 1/1 = 1, 31/12 = 365 or 366 */
+}
+
 /// Gets day of week.
 /// @param [in] date Broken-down time structure
 /// @returns Day of week (1 = Monday, 7 = Sunday)
 /// @remark Behavior depends on time representation.
 tm_dayofweek tm_getdayofweek (struct tm date);
 
+/// Same as tm_getdayofweek(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE tm_dayofweek
+tm_getdayofweek_p (const struct tm *date)
+{
+  return (tm_dayofweek) ((date->tm_wday + 6) % 7 + 1);      /* Monday = 1, Sunday = 7 */
+}
+
 /// Gets ISO week.
 /// @param [in] date Broken-down time structure
 /// @returns ISO 8601 week
 /// @remark Behavior depends on time representation.
 int tm_getisoweek (struct tm date);
 
+/// Same as tm_getisoweek(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getisoweek_p (const struct tm *date)
+{
+  /** ISO 8601 week date: The first week of a year (starting on Monday) is :
+     - the first week that contains at least 4 days of calendar year.
+     - the week that contains the first Thursday of a year.
+     - the week with January 4 in it
+   */
+
+  int week = (date->tm_yday - (date->tm_wday + 6) % 7 + 10) / 7;
+
+  if (week == 0)
+    return (date->tm_yday + 365 + tm_isleapyear (date->tm_year + 1900 - 1) - (date->tm_wday + 6) % 7 + 10) / 7;
+  else if (week > 52
+           && ((date->tm_yday - 365 - tm_isleapyear (date->tm_year + 1900) - (date->tm_wday + 6) % 7 + 10) / 7) > 0)
+    return (date->tm_yday - 365 - tm_isleapyear (date->tm_year + 1900) - (date->tm_wday + 6) % 7 + 10) / 7;
+  else
+    return week;
+}
+
 /// Gets ISO year.
 /// @param [in] date Broken-down time structure
 /// @returns ISO 8601 year
 /// @remark Behavior depends on time representation.
 int tm_getisoyear (struct tm date);
 
+/// Same as tm_getisoyear(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+TM_INLINE int
+tm_getisoyear_p (const struct tm *date)
+{
+  /* Year of which ISO week of date belongs to. */
+  int week = (date->tm_yday - (date->tm_wday + 6) % 7 + 10) / 7;
+
+  if (week == 0)
+    return date->tm_year + 1900 - 1;
+  else if (week > 52
+           && ((date->tm_yday - 365 - tm_isleapyear (date->tm_year + 1900) - (date->tm_wday + 6) % 7 + 10) / 7) > 0)
+    return date->tm_year + 1900 + 1;
+  else
+    return date->tm_year + 1900;
+}
+
 /// Gets offset between UTC and local time.
 /// @param [in] date Broken-down time structure
 /// @returns Offset, in seconds, between UTC and time representation (local or UTC)
 /// @remark Behavior depends on time representation.
 int tm_getutcoffset (struct tm date);
 
+/// Same as tm_getutcoffset(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_getutcoffset_p (const struct tm *date);
+
 /// Gets the name of the time zone (either UTC or local time depending on current representation).
 /// @param [in] date Broken-down time structure
 /// @returns Timezone abbreviation
 /// @remark Behavior depends on time representation.
 const char *tm_gettimezone (struct tm date);
 
+/// Same as tm_gettimezone(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+const char *tm_gettimezone_p (const struct tm *date);
+
 /// Gets seconds of day.
 /// @param [in] date Broken-down time structure
 /// @returns Elapsed seconds since beginning of day.
 /// @remark Behavior depends on time representation.
 int tm_getsecondsofday (struct tm date);
 
+/// Same as tm_getsecondsofday(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+int tm_getsecondsofday_p (const struct tm *date);
+
 ///@}
 
 /*****************************************************
@@ -582,11 +1300,99 @@ int tm_getsecondsofday (struct tm date);
 /// @param [out] minute Minute at the time described in target timezone
 /// @param [out] second Second at the time described in target timezone
 /// @param [out] is_dst_on Indicates whether (1) or not (0) daylight saving time is in effect at the time described in target timezone
+/// @remark Environment variable TZ is not modified, unless \p tz can not be found in the timezone database.
 void tm_getintimezone (struct tm date, const char *tz, int *year, tm_month * month, int *day, int *hour, int *minute,
                        int *second, int *is_dst_on);
 
 ///@}
 
+/*****************************************************
+*   TIMEZONES                                        *
+*****************************************************/
+///@name Timezones
+/// Instants in time can be represented in the local time of any timezone, not only the local timezone of the process.
+/// An instant in time represented in a timezone keeps track of it: calculations (tm_add..., tm_diff...), comparisons and
+/// conversions then apply the rules of this timezone, as they apply the rules of the local timezone in local time representation.
+/// None of these functions read or modify environment variable TZ: they can be called concurrently by several threads.
+///@{
+
+/// Loads the rules of a timezone.
+/// The rules are read from the timezone database once, and kept for the lifetime of the process.
+/// @param [in] name Timezone, such as "Europe/Paris" or "CET-1CEST,M3.5.0,M10.5.0/3" (see "man tzset" for details on possible values for \p name)
+/// @returns Timezone, or 0 if \p name is unknown
+/// @remark Rules are known up to year 2200 (or for ever, if the timezone does not have daylight saving time rules any more.)
+const tm_timezone *tm_loadtimezone (const char *name);
+
+/// Gets the local timezone, as specified by environment variable TZ.
+/// @returns Local timezone, or 0 if it can not be found in the timezone database
+const tm_timezone *tm_getlocaltimezone (void);
+
+/// Gets the name of a timezone.
+/// @param [in] tz Timezone
+/// @returns Name of the timezone, as passed to tm_loadtimezone()
+const char *tm_gettimezonename (const tm_timezone * tz);
+
+/// Gets the timezone in which an instant in time is represented.
+/// @param [in] date Broken-down time structure
+/// @returns Timezone, or 0 if \p date is in UTC representation
+const tm_timezone *tm_gettimezoneof (struct tm date);
+
+/// Same as tm_gettimezoneof(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+const tm_timezone *tm_gettimezoneof_p (const struct tm *date);
+
+/// Initializes (or reinitializes) instant in time with date and time attributes in a timezone.
+/// Behaves as tm_makelocal(), but in timezone \p tz rather than in the local timezone.
+/// @param [out] dt Pointer to broken-down time structure
+/// @param [in] tz Timezone
+/// @param [in] year Year
+/// @param [in] month Month
+/// @param [in] day Day of month
+/// @param [in] hour Hour of day
+/// @param [in] min Minutes
+/// @param [in] sec Seconds
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow or invalid arguments)
+/// @remark The instant (point in time) is initialized in the time representation of timezone \p tz.
+tm_status tm_makeintimezone (struct tm *dt, const tm_timezone * tz, int year, tm_month month, int day, int hour, int min,
+                             int sec);
+
+/// Switches representation of instant in time to the local time of a timezone.
+/// @param [in,out] date Pointer to broken-down time structure
+/// @param [in] tz Timezone
+/// @returns TM_OK on success, TM_ERROR otherwise.
+/// @remark Subsequent calculations (tm_adddays(), tm_addmonths(), tm_diffdays(), ...) on \p date apply the rules of timezone \p tz.
+tm_status tm_totimezonerepresentation (struct tm *date, const tm_timezone * tz);
+
+/// Gets the number of transitions in the transition table of a timezone.
+/// @param [in] tz Timezone
+/// @returns Number of transitions, in ascending order of time, up to year 2200 (see tm_loadtimezone())
+size_t tm_getnbtransitions (const tm_timezone * tz);
+
+/// Gets a transition of the transition table of a timezone.
+/// @param [in] tz Timezone
+/// @param [in] index Index of the transition, from 0 to tm_getnbtransitions() - 1
+/// @param [out] transition Transition
+/// @returns \p TM_OK, or \p TM_ERROR if \p index is out of range
+tm_status tm_gettransition (const tm_timezone * tz, size_t index, tm_transition * transition);
+
+/// Gets the first transition of a timezone after an instant.
+/// @param [in] tz Timezone, or 0 for the local timezone
+/// @param [in] instant Instant
+/// @param [out] transition Transition
+/// @returns \p TM_OK, or \p TM_ERROR if there is no known transition after \p instant
+/// @remark Binary search in the transition table, in O(log n).
+tm_status tm_nexttransition (const tm_timezone * tz, tm_instant instant, tm_transition * transition);
+
+/// Gets the last transition of a timezone at or before an instant.
+/// @param [in] tz Timezone, or 0 for the local timezone
+/// @param [in] instant Instant
+/// @param [out] transition Transition
+/// @returns \p TM_OK, or \p TM_ERROR if there is no transition at or before \p instant
+/// @remark Binary search in the transition table, in O(log n).
+tm_status tm_prevtransition (const tm_timezone * tz, tm_instant instant, tm_transition * transition);
+
+///@}
+
 /*****************************************************
 *   CALENDAR PROPERTIES                              *
 *****************************************************/
@@ -596,19 +1402,70 @@ void tm_getintimezone (struct tm date, const char *tz, int *year, tm_month * mon
 /// Indicates leap years.
 /// @param [in] year year
 /// @returns 1 if \p year is a leap year, 0 otherwise
-int tm_isleapyear (int year);
+TM_INLINE int
+tm_isleapyear (int year)
+{
+  // Nonzero if year is a leap year (every 4 years, except every 100th isn't, and every 400th is).
+  return year % 400 == 0 || (year % 4 == 0 && year % 100 != 0);
+}
+
+/// Returns the number of days elapsed since 1970-01-01 at the specified day, month and year of the Gregorian calendar.
+/// @param [in] year Year
+/// @param [in] month Month
+/// @param [in] day Day of month (1 through 31)
+/// @returns Number of days since 1970-01-01 (negative before)
+/// @remark Algorithm from Howard Hinnant, chrono-Compatible Low-Level Date Algorithms.
+TM_INLINE long long
+tm_getdayssinceepoch (int year, tm_month month, int day)
+{
+  long long y = (long long) year - (month <= 2);
+  long long era = (y >= 0 ? y : y - 399) / 400;
+  long long yoe = y - era * 400;        // [0, 399]
+  long long doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;       // [0, 365]
+
+  return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+}
+
+/// Returns the day of week of the specified day, month and year of the Gregorian calendar.
+/// @param [in] year Year
+/// @param [in] month Month
+/// @param [in] day Day of month
+/// @returns Day of week
+TM_INLINE tm_dayofweek
+tm_getdayofweekof (int year, tm_month month, int day)
+{
+  // 1970-01-01 was a Thursday.
+  long long days = tm_getdayssinceepoch (year, month, day);
+
+  return (tm_dayofweek) ((days % 7 + 10) % 7 + 1);
+}
 
 /// Returns the number of weeks in ISO year.
 /// @param [in] isoyear year
 /// @returns The number of weeks in ISO year
-int tm_getweeksinisoyear (int isoyear);
+TM_INLINE int
+tm_getweeksinisoyear (int isoyear)
+{
+  // Years starting on Thursday, and leap years starting on Wednesday, have 53 weeks.
+  tm_dayofweek first = tm_getdayofweekof (isoyear, TM_MONTH_JANUARY, 1);
+
+  return 52 + (first == TM_WEEKDAY_THURSDAY || (first == TM_WEEKDAY_WEDNESDAY && tm_isleapyear (isoyear)));
+}
 
 /// Returns the number of days in the specified month and year.
 /// It interprets month and year as the month and year of the Gregorian calendar, taking leap years into account.
 /// @param [in] year The year specified as a 4-digit number (for example, 1996), interpreted as a year in the Gregorian calendar.
 /// @param [in] month Month
-/// @returns Number of days in month \p month of year \p year
-int tm_getdaysinmonth (int year, tm_month month);
+/// @returns Number of days in month \p month of year \p year, or -1 if \p month is not valid
+TM_INLINE int
+tm_getdaysinmonth (int year, tm_month month)
+{
+  if (month < TM_MONTH_JANUARY || month > TM_MONTH_DECEMBER)
+    return -1;
+
+  // 30 or 31 days, alternating from March to July and from August to January, and February
+  return month == TM_MONTH_FEBRUARY ? 28 + tm_isleapyear (year) : 30 + (int) ((month + (month > TM_MONTH_JULY)) & 1);
+}
 
 /// Returns the number of seconds in the specified day, month and year.
 /// It interprets day, month and year as the day, month and year of the Gregorian calendar, taking leap years and daylight saving time tules into account.
@@ -622,21 +1479,44 @@ int tm_getsecondsinlocalday (int year, tm_month month, int day);
 /// @param [in] year Year
 /// @param [in] month Month
 /// @param [in] dow Day of week
-/// @returns The day of the first weekday in the specified month.
-int tm_getfirstweekdayinmonth (int year, tm_month month, tm_dayofweek dow);
+/// @returns The day of the first weekday in the specified month, or -1 if \p month is not valid
+TM_INLINE int
+tm_getfirstweekdayinmonth (int year, tm_month month, tm_dayofweek dow)
+{
+  if (month < TM_MONTH_JANUARY || month > TM_MONTH_DECEMBER)
+    return -1;
+
+  return ((int) dow - (int) tm_getdayofweekof (year, month, 1) + 7) % 7 + 1;
+}
 
 /// Returns the day of the last weekday in the specified month.
 /// @param [in] year Year
 /// @param [in] month Month
 /// @param [in] dow Day of week
-/// @returns The day of the last weekday in the specified month.
-int tm_getlastweekdayinmonth (int year, tm_month month, tm_dayofweek dow);
+/// @returns The day of the last weekday in the specified month, or -1 if \p month is not valid
+TM_INLINE int
+tm_getlastweekdayinmonth (int year, tm_month month, tm_dayofweek dow)
+{
+  int last = tm_getdaysinmonth (year, month);
+
+  if (last < 0)
+    return -1;
+
+  int diff = (int) dow - (int) tm_getdayofweekof (year, month, last);
+
+  return last + diff + (diff > 0 ? -7 : 0);
+}
 
 /// Returns the day of the first weekday in the specified ISO-year.
 /// @param [in] isoyear year
 /// @param [in] dow Day of week
-/// @returns The day of the first weekday in the specified month.
-int tm_getfirstweekdayinisoyear (int isoyear, tm_dayofweek dow);
+/// @returns The day of January of the first weekday in the specified ISO-year (0 or less for days of December of the previous year.)
+TM_INLINE int
+tm_getfirstweekdayinisoyear (int isoyear, tm_dayofweek dow)
+{
+  // The first week of an ISO-year is the week with January the 4th.
+  return 4 - (int) tm_getdayofweekof (isoyear, TM_MONTH_JANUARY, 4) + (int) dow;
+}
 
 ///@}
 
@@ -653,6 +1533,10 @@ int tm_getfirstweekdayinisoyear (int isoyear, tm_dayofweek dow);
 /// @returns Binary representation of instant (point in time).
 time_t tm_tobinary (struct tm date);
 
+/// Same as tm_tobinary(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure
+time_t tm_tobinary_p (const struct tm *date);
+
 /// Deserializes a binary value and recreates an original serialized date and time.
 /// @param [out] date Pointer to broken-down time structure, in local timezone representation
 /// @param [in] binary representation of instant (point in time).
@@ -660,6 +1544,361 @@ time_t tm_tobinary (struct tm date);
 /// @remark The instant (point in time) is presented in local time representation by default.
 tm_status tm_frombinary (struct tm *date, time_t binary);
 
+/// Serializes an array of instants of time to binary values (see tm_tobinary()).
+/// @param [out] out Array of \p n binary representations of instants, (time_t)-1 for instants that could not be converted
+/// @param [in] in Array of \p n broken-down time structures, either in local timezone or UTC representation
+/// @param [in] n Number of instants
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR (overflow) for each instant, or 0
+/// @returns TM_OK if all instants were converted, TM_ERROR otherwise.
+/// @remark The rules of the local timezone are looked up once for the whole array,
+/// and the interval between transitions of an instant is reused for the following ones: conversion is faster on sorted arrays.
+tm_status tm_tobinary_n (time_t *out, const struct tm *in, size_t n, tm_status *status);
+
+/// Deserializes an array of binary values and recreates the original serialized dates and times (see tm_frombinary()).
+/// @param [out] out Array of \p n broken-down time structures
+/// @param [in] in Array of \p n binary representations of instants
+/// @param [in] n Number of instants
+/// @param [in] representation Representation of the broken-down time structures
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR (overflow) for each instant, or 0
+/// @returns TM_OK if all instants were converted, TM_ERROR otherwise.
+/// @remark The rules of the local timezone are looked up once for the whole array,
+/// and the interval between transitions and the date of an instant are reused for the following ones: conversion is faster on sorted arrays.
+tm_status tm_frombinary_n (struct tm *out, const time_t *in, size_t n, tm_representation representation, tm_status *status);
+
+/// Truncates an array of instants to the beginning of their buckets (minutes, hours, days, weeks, months...), for aggregation.
+/// @param [out] out Array of \p n calendar times of the beginning of the buckets of \p in, (time_t)-1 for instants that could not be truncated
+/// @param [in] in Array of \p n calendar times
+/// @param [in] n Number of instants
+/// @param [in] unit Unit of buckets
+/// @param [in] size Number of minutes (1 through 1440) or hours (1 through 24) of buckets, aligned on midnight; 1 for other units
+/// @param [in] representation Representation (UTC or local time) of the dates and times buckets are aligned on
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR (overflow) for each instant, or 0
+/// @returns TM_OK if all instants were truncated, TM_ERROR otherwise (or if \p unit or \p size are invalid, errno is then set to EINVAL).
+/// @remark In local time, days, weeks, months, quarters and years start at the first instant of their first day
+/// (local midnight, or the end of the gap if midnight is skipped), and last 23 or 25 hours more or less at DST cutovers.
+/// Minutes and hours keep the UTC offset of the instant: an hour repeated by a backward transition is a bucket of its own.
+/// Buckets of minutes or hours that straddle a change of UTC offset (widths that do not divide an hour, such as 7 minutes,
+/// or of several hours) are split at the change: the part after the change starts at the transition.
+/// @remark As tm_frombinary_n(), local times are computed by blocks from the intervals between transitions of the local timezone,
+/// then truncated all at once by branch-free calendar kernels: truncation is faster on sorted arrays.
+/// Equal outputs denote the same bucket: outputs can be used as keys of aggregation.
+tm_status tm_bucket_n (time_t *out, const time_t *in, size_t n, tm_bucketunit unit, int size, tm_representation representation,
+                       tm_status *status);
+
+/// Serializes an instant of time and its representation to a 16-byte record.
+/// Unlike tm_tobinary(), the representation (UTC, local time or another timezone) and the UTC offset are kept:
+/// - bytes 0 to 7: calendar time, big-endian, with sign bit flipped;
+/// - bytes 8 to 10: UTC offset, in seconds, big-endian, biased by 2^23;
+/// - byte 11: flags, 1 for local time representation, 2 for daylight saving time;
+/// - bytes 12 to 15: identifier of the timezone, big-endian (a hash of its canonical name, 0 for UTC).
+///
+/// The canonical name of a timezone of the timezone database is its path relative to the database, symbolic links resolved,
+/// whatever its spelling: "Europe/Paris", ":Europe/Paris", "/usr/share/zoneinfo/Europe/Paris", or an unset TZ with /etc/localtime linked to it.
+/// POSIX TZ strings are their own canonical name.
+/// @param [in] date Pointer to broken-down time structure
+/// @param [out] record Record
+/// @returns TM_OK on sucess, TM_ERROR otherwise (overflow, or timezone without canonical name, such as a copy of a zone out of
+/// the timezone database, errno is then set to EINVAL).
+/// @remark Records compared with memcmp() sort as their instants (and, for the same instant, as their UTC offsets).
+tm_status tm_torecord (const struct tm *date, tm_record *record);
+
+/// Deserializes a record and recreates the original serialized date and time, in its original representation (see tm_torecord()).
+/// @param [out] date Pointer to broken-down time structure
+/// @param [in] record Record
+/// @returns TM_OK on sucess, TM_ERROR otherwise (invalid record, UTC offset unknown to the timezone, overflow,
+/// or timezone not loaded, errno is then set to ENOENT).
+/// @remark Dates are rebuilt from the calendar time and the UTC offset of the record, without looking up the rules of the timezone.
+/// Timezones other than the local timezone must have been loaded by tm_loadtimezone() beforehand, under any spelling.
+/// A record is never decoded in another timezone than its own.
+tm_status tm_fromrecord (struct tm *date, const tm_record *record);
+
+/// Serializes an array of instants of time to records (see tm_torecord()).
+/// @param [out] out Array of \p n records, zeroed for instants that could not be converted
+/// @param [in] in Array of \p n broken-down time structures
+/// @param [in] n Number of instants
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR for each instant, or 0
+/// @returns TM_OK if all instants were converted, TM_ERROR otherwise.
+/// @remark As tm_tobinary_n(), the interval between transitions of an instant is reused for the following ones.
+tm_status tm_torecord_n (tm_record *out, const struct tm *in, size_t n, tm_status *status);
+
+/// Deserializes an array of records (see tm_fromrecord()).
+/// @param [out] out Array of \p n broken-down time structures
+/// @param [in] in Array of \p n records
+/// @param [in] n Number of records
+/// @param [out] status Array of \p n status, \p TM_OK or \p TM_ERROR for each record, or 0
+/// @returns TM_OK if all records were converted, TM_ERROR otherwise.
+tm_status tm_fromrecord_n (struct tm *out, const tm_record *in, size_t n, tm_status *status);
+
+///@}
+
+///@name Compressed columns of calendar times
+/// Long and mostly regular series of calendar times (such as time stamps of samples, see tm_tobinary())
+/// are compressed by delta-of-delta encoding: regular values cost nothing but runs, jitter about a byte per value.
+///@verbatim
+/// tm_timeencoder enc;
+///
+/// tm_timeencoder_init (&enc, 0);
+/// tm_timeencoder_put_n (&enc, times, n);
+/// tm_timeencoder_flush (&enc);
+/// ... enc.data, enc.size ...
+/// tm_timeencoder_free (&enc);
+///
+/// tm_timedecoder dec;
+///
+/// for (tm_timedecoder_init (&dec, data, size); tm_timedecoder_next (&dec);)
+///   ... dec.current ...
+///@endverbatim
+/// Columns are sequences of blocks of \p blocksize values, each with a 16-byte header
+/// (little-endian 32-bit size of the block without header, 32-bit number of values and 64-bit first value)
+/// followed by LEB128 varints of the zig-zag encoded differences of consecutive differences, or of runs of zeros.
+/// Blocks are independent: headers give direct access to every \p blocksize-th value.
+///@{
+
+/// Initializes an encoder of a column of calendar times.
+/// @param [out] enc Encoder
+/// @param [in] blocksize Number of values per block (1 through 65536), 0 for 1024
+void tm_timeencoder_init (tm_timeencoder * enc, size_t blocksize);
+
+/// Appends a calendar time to an encoded column.
+/// @param [in,out] enc Encoder
+/// @param [in] t Calendar time
+/// @returns \p TM_OK, or \p TM_ERROR if out of memory
+tm_status tm_timeencoder_put (tm_timeencoder * enc, time_t t);
+
+/// Appends an array of calendar times to an encoded column.
+/// @param [in,out] enc Encoder
+/// @param [in] in Array of \p n calendar times, sorted for best compression (any sequence can be encoded though)
+/// @param [in] n Number of calendar times
+/// @returns \p TM_OK, or \p TM_ERROR if out of memory
+tm_status tm_timeencoder_put_n (tm_timeencoder * enc, const time_t *in, size_t n);
+
+/// Completes an encoded column: \p enc->data and \p enc->size are then the column of all the values appended so far.
+/// Values can still be appended afterwards.
+/// @param [in,out] enc Encoder
+/// @returns \p TM_OK, or \p TM_ERROR if out of memory
+tm_status tm_timeencoder_flush (tm_timeencoder * enc);
+
+/// Releases an encoded column.
+/// @param [in,out] enc Encoder
+void tm_timeencoder_free (tm_timeencoder * enc);
+
+/// Initializes a decoder of a column of calendar times.
+/// @param [out] dec Decoder
+/// @param [in] data Encoded column, not modified while decoded
+/// @param [in] size Size of the encoded column, in bytes
+void tm_timedecoder_init (tm_timedecoder * dec, const unsigned char *data, size_t size);
+
+/// Moves a decoder to the next value of its column.
+/// The first call moves it to the first value.
+/// @param [in,out] dec Decoder
+/// @returns 1 if \p dec->current is the next value, 0 at the end of the column (or if the column is corrupted, errno is then set to EINVAL)
+int tm_timedecoder_next (tm_timedecoder * dec);
+
+/// Decodes the next values of a column.
+/// @param [in,out] dec Decoder
+/// @param [out] out Array of \p n calendar times
+/// @param [in] n Number of values to decode
+/// @returns Number of values decoded, less than \p n at the end of the column
+/// @remark Runs of regular values are expanded at once.
+size_t tm_timedecoder_next_n (tm_timedecoder * dec, time_t *out, size_t n);
+
+/// Moves a decoder to a value of its column: \p dec->current is then the value at \p index,
+/// and tm_timedecoder_next() moves to the following one.
+/// @param [in,out] dec Decoder
+/// @param [in] index Index of the value in the column
+/// @returns \p TM_OK, or \p TM_ERROR if \p index is out of the column (errno is then set to EINVAL)
+/// @remark Block headers are skipped over, then at most \p blocksize values are decoded.
+tm_status tm_timedecoder_seek (tm_timedecoder * dec, size_t index);
+
+///@}
+
+///@name Column files of instants
+/// Column files hold calendar times, as written by tm_column_write(), and are read in place, without loading or copying:
+/// the instants of an opened column are passed as is to tm_frombinary_n(), tm_bucket_n() or tm_index_build()...
+/// Those functions break instants down in local time in the local timezone of the reader, not in the timezone the column was written in:
+/// below, days are local days only if both timezones are the same, UTC days otherwise.
+///@verbatim
+/// tm_column *col = tm_column_open ("events.tmcol");
+/// tm_representation representation = tm_column_timezone (col) == tm_getlocaltimezone () ? TM_REP_LOCAL : TM_REP_UTC;
+/// const time_t *values;
+/// size_t n;
+///
+/// for (size_t block = 0; tm_column_scan (col, from, to, &block, &values, &n); block++)
+///   tm_bucket_n (keys, values, n, TM_BUCKET_DAY, 1, representation, 0);
+/// tm_column_close (col);
+///@endverbatim
+/// Files start with a 64-byte header (magic number "TMCOLv1\n", byte order mark, number of instants, number of blocks,
+/// number of instants per block and identifier of the timezone of the representation), followed by the zone map
+/// (minimum and maximum of each block, as 64-bit integers) and by the instants, as 64-bit integers.
+/// Integers are in the byte order of the host that wrote the file.
+///@{
+
+/// Writes a column file of instants.
+/// @param [in] path Path of the file, replaced once the new file is written entirely (columns still open keep the former file)
+/// @param [in] times Array of \p n calendar times, in any order (sorted arrays make the zone map most selective)
+/// @param [in] n Number of calendar times
+/// @param [in] representation Representation of the instants, UTC or the local timezone
+/// @param [in] blocksize Number of instants per block of the zone map, 0 for 4096
+/// @returns \p TM_OK, or \p TM_ERROR (out of memory, input/output error, or local timezone without canonical name (see tm_torecord()),
+/// errno is then set to EINVAL)
+tm_status tm_column_write (const char *path, const time_t *times, size_t n, tm_representation representation, size_t blocksize);
+
+/// Opens a column file of instants, mapped in memory read-only.
+/// @param [in] path Path of the file
+/// @returns Column, to be closed by tm_column_close(), or 0 on error (errno is set to EINVAL if the file is not a valid column file of this host)
+tm_column *tm_column_open (const char *path);
+
+/// Gets the number of instants of a column.
+/// @param [in] col Column
+/// @returns Number of instants
+size_t tm_column_size (const tm_column * col);
+
+/// Gets the instants of a column.
+/// @param [in] col Column
+/// @returns Array of tm_column_size() calendar times, mapped in memory, valid until the column is closed
+const time_t *tm_column_values (const tm_column * col);
+
+/// Gets the representation of the instants of a column.
+/// @param [in] col Column
+/// @returns \p TM_REP_UTC or \p TM_REP_LOCAL
+tm_representation tm_column_representation (const tm_column * col);
+
+/// Gets the timezone of the instants of a column in local time representation.
+/// @param [in] col Column
+/// @returns Timezone the column was written in, if it is the local timezone or if it was loaded by tm_loadtimezone() under any spelling,
+/// 0 otherwise (or for UTC)
+const tm_timezone *tm_column_timezone (const tm_column * col);
+
+/// Finds the next block of a column that may hold instants in a range.
+/// @param [in] col Column
+/// @param [in] from Beginning of the range
+/// @param [in] to End of the range (excluded)
+/// @param [in,out] block Block to start from, set to the block found
+/// @param [out] values Instants of the block found, mapped in memory
+/// @param [out] n Number of instants of the block found
+/// @returns 1 if a block was found, 0 otherwise
+/// @remark Blocks whose minimum and maximum do not meet [\p from, \p to) are skipped without reading their instants.
+/// Instants of the block found may still be out of the range.
+int tm_column_scan (const tm_column * col, time_t from, time_t to, size_t *block, const time_t **values, size_t *n);
+
+/// Closes a column file of instants.
+/// @param [in] col Column, or 0
+void tm_column_close (tm_column * col);
+
+///@}
+
+/*****************************************************
+*   INSTANTS                                         *
+*****************************************************/
+///@name Instants
+/// Instants of type \p tm_instant do not carry any representation: they are always relative to UTC.
+/// They can be copied, compared and subtracted at the cost of a 64-bit integer.
+///@{
+
+/// Initializes an instant in time from a calendar time and a number of nanoseconds.
+/// @param [out] instant Pointer to instant
+/// @param [in] seconds Calendar time, in seconds since 1970-01-01 00:00:00 UTC
+/// @param [in] nanoseconds Nanoseconds added to \p seconds (may be negative or exceed one second)
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
+tm_status tm_makeinstant (tm_instant *instant, time_t seconds, long int nanoseconds);
+
+/// Initializes an instant in time with current date and time, at the resolution of the system real time clock.
+/// @param [out] instant Pointer to instant
+/// @returns \p TM_OK or \p TM_ERROR
+tm_status tm_makeinstantnow (tm_instant *instant);
+
+/// Converts a broken-down time structure into an instant in time.
+/// @param [in] date Broken-down time structure, either in local timezone or UTC representation
+/// @param [out] instant Pointer to instant
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
+tm_status tm_toinstant (struct tm date, tm_instant *instant);
+
+/// Same as tm_toinstant(), without copying the broken-down time structure.
+/// @param [in] date Pointer to broken-down time structure, either in local timezone or UTC representation
+/// @param [out] instant Instant
+tm_status tm_toinstant_p (const struct tm *date, tm_instant * instant);
+
+/// Converts an instant in time into a broken-down time structure.
+/// @param [out] date Pointer to broken-down time structure
+/// @param [in] instant Instant in time
+/// @param [in] representation Representation of the broken-down time structure
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow)
+/// @remark The fraction of second is truncated (towards the past). It can be retrieved with tm_getinstantnanoseconds().
+tm_status tm_frominstant (struct tm *date, tm_instant instant, tm_representation representation);
+
+/// Gets the calendar time of an instant in time.
+/// @param [in] instant Instant in time
+/// @returns Calendar time, in seconds since 1970-01-01 00:00:00 UTC, truncated towards the past
+time_t tm_getinstantseconds (tm_instant instant);
+
+/// Gets the fraction of second of an instant in time.
+/// @param [in] instant Instant in time
+/// @returns Nanoseconds elapsed since tm_getinstantseconds() (0 through 999999999)
+long int tm_getinstantnanoseconds (tm_instant instant);
+
+/// Adds seconds to an instant in time.
+/// @param [in,out] instant Pointer to instant
+/// @param [in] nbSecs Number of seconds to add (or substract if negative)
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow, \p instant is then unchanged)
+tm_status tm_instantaddseconds (tm_instant *instant, long long int nbSecs);
+
+/// Adds nanoseconds to an instant in time.
+/// @param [in,out] instant Pointer to instant
+/// @param [in] nbNanosecs Number of nanoseconds to add (or substract if negative)
+/// @returns \p TM_OK or \p TM_ERROR (in case of overflow, \p instant is then unchanged)
+tm_status tm_instantaddnanoseconds (tm_instant *instant, long long int nbNanosecs);
+
+/// Computes the number of nanoseconds between two instants in time.
+/// @param [in] debut Instant in time
+/// @param [in] fin Instant in time
+/// @returns Number of nanoseconds between \p debut and \p fin
+/// @remark In case of overflow (instants more than 292 years apart), errno is set to ERANGE and the result is saturated.
+int64_t tm_instantdiffnanoseconds (tm_instant debut, tm_instant fin);
+
+/// Computes the number of complete seconds between two instants in time.
+/// @param [in] debut Instant in time
+/// @param [in] fin Instant in time
+/// @returns Number of seconds between \p debut and \p fin
+long int tm_instantdiffseconds (tm_instant debut, tm_instant fin);
+
+/// Compares two instants in time.
+/// @param [in] debut Pointer to instant
+/// @param [in] fin Pointer to instant
+/// @returns -1, 0 or 1 if \p debut is respectively before, equal or after \p fin.
+/// @remark Can be used with qsort() or bsearch() on arrays of \p tm_instant.
+int tm_instantcompare (const void *debut, const void *fin);
+
+/// Parses an ISO 8601 (or RFC 3339) date and time into an instant in time.
+/// Recognized formats are a date, optionally followed by a time of day separated by 'T' (or a space), optionally followed by an offset to UTC:
+/// - date: calendar date (YYYY-MM-DD), ordinal date (YYYY-DDD) or week date (YYYY-Www-D or YYYY-Www);
+/// - time: hh:mm:ss, hh:mm or hh, with an optional decimal fraction of second (.s to .sssssssss, or comma);
+/// - offset: Z, +hh:mm, -hh:mm or +hh, -hh (and +hh:mm:ss, -hh:mm:ss, as written by tm_getinstantiso8601intostring() for local mean time).
+///
+/// Basic formats (without separators, such as 20160327T021221.5+0100) are recognized as well.
+/// @param [in] str String, not necessarily null terminated
+/// @param [in] len Length of \p str
+/// @param [out] instant Pointer to instant
+/// @param [out] utcoffset Offset to UTC of the string, in seconds, or 0. It is the offset of the local timezone if the string has none.
+/// @returns \p TM_OK or \p TM_ERROR (invalid string or overflow)
+/// @remark Dates and times without offset to UTC are local.
+/// Leap seconds (ss = 60) are counted as the first second of the next minute, and 24:00:00 as the beginning of the next day.
+/// Parsing is independent of the locale.
+tm_status tm_parseiso8601 (const char *str, size_t len, tm_instant *instant, long int *utcoffset);
+
+/// Formats an instant in time into an ISO 8601 / RFC 3339 string (YYYY-MM-DDThh:mm:ss.fffffffffZ in UTC, YYYY-MM-DDThh:mm:ss.fffffffff±hh:mm in local time)
+/// and places the result in the character array \p str of size \p max. \p str should have been previously allocated elsewhere.
+/// @param [in] instant Instant in time
+/// @param [in] representation Representation of the instant, UTC or local time
+/// @param [in] digits Number of digits of the fraction of second (0 through 9), 0 for none
+/// @param [in] max Size of the previously allocated string \p str (TM_ISO8601MAXLENGTH is always enough)
+/// @param [out] str null terminated string
+/// @param [out] length Length of the string \p str, without the terminating null byte, or 0
+/// @returns \p TM_OK if the result string, including the terminating null byte, does not exceed \p max bytes,
+///          \p TM_ERROR otherwise (and the contents of the string \p str are then unchanged.)
+/// @remark The fraction of second is truncated, not rounded. Independent of the locale.
+tm_status tm_getinstantiso8601intostring (tm_instant instant, tm_representation representation, int digits, char *str,
+                                          size_t max, size_t *length);
+
 ///@}
 
 #endif
@@ -0,0 +1,135 @@
+#define _GNU_SOURCE
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dates.h"
+
+/****************************************************/
+// Micro-benchmarks of the batch and pointer functions, against the per-date and libc paths they replace.
+// Build and run with 'make bench'. Timings are in nanoseconds per date (or per query), for the local timezone Europe/Paris.
+
+enum
+{ N = 1000000 };
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+bench_print (const char *label, double start, size_t n, long long checksum)
+{
+  // The checksum keeps the compiler from optimizing the measured loops away.
+  printf ("%-48s %8.1f ns   (%lld)\n", label, (bench_now () - start) / n, checksum);
+}
+
+int
+main (void)
+{
+  setenv ("TZ", "Europe/Paris", 1);
+  tzset ();
+
+  struct tm *dates = malloc (N * sizeof (*dates));
+  time_t *binaries = malloc (N * sizeof (*binaries));
+  time_t *keys = malloc (N * sizeof (*keys));
+
+  if (!dates || !binaries || !keys)
+    return EXIT_FAILURE;
+
+  // Sorted local instants over a year, about 31 seconds apart, and their broken-down times.
+  for (size_t i = 0; i < N; i++)
+    binaries[i] = 1451606400 + (time_t) i * 31;
+  if (tm_frombinary_n (dates, binaries, N, TM_REP_LOCAL, 0) != TM_OK)
+    return EXIT_FAILURE;
+
+  double start;
+  long long checksum;
+
+  printf ("%zu local dates, Europe/Paris:\n", (size_t) N);
+
+  start = bench_now ();
+  checksum = 0;
+  for (size_t i = 0; i < N; i++)
+    checksum += tm_getyear (dates[i]) + tm_getisoweek (dates[i]) + tm_getdayofweek (dates[i]);
+  bench_print ("year + ISO week + weekday", start, N, checksum);
+
+  start = bench_now ();
+  checksum = 0;
+  for (size_t i = 0; i < N; i++)
+    checksum += tm_getyear_p (&dates[i]) + tm_getisoweek_p (&dates[i]) + tm_getdayofweek_p (&dates[i]);
+  bench_print ("year + ISO week + weekday (_p)", start, N, checksum);
+
+  start = bench_now ();
+  checksum = 0;
+  for (size_t i = 1; i < N; i++)
+  {
+    struct tm debut = dates[i - 1], fin = dates[i];
+
+    checksum += mktime (&fin) - mktime (&debut);
+  }
+  bench_print ("mktime() on copies", start, N - 1, checksum);
+
+  start = bench_now ();
+  checksum = 0;
+  for (size_t i = 1; i < N; i++)
+    checksum += tm_diffseconds_p (&dates[i - 1], &dates[i]);
+  bench_print ("tm_diffseconds_p", start, N - 1, checksum);
+
+  start = bench_now ();
+  checksum = 0;
+  for (size_t i = 0; i < N; i++)
+    checksum += tm_tobinary_p (&dates[i]);
+  bench_print ("tm_tobinary_p", start, N, checksum);
+
+  start = bench_now ();
+  tm_tobinary_n (keys, dates, N, 0);
+  bench_print ("tm_tobinary_n", start, N, keys[N - 1]);
+
+  start = bench_now ();
+  for (size_t i = 0; i < N; i++)
+    tm_frombinary (&dates[i], binaries[i]);
+  bench_print ("tm_frombinary", start, N, dates[N - 1].tm_yday);
+
+  start = bench_now ();
+  tm_frombinary_n (dates, binaries, N, TM_REP_LOCAL, 0);
+  bench_print ("tm_frombinary_n", start, N, dates[N - 1].tm_yday);
+
+  start = bench_now ();
+  tm_bucket_n (keys, binaries, N, TM_BUCKET_DAY, 1, TM_REP_LOCAL, 0);
+  bench_print ("tm_bucket_n, days", start, N, keys[N - 1]);
+
+  start = bench_now ();
+  tm_bucket_n (keys, binaries, N, TM_BUCKET_MONTH, 1, TM_REP_LOCAL, 0);
+  bench_print ("tm_bucket_n, months", start, N, keys[N - 1]);
+
+  start = bench_now ();
+  tm_index *index = tm_index_build (dates, N, TM_REP_LOCAL);
+  bench_print ("tm_index_build", start, N, index != 0);
+
+  if (index)
+  {
+    start = bench_now ();
+    checksum = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+      size_t rank = 0;
+
+      tm_index_lowerbound (index, &dates[(i * 7919) % N], &rank);
+      checksum += (long long) rank;
+    }
+    bench_print ("tm_index_lowerbound (per query)", start, N, checksum);
+    tm_index_free (index);
+  }
+
+  free (keys);
+  free (binaries);
+  free (dates);
+
+  return EXIT_SUCCESS;
+}
@@ -7,8 +7,12 @@
 #include <stdio.h>
 #include <time.h>
 #include <limits.h>
+#include <stdint.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
 #include "dates.h"
 
 /*************** INITIALISATION *************************/
@@ -180,6 +184,42 @@ START_TEST (tu_utc)
   ck_assert (tm_getrepresentation (dt) == TM_REP_UTC);
 }
 
+END_TEST
+START_TEST (tu_utc_normalization)
+{
+  struct tm dt;
+
+  ck_assert (tm_makeutc (&dt, 2016, TM_MONTH_JANUARY, 1, 18, 0, 0) == TM_OK);
+  ck_assert (tm_tobinary (dt) == 1451671200);
+  ck_assert (tm_getdayofweek (dt) == TM_WEEKDAY_FRIDAY);
+  ck_assert (tm_makeutc (&dt, 1900, TM_MONTH_MARCH, 1, 0, 0, 0) == TM_OK);
+  ck_assert (tm_tobinary (dt) == -2203891200);
+  ck_assert (tm_makeutc (&dt, 2000, TM_MONTH_FEBRUARY, 29, 23, 59, 59) == TM_OK);
+  ck_assert (tm_getdayofyear (dt) == 60);
+
+  // 40 October is changed into 9 November
+  ck_assert (tm_makeutc (&dt, 2016, TM_MONTH_OCTOBER, 1, 12, 0, 0) == TM_OK);
+  ck_assert (tm_adddays (&dt, 39) == TM_OK);
+  ck_assert (tm_getmonth (dt) == TM_MONTH_NOVEMBER && tm_getday (dt) == 9 && tm_gethour (dt) == 12);
+  ck_assert (tm_addmonths (&dt, -23) == TM_OK);
+  ck_assert (tm_getyear (dt) == 2014 && tm_getmonth (dt) == TM_MONTH_DECEMBER && tm_getday (dt) == 9);
+  ck_assert (tm_addseconds (&dt, -(343 * 24 + 12) * 3600L - 1) == TM_OK);
+  ck_assert (tm_getyear (dt) == 2013 && tm_getmonth (dt) == TM_MONTH_DECEMBER && tm_getday (dt) == 30);
+  ck_assert (tm_gethour (dt) == 23 && tm_getminute (dt) == 59 && tm_getsecond (dt) == 59);
+  ck_assert (tm_isutcrepresentation (dt) && !tm_isdaylightsavingtime (dt));
+
+  for (time_t t = -4000000000L; t < 4000000000L; t += 86400 * 97 + 3607)
+  {
+    struct tm ref;
+
+    ck_assert (gmtime_r (&t, &ref));
+    ck_assert (tm_makeutc (&dt, tm_getyear (ref), tm_getmonth (ref), tm_getday (ref), 0, 0, 0) == TM_OK);
+    ck_assert (tm_addseconds (&dt, tm_gethour (ref) * 3600 + tm_getminute (ref) * 60 + tm_getsecond (ref)) == TM_OK);
+    ck_assert (tm_tobinary (dt) == t);
+    ck_assert (dt.tm_wday == ref.tm_wday && dt.tm_yday == ref.tm_yday);
+  }
+}
+
 END_TEST
 START_TEST (tu_set_from_local)
 {
@@ -729,6 +769,160 @@ START_TEST (tu_change_timezone)
     unsetenv ("TZ");
 }
 
+END_TEST
+START_TEST (tu_timezone_rules)
+{
+  const char *tz = getenv ("TZ");
+  const char *zones[] = { "Europe/Paris", "Australia/Lord_Howe", "America/Sao_Paulo", "CET-1CEST,M3.5.0,M10.5.0/3",
+    "<+0330>-3:30", ":America/New_York"
+  };
+
+  for (size_t z = 0; z < sizeof (zones) / sizeof (*zones); z++)
+  {
+    setenv ("TZ", zones[z], 1);
+    tzset ();
+
+    // Compiled rules agree with localtime_r() and mktime(), from 1901 to 2300.
+    for (time_t t = -2147483647L; t < 10413792000L; t += 86400 * 13 + 3607)
+    {
+      struct tm date, ref;
+
+      ck_assert (tm_frombinary (&date, t) == TM_OK);
+      ck_assert (localtime_r (&t, &ref));
+      ck_assert (date.tm_year == ref.tm_year && date.tm_yday == ref.tm_yday && date.tm_hour == ref.tm_hour
+                 && date.tm_min == ref.tm_min && date.tm_sec == ref.tm_sec && date.tm_wday == ref.tm_wday);
+      ck_assert (date.tm_isdst == ref.tm_isdst && date.tm_gmtoff == ref.tm_gmtoff && !strcmp (date.tm_zone, ref.tm_zone));
+      ck_assert (tm_tobinary (date) == t);
+    }
+  }
+
+  // Same rules, whether compiled from the timezone database or from a POSIX TZ string
+  setenv ("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  struct tm dt;
+
+  ck_assert (tm_makelocal (&dt, 2016, TM_MONTH_MARCH, 27, 2, 12, 21) == TM_ERROR);        // Does not exist (DST change)
+  ck_assert (tm_makelocal (&dt, 2016, TM_MONTH_MARCH, 26, 2, 12, 21) == TM_OK);
+  ck_assert (tm_adddays (&dt, 1) == TM_OK);
+  ck_assert (tm_getday (dt) == 27 && tm_gethour (dt) == 3);
+  ck_assert (tm_getsecondsinlocalday (2016, 10, 30) == 25 * 3600);
+
+  if (tz)
+    setenv ("TZ", tz, 1);
+  else
+    unsetenv ("TZ");
+}
+
+END_TEST
+static void *
+tu_timezone_thread (void *arg)
+{
+  const char *zones[] = { "Australia/Adelaide", "America/Los_Angeles", "Europe/Paris", "Asia/Kolkata" };
+  long ok = 1;
+
+  for (long i = 0; i < 1000 && ok; i++)
+  {
+    const tm_timezone *tz = tm_loadtimezone (zones[(i + (long) arg) % 4]);
+    struct tm date;
+    long offset = 0;
+
+    // A week later, same local time: the UTC hour shifts by the change of UTC offset (DST starts in Paris on 2010-03-28).
+    ok = tz && tm_makeutc (&date, 2010, TM_MONTH_MARCH, 21, 16, 0, 0) == TM_OK
+      && tm_totimezonerepresentation (&date, tz) == TM_OK && tm_gettimezoneof (date) == tz
+      && (offset = tm_getutcoffset (date)) && tm_adddays (&date, 7) == TM_OK
+      && (offset -= tm_getutcoffset (date)) == (strcmp (tm_gettimezonename (tz), "Europe/Paris") ? 0 : -3600)
+      && tm_toutcrepresentation (&date) == TM_OK && tm_getday (date) == 28 && tm_gethour (date) == 16 + offset / 3600;
+  }
+
+  return (void *) ok;
+}
+
+START_TEST (tu_timezone_handle)
+{
+  const tm_timezone *paris = tm_loadtimezone ("Europe/Paris");
+  const tm_timezone *adelaide = tm_loadtimezone ("Australia/Adelaide");
+
+  ck_assert (paris && adelaide);
+  ck_assert (tm_loadtimezone ("Europe/Paris") == paris);
+  ck_assert (tm_loadtimezone ("Nowhere/Unknown") == 0);
+  ck_assert (strcmp (tm_gettimezonename (paris), "Europe/Paris") == 0);
+
+  // TZif files with crafted counts (negative, or overflowing the size of the data) are rejected.
+  // Counts: isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt.
+  static const uint32_t counts[][6] = {
+    {0, 0, 0, 0xFFFFFFFF, 1, 6},        // -5 bytes of transitions, +6 bytes of abbreviations: 7 bytes, if counts were signed
+    {0, 0, 0xFFFFFFFF, 0, 1, 14},
+    {0, 0, 0, 0x80000000, 1, 1},
+    {0, 0, 0, 0x33333334, 1, 1},        // 5 * 0x33333334 wraps on 32 bits
+    {0xFFFFFFFF, 0, 0, 0, 1, 1},
+    {0, 0, 0, 0, 0xFFFFFFFF, 1},
+    {0, 0, 0, 0, 1, 0xFFFFFFFF},
+  };
+
+  for (size_t i = 0; i < sizeof (counts) / sizeof (*counts); i++)
+  {
+    unsigned char tzif[44 + 64] = { 'T', 'Z', 'i', 'f' };
+    char cwd[2048], path[4096];
+    FILE *f;
+
+    for (int c = 0; c < 6; c++)
+      for (int b = 0; b < 4; b++)
+        tzif[20 + 4 * c + b] = (unsigned char) (counts[i][c] >> (24 - 8 * b));
+    ck_assert (getcwd (cwd, sizeof (cwd)));
+    snprintf (path, sizeof (path), "%s/dates_tu_check.tzif%zu", cwd, i);
+    ck_assert ((f = fopen (path, "wb")) && fwrite (tzif, sizeof (tzif), 1, f) == 1 && fclose (f) == 0);
+    ck_assert (tm_loadtimezone (path) == 0);
+    ck_assert (unlink (path) == 0);
+  }
+
+  const char *tz = getenv ("TZ");
+
+  setenv ("TZ", "America/New_York", 1);
+
+  // Moon walk in NYC: 1969-07-20 22:56:00 -04:00, in Paris: 1969-07-21 03:56:00 +01:00
+  struct tm date, paris_date;
+
+  ck_assert (tm_makelocal (&date, 1969, TM_MONTH_JULY, 20, 22, 56, 0) == TM_OK);
+  paris_date = date;
+  ck_assert (tm_totimezonerepresentation (&paris_date, paris) == TM_OK);
+  ck_assert (tm_gettimezoneof (paris_date) == paris);
+  ck_assert (tm_islocalrepresentation (paris_date));
+  ck_assert (tm_getday (paris_date) == 21 && tm_gethour (paris_date) == 3 && tm_getminute (paris_date) == 56);
+  ck_assert (tm_getutcoffset (paris_date) == 3600);
+  ck_assert (tm_diffseconds (date, paris_date) == 0);
+
+  // Calculations apply the rules of the timezone of the instant.
+  ck_assert (tm_makeintimezone (&date, paris, 2016, TM_MONTH_MARCH, 27, 2, 12, 21) == TM_ERROR);        // DST change in Paris
+  ck_assert (tm_makeintimezone (&date, paris, 2016, TM_MONTH_MARCH, 26, 2, 12, 21) == TM_OK);
+  ck_assert (tm_adddays (&date, 1) == TM_OK);
+  ck_assert (tm_gettimezoneof (date) == paris && tm_getday (date) == 27 && tm_gethour (date) == 3);
+
+  ck_assert (tm_makeintimezone (&date, adelaide, 2016, TM_MONTH_APRIL, 2, 12, 0, 0) == TM_OK);
+  ck_assert (tm_addseconds (&date, 24 * 3600) == TM_OK);        // DST ends on april, the 3rd, at 3am
+  ck_assert (tm_getday (date) == 3 && tm_gethour (date) == 11);
+  ck_assert (tm_tolocalrepresentation (&date) == TM_OK);
+  ck_assert (tm_gettimezoneof (date) == tm_getlocaltimezone ());
+  ck_assert (tm_getday (date) == 2 && tm_gethour (date) == 21 && tm_getminute (date) == 30);
+
+  ck_assert (strcmp (getenv ("TZ"), "America/New_York") == 0);
+
+  // Concurrent conversions in several timezones
+  pthread_t threads[4];
+
+  for (long i = 0; i < 4; i++)
+    ck_assert (pthread_create (&threads[i], 0, tu_timezone_thread, (void *) i) == 0);
+  for (int i = 0; i < 4; i++)
+  {
+    void *ok;
+
+    ck_assert (pthread_join (threads[i], &ok) == 0 && ok);
+  }
+
+  if (tz)
+    setenv ("TZ", tz, 1);
+  else
+    unsetenv ("TZ");
+}
+
 END_TEST
 START_TEST (tu_serialization)
 {
@@ -757,6 +951,1716 @@ START_TEST (tu_serialization)
 }
 
 END_TEST
+START_TEST (tu_serialization_n)
+{
+  const char *tz = getenv ("TZ");
+  const char *zones[] = { "Europe/Paris", "Australia/Lord_Howe", "America/Sao_Paulo", "UTC" };
+  enum { N = 20000 };
+  static time_t in[N], back[N];
+  static struct tm out[N], expected[N];
+  static tm_status status[N];
+
+  for (size_t z = 0; z < sizeof (zones) / sizeof (*zones); z++)
+  {
+    setenv ("TZ", zones[z], 1);
+
+    // Sorted instants, every 7 hours and 13 minutes from 1960 on, then a few shuffled ones.
+    for (size_t i = 0; i < N; i++)
+      in[i] = -315619200L + (long int) i * (7 * 3600 + 13 * 60);
+    for (size_t i = N - 100; i < N; i++)
+      in[i] = in[(i * 7919) % N];
+    in[N / 2] = LONG_MAX;
+
+    for (int rep = TM_REP_LOCAL; rep <= TM_REP_UTC; rep++)
+    {
+      ck_assert (tm_frombinary_n (out, in, N, rep, status) == TM_ERROR);
+      for (size_t i = 0; i < N; i++)
+      {
+        if (i == N / 2)
+        {
+          ck_assert (status[i] == TM_ERROR);
+          out[i] = out[i - 1];
+          continue;
+        }
+        ck_assert (status[i] == TM_OK);
+        ck_assert (tm_frombinary (&expected[i], in[i]) == TM_OK);
+        if (rep == TM_REP_UTC)
+          ck_assert (tm_toutcrepresentation (&expected[i]) == TM_OK);
+        ck_assert (out[i].tm_year == expected[i].tm_year && out[i].tm_mon == expected[i].tm_mon
+                   && out[i].tm_mday == expected[i].tm_mday && out[i].tm_hour == expected[i].tm_hour
+                   && out[i].tm_min == expected[i].tm_min && out[i].tm_sec == expected[i].tm_sec
+                   && out[i].tm_wday == expected[i].tm_wday && out[i].tm_yday == expected[i].tm_yday
+                   && out[i].tm_isdst == expected[i].tm_isdst && out[i].tm_gmtoff == expected[i].tm_gmtoff
+                   && strcmp (out[i].tm_zone, expected[i].tm_zone) == 0);
+      }
+
+      // Back to binary, with forced daylight saving time flags and attributes out of their range.
+      for (size_t i = 0; i < N; i += 3)
+        out[i].tm_isdst = !out[i].tm_isdst;
+      for (size_t i = 1; i < N; i += 5)
+        out[i].tm_isdst = -1;
+      for (size_t i = 2; i < N; i += 7)
+      {
+        out[i].tm_mday += 40;
+        out[i].tm_min -= 70;
+      }
+      ck_assert (tm_tobinary_n (back, out, N, status) == TM_OK);
+      for (size_t i = 0; i < N; i++)
+        ck_assert (status[i] == TM_OK && back[i] == tm_tobinary (out[i]));
+    }
+  }
+
+  struct tm overflow;
+
+  ck_assert (tm_makeutc (&overflow, 2000, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  overflow.tm_year = INT_MAX;
+  overflow.tm_mon = 12;
+  ck_assert (tm_tobinary_n (back, &overflow, 1, 0) == TM_ERROR && back[0] == (time_t) - 1);
+  ck_assert (tm_tobinary_n (back, &overflow, 0, 0) == TM_OK);
+
+  if (tz)
+    setenv ("TZ", tz, 1);
+  else
+    unsetenv ("TZ");
+}
+
+END_TEST
+START_TEST (tu_instant)
+{
+  struct tm utc, date;
+  tm_instant instant, other;
+
+  ck_assert (tm_makeutc (&utc, 2016, TM_MONTH_JANUARY, 1, 18, 0, 0) == TM_OK);
+  ck_assert (tm_toinstant (utc, &instant) == TM_OK);
+  ck_assert (instant == 1451671200LL * 1000000000LL);
+  ck_assert (tm_getinstantseconds (instant) == tm_tobinary (utc));
+  ck_assert (tm_getinstantnanoseconds (instant) == 0);
+
+  // Sub-second arithmetics
+  ck_assert (tm_instantaddnanoseconds (&instant, 1500000000) == TM_OK);
+  ck_assert (tm_getinstantseconds (instant) == 1451671201 && tm_getinstantnanoseconds (instant) == 500000000);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_UTC) == TM_OK);
+  ck_assert (tm_isutcrepresentation (date) && tm_gethour (date) == 18 && tm_getsecond (date) == 1);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_LOCAL) == TM_OK);
+  ck_assert (tm_islocalrepresentation (date) && tm_diffseconds (utc, date) == 1);
+
+  ck_assert (tm_makeinstant (&other, 1451671201, 500000001) == TM_OK);
+  ck_assert (tm_instantdiffnanoseconds (instant, other) == 1);
+  ck_assert (tm_instantdiffseconds (instant, other) == 0);
+  ck_assert (tm_instantcompare (&instant, &other) < 0 && tm_instantcompare (&other, &instant) > 0);
+  ck_assert (tm_instantaddseconds (&other, -3) == TM_OK);
+  ck_assert (tm_instantdiffseconds (instant, other) == -2);
+  ck_assert (tm_instantcompare (&other, &other) == 0);
+
+  // Before 1970, fractions of second are counted forward from the previous second.
+  ck_assert (tm_makeinstant (&instant, -1, 250000000) == TM_OK);
+  ck_assert (instant == -750000000);
+  ck_assert (tm_getinstantseconds (instant) == -1 && tm_getinstantnanoseconds (instant) == 250000000);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_UTC) == TM_OK);
+  ck_assert (tm_getyear (date) == 1969 && tm_gethour (date) == 23 && tm_getsecond (date) == 59);
+
+  // Limits
+  ck_assert (tm_makeutc (&utc, 1677, TM_MONTH_SEPTEMBER, 21, 0, 12, 44) == TM_OK);
+  ck_assert (tm_toinstant (utc, &instant) == TM_OK);
+  ck_assert (tm_instantaddseconds (&instant, -1) == TM_ERROR);
+  ck_assert (tm_makeutc (&utc, 2262, TM_MONTH_APRIL, 11, 23, 47, 17) == TM_OK);
+  ck_assert (tm_toinstant (utc, &instant) == TM_ERROR);
+  ck_assert (tm_makeinstant (&other, INT64_MAX / 1000000000, 0) == TM_OK);
+  ck_assert (tm_instantaddnanoseconds (&other, 1000000000) == TM_ERROR);
+  errno = 0;
+  ck_assert (tm_instantdiffnanoseconds (INT64_MIN, other) == INT64_MAX && errno == ERANGE);
+
+  // Sorting
+  tm_instant instants[] = { 3, -2, 1, 0 };
+
+  qsort (instants, sizeof (instants) / sizeof (*instants), sizeof (*instants), tm_instantcompare);
+  ck_assert (instants[0] == -2 && instants[1] == 0 && instants[2] == 1 && instants[3] == 3);
+
+  ck_assert (tm_makeinstantnow (&instant) == TM_OK);
+  ck_assert (tm_makenow (&date) == TM_OK);
+  ck_assert (labs (tm_getinstantseconds (instant) - tm_tobinary (date)) <= 1);
+}
+
+END_TEST
+START_TEST (tu_iso8601)
+{
+  const char *tz = getenv ("TZ");
+  tm_instant instant, expected;
+  long int offset;
+  struct tm date;
+
+  setenv ("TZ", "Europe/Paris", 1);
+
+  ck_assert (tm_makeutc (&date, 2016, TM_MONTH_MARCH, 27, 1, 12, 21) == TM_OK);
+  ck_assert (tm_toinstant (date, &expected) == TM_OK);
+  expected += 500000000;
+
+#define PARSE(str) tm_parseiso8601 ((str), strlen (str), &instant, &offset)
+  ck_assert (PARSE ("2016-03-27T02:12:21.5+01:00") == TM_OK && instant == expected && offset == 3600);
+  ck_assert (PARSE ("20160327T011221,500Z") == TM_OK && instant == expected && offset == 0);
+  ck_assert (PARSE ("2016-03-26t20:12:21.500000000999-0500") == TM_OK && instant == expected && offset == -18000);
+  ck_assert (PARSE ("2016-03-27 03:12:21.5") == TM_OK && instant == expected && offset == 7200);    // Local time
+  ck_assert (PARSE ("2016-W12-7T01:12:21.5Z") == TM_OK && instant == expected);
+  ck_assert (PARSE ("2016W127T011221.5Z") == TM_OK && instant == expected);
+  ck_assert (PARSE ("2016-087T01:12:21.5Z") == TM_OK && instant == expected);
+  ck_assert (PARSE ("2016087T011221.5+00") == TM_OK && instant == expected);
+
+  // Not null terminated
+  ck_assert (tm_parseiso8601 ("2016-03-27T01:12:21.5Z0123", 22, &instant, 0) == TM_OK && instant == expected);
+
+  // Dates only, local time
+  ck_assert (PARSE ("2016-03-27") == TM_OK && offset == 3600);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_LOCAL) == TM_OK);
+  ck_assert (tm_getday (date) == 27 && tm_gethour (date) == 0 && !tm_isdaylightsavingtime (date));
+  ck_assert (PARSE ("2015-W53-7") == TM_OK);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_LOCAL) == TM_OK);
+  ck_assert (tm_getyear (date) == 2016 && tm_getmonth (date) == TM_MONTH_JANUARY && tm_getday (date) == 3);
+  ck_assert (PARSE ("2009-W01") == TM_OK);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_LOCAL) == TM_OK);
+  ck_assert (tm_getyear (date) == 2008 && tm_getmonth (date) == TM_MONTH_DECEMBER && tm_getday (date) == 29);
+  ck_assert (PARSE ("2016-366") == TM_OK && PARSE ("2016-02-29") == TM_OK);
+
+  // Limits
+  ck_assert (PARSE ("1969-12-31T23:59:59.999999999Z") == TM_OK && instant == -1);
+  ck_assert (PARSE ("2016-03-27T24:00:00Z") == TM_OK && tm_getinstantseconds (instant) % 86400 == 0);
+  ck_assert (PARSE ("2016-12-31T23:59:60Z") == TM_OK);
+  ck_assert (tm_frominstant (&date, instant, TM_REP_UTC) == TM_OK);
+  ck_assert (tm_getyear (date) == 2017 && tm_gethour (date) == 0 && tm_getsecond (date) == 0);
+
+  // Invalid strings
+  ck_assert (PARSE ("") == TM_ERROR);
+  ck_assert (PARSE ("2016") == TM_ERROR);
+  ck_assert (PARSE ("2016-03") == TM_ERROR);
+  ck_assert (PARSE ("2016-3-27") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27X") == TM_ERROR);
+  ck_assert (PARSE ("2015-02-29") == TM_ERROR);
+  ck_assert (PARSE ("2016-04-31") == TM_ERROR);
+  ck_assert (PARSE ("2015-366") == TM_ERROR);
+  ck_assert (PARSE ("2016-W53") == TM_ERROR);
+  ck_assert (PARSE ("2016-W12-8") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T1:12") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T01:12:21.") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T24:00:01Z") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T01:60Z") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T01:12:21+24:00") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T01:12:21+01:") == TM_ERROR);
+  ck_assert (PARSE ("2016-03-27T01:12:21Z ") == TM_ERROR);
+#undef PARSE
+
+  // Setters
+  ck_assert (tm_makelocal (&date, 2000, TM_MONTH_JANUARY, 1, 10, 20, 30) == TM_OK);
+  ck_assert (tm_setdatefromstring (&date, "2016-W12-6") == TM_OK);
+  ck_assert (tm_getyear (date) == 2016 && tm_getmonth (date) == TM_MONTH_MARCH && tm_getday (date) == 26);
+  ck_assert (tm_gethour (date) == 10 && tm_getminute (date) == 20 && tm_getsecond (date) == 30);
+  ck_assert (tm_settimefromstring (&date, "0745") == TM_OK);
+  ck_assert (tm_gethour (date) == 7 && tm_getminute (date) == 45 && tm_getsecond (date) == 0);
+  ck_assert (tm_settimefromstring (&date, "24:00") == TM_ERROR);
+
+  if (tz)
+    setenv ("TZ", tz, 1);
+  else
+    unsetenv ("TZ");
+}
+
+END_TEST
+START_TEST (tu_iso8601_format)
+{
+  const char *tz = getenv ("TZ");
+  char str[TM_ISO8601MAXLENGTH];
+  size_t length;
+  struct tm date;
+  tm_instant instant, parsed;
+
+  setenv ("TZ", "Europe/Paris", 1);
+
+  ck_assert (tm_makeutc (&date, 2016, TM_MONTH_MARCH, 27, 1, 12, 21) == TM_OK);
+  ck_assert (tm_getiso8601intostring (date, str, sizeof (str), &length) == TM_OK);
+  ck_assert (strcmp (str, "2016-03-27T01:12:21Z") == 0 && length == 20);
+  ck_assert (tm_getiso8601intostring (date, str, 20, &length) == TM_ERROR);
+  ck_assert (tm_getiso8601intostring (date, str, 21, 0) == TM_OK);
+  ck_assert (tm_tolocalrepresentation (&date) == TM_OK);
+  ck_assert (tm_getiso8601intostring (date, str, sizeof (str), &length) == TM_OK);
+  ck_assert (strcmp (str, "2016-03-27T03:12:21+02:00") == 0 && length == 25);
+
+  // Fields out of range
+  struct tm odd = date;
+
+  odd.tm_min = -1;
+  ck_assert (tm_getiso8601intostring (odd, str, sizeof (str), 0) == TM_OK);
+  // 02:59:21 daylight saving time falls in the spring-forward gap: it is 00:59:21 UTC, 01:59:21 standard time.
+  ck_assert (strcmp (str, "2016-03-27T01:59:21+01:00") == 0);
+  ck_assert (tm_makeutc (&odd, 2016, TM_MONTH_DECEMBER, 31, 23, 0, 0) == TM_OK);
+  odd.tm_hour = 150;
+  odd.tm_sec = 3600;
+  odd.tm_mday = 100;
+  odd.tm_mon = -13;
+  ck_assert (tm_getiso8601intostring (odd, str, sizeof (str), 0) == TM_OK);
+  ck_assert (strcmp (str, "2015-03-16T07:00:00Z") == 0);
+
+  ck_assert (tm_toinstant (date, &instant) == TM_OK && tm_instantaddnanoseconds (&instant, 123456789) == TM_OK);
+  ck_assert (tm_getinstantiso8601intostring (instant, TM_REP_UTC, 9, str, sizeof (str), &length) == TM_OK);
+  ck_assert (strcmp (str, "2016-03-27T01:12:21.123456789Z") == 0 && length == 30);
+  ck_assert (tm_getinstantiso8601intostring (instant, TM_REP_LOCAL, 3, str, sizeof (str), &length) == TM_OK);
+  ck_assert (strcmp (str, "2016-03-27T03:12:21.123+02:00") == 0 && length == 29);
+  ck_assert (tm_getinstantiso8601intostring (instant, TM_REP_LOCAL, 0, str, sizeof (str), &length) == TM_OK);
+  ck_assert (strcmp (str, "2016-03-27T03:12:21+02:00") == 0);
+
+  // Round trip with the parser
+  for (instant = -2000000000000000000LL; instant < 2000000000000000000LL; instant += 9876543210987654LL)
+    for (int rep = TM_REP_LOCAL; rep <= TM_REP_UTC; rep++)
+    {
+      ck_assert (tm_getinstantiso8601intostring (instant, rep, 9, str, sizeof (str), &length) == TM_OK);
+      ck_assert (tm_parseiso8601 (str, length, &parsed, 0) == TM_OK && parsed == instant);
+    }
+
+  // Local mean time and expanded years
+  ck_assert (tm_makelocal (&date, 1900, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  ck_assert (tm_getiso8601intostring (date, str, sizeof (str), 0) == TM_OK);
+  ck_assert (strcmp (str, "1900-01-01T00:00:00+00:09:21") == 0);
+  ck_assert (tm_makeutc (&date, 12345, TM_MONTH_DECEMBER, 31, 23, 59, 59) == TM_OK);
+  ck_assert (tm_getiso8601intostring (date, str, sizeof (str), 0) == TM_OK);
+  ck_assert (strcmp (str, "+12345-12-31T23:59:59Z") == 0);
+  ck_assert (tm_makeutc (&date, -1, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  ck_assert (tm_getiso8601intostring (date, str, sizeof (str), 0) == TM_OK);
+  ck_assert (strcmp (str, "-0001-01-01T00:00:00Z") == 0);
+
+  if (tz)
+    setenv ("TZ", tz, 1);
+  else
+    unsetenv ("TZ");
+}
+
+END_TEST
+START_TEST (tu_format_compile)
+{
+  const char *formats[] = {
+    "%Y-%m-%dT%H:%M:%S%z", "%c", "%x %X %r", "%a %A %b %B %h %p %P", "%e %k %l %I %j %u %w %C %y",
+    "%D %F %R %T%n%t%%", "%G %g %V %U %W %s", "%-d %_H %04Y %Ec %Oy %+", "[%Z] %q trailing %", "", "no conversion",
+  };
+  char expected[256], str[256];
+  struct tm date;
+
+  ck_assert (tm_makelocal (&date, 1960, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+
+  for (size_t f = 0; f < sizeof (formats) / sizeof (*formats); f++)
+  {
+    tm_format *prog = tm_format_compile (formats[f]);
+
+    ck_assert (prog);
+
+    struct tm dt = date;
+
+    for (int i = 0; i < 2000; i++)
+    {
+      size_t length = strftime (expected, sizeof (expected), formats[f], &dt);
+
+      ck_assert (tm_format_exec (prog, &dt, str, sizeof (str)) == length);
+      ck_assert (memcmp (str, expected, length) == 0);
+      ck_assert (!length || tm_format_exec (prog, &dt, str, length) == 0);
+
+      // Values out of range
+      struct tm odd = dt;
+
+      odd.tm_year = i % 3 ? 12345 - 1900 : -5 - 1900;
+      odd.tm_mon = i % 5 ? odd.tm_mon : 12;
+      odd.tm_hour = i % 7 ? odd.tm_hour : 25;
+      odd.tm_wday = i % 11 ? odd.tm_wday : -1;
+      odd.tm_zone = i % 13 ? odd.tm_zone : 0;
+      odd.tm_isdst = i % 17 ? odd.tm_isdst : -1;
+      odd.tm_gmtoff = i % 19 ? odd.tm_gmtoff : -561;
+      length = strftime (expected, sizeof (expected), formats[f], &odd);
+      ck_assert (tm_format_exec (prog, &odd, str, sizeof (str)) == length);
+      ck_assert (memcmp (str, expected, length) == 0);
+
+      ck_assert (tm_addseconds (&dt, 86400 * 17 + 3600 * 5 + 60 * 7 + 11) == TM_OK);
+      if (i % 2)
+        ck_assert (tm_toutcrepresentation (&dt) == TM_OK);
+      else
+        ck_assert (tm_tolocalrepresentation (&dt) == TM_OK);
+    }
+
+    tm_format_free (prog);
+  }
+
+  // Conversions delegated to strftime() longer than 256 bytes, and empty ones (time zone of unknown DST)
+  static char wide[1024];
+  tm_format *prog = tm_format_compile ("[%0400Y]%_z");
+  struct tm unknown = date;
+
+  unknown.tm_isdst = -1;
+  ck_assert (prog);
+  ck_assert_int_eq (tm_format_exec (prog, &unknown, wide, sizeof (wide)), 402);
+  ck_assert (wide[0] == '[' && wide[401] == ']' && strncmp (wide + 397, "1960", 4) == 0);
+  ck_assert_int_eq (tm_format_exec (prog, &unknown, wide, 403), 402);
+  ck_assert_int_eq (tm_format_exec (prog, &unknown, wide, 300), 0);
+  ck_assert_int_eq (tm_format_exec (prog, &date, wide, sizeof (wide)), 407);
+  tm_format_free (prog);
+}
+
+END_TEST
+START_TEST (tu_parse_compile)
+{
+  const char *formats[] = {
+    "%d/%m/%Y %H:%M", "%Y-%m-%dT%H:%M:%S", "%a %b %e %T %Y", "%A, %B %d, %Y %I:%M:%S %p", "%D %R", "%F%n%T", "%Y%j %H%M%S",
+  };
+  char str[256];
+  struct tm date;
+
+  ck_assert (tm_makelocal (&date, 1960, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+
+  // Same result as strptime() followed by tm_makelocal()
+  for (size_t f = 0; f < sizeof (formats) / sizeof (*formats); f++)
+  {
+    tm_parser *parser = tm_parse_compile (formats[f]);
+
+    ck_assert (parser);
+
+    struct tm dt = date;
+
+    for (int i = 0; i < 2000; i++)
+    {
+      size_t length = strftime (str, sizeof (str), formats[f], &dt);
+      struct tm parsed, expected = { 0 };
+
+      expected.tm_year = 70;
+      expected.tm_mday = 1;
+      ck_assert (strptime (str, formats[f], &expected) == str + length);
+      ck_assert (tm_makelocal (&expected, expected.tm_year + 1900, expected.tm_mon + 1, expected.tm_mday, expected.tm_hour,
+                               expected.tm_min, expected.tm_sec) == TM_OK);
+      ck_assert (tm_parse_exec (parser, str, length, &parsed) == TM_OK);
+      ck_assert (tm_diffseconds (expected, parsed) == 0);
+      ck_assert (parsed.tm_isdst == expected.tm_isdst);
+
+      tm_instant instant;
+
+      ck_assert (tm_parse_execinstant (parser, str, length, &instant) == TM_OK);
+      ck_assert (tm_getinstantseconds (instant) == mktime (&expected));
+
+      // Trailing input
+      str[length] = 'x';
+      ck_assert (tm_parse_exec (parser, str, length + 1, &parsed) == TM_ERROR);
+
+      ck_assert (tm_addseconds (&dt, 86400 * 17 + 3600 * 5 + 60 * 7 + 11) == TM_OK);
+    }
+
+    tm_parse_free (parser);
+  }
+
+  tm_parser *parser = tm_parse_compile ("%d/%m/%Y %H:%M");
+  struct tm dt;
+
+  ck_assert (tm_parse_exec (parser, "1/2/2016 9:05", 13, &dt) == TM_OK);
+  ck_assert (tm_getyear (dt) == 2016 && tm_getmonth (dt) == TM_MONTH_FEBRUARY && tm_getday (dt) == 1);
+  ck_assert (tm_gethour (dt) == 9 && tm_getminute (dt) == 5 && tm_getsecond (dt) == 0);
+  ck_assert (tm_parse_exec (parser, "30/02/2016 09:05", 16, &dt) == TM_ERROR);
+  ck_assert (tm_parse_exec (parser, "29/02/2016 24:00", 16, &dt) == TM_ERROR);
+  ck_assert (tm_parse_exec (parser, "29/02/2016 23:60", 16, &dt) == TM_ERROR);
+  ck_assert (tm_parse_exec (parser, "29/02/2016 23:59", 16, &dt) == TM_OK);
+  ck_assert (tm_parse_exec (parser, "29-02-2016 23:59", 16, &dt) == TM_ERROR);
+  // Local time skipped by daylight saving time, if any
+  ck_assert (tm_parse_exec (parser, "27/03/2016 02:30", 16, &dt)
+             == tm_makelocal (&date, 2016, TM_MONTH_MARCH, 27, 2, 30, 0));
+  tm_parse_free (parser);
+
+  parser = tm_parse_compile ("%Y-%m-%d %H:%M:%S %z");
+  tm_instant instant;
+
+  ck_assert (tm_parse_execinstant (parser, "2016-03-27 02:30:00 +0200", 25, &instant) == TM_OK);
+  ck_assert (tm_getinstantseconds (instant) == 1459038600);
+  ck_assert (tm_parse_exec (parser, "2016-03-27 02:30:00 -05:30", 26, &dt) == TM_OK);
+  ck_assert (tm_tobinary (dt) == 1459038600 + 7.5 * 3600);
+  tm_parse_free (parser);
+
+  errno = 0;
+  ck_assert (tm_parse_compile ("%c") == 0 && errno == EINVAL);
+  ck_assert (tm_parse_compile ("%Ey") == 0);
+}
+
+END_TEST
+static tm_status
+tu_syntheticclock (struct timespec *now, void *arg)
+{
+  now->tv_sec = *(time_t *) arg;
+  now->tv_nsec = 123456789;
+
+  return TM_OK;
+}
+
+START_TEST (tu_clock)
+{
+  time_t t;
+  struct tm now, expected;
+
+  tm_setclockfunction (tu_syntheticclock, &t);
+
+  // Synthetic clock, going through daylight saving time changes, minutes, days and backward steps
+  ck_assert (tm_makelocal (&expected, 2016, TM_MONTH_MARCH, 26, 23, 0, 0) == TM_OK);
+  t = tm_tobinary (expected);
+  for (int i = 0; i < 20000; i++)
+  {
+    t += i % 97 ? 7 : -3600;
+    if (i == 10000)
+    {
+      ck_assert (tm_makelocal (&expected, 2016, TM_MONTH_OCTOBER, 30, 0, 0, 0) == TM_OK);
+      t = tm_tobinary (expected);
+    }
+    ck_assert (tm_makenow (&now) == TM_OK);
+    ck_assert (tm_frombinary (&expected, t) == TM_OK);
+    ck_assert (tm_equals (now, expected));
+    ck_assert (now.tm_isdst == expected.tm_isdst && now.tm_yday == expected.tm_yday && now.tm_wday == expected.tm_wday);
+
+    ck_assert (tm_maketoday (&now) == TM_OK);
+    ck_assert (tm_trimtime (&expected) == TM_OK);
+    ck_assert (tm_equals (now, expected));
+  }
+
+  tm_instant instant;
+
+  ck_assert (tm_makeinstantnow (&instant) == TM_OK);
+  ck_assert (tm_getinstantseconds (instant) == t && tm_getinstantnanoseconds (instant) == 123456789);
+
+  // System clocks
+  tm_setclockfunction (0, 0);
+  ck_assert (tm_makenow (&now) == TM_OK);
+  ck_assert (tm_diffseconds (now, expected) <= 0);
+  if (tm_setclocksource (TM_CLOCK_REALTIME_COARSE) == TM_OK)
+  {
+    ck_assert (tm_makenow (&now) == TM_OK);
+    ck_assert (tm_makeinstantnow (&instant) == TM_OK);
+    ck_assert (llabs (tm_getinstantseconds (instant) - tm_tobinary (now)) <= 1);
+  }
+  ck_assert (tm_setclocksource ((tm_clocksource) - 1) == TM_ERROR && errno == EINVAL);
+  ck_assert (tm_setclocksource (TM_CLOCK_REALTIME) == TM_OK);
+}
+
+END_TEST
+START_TEST (tu_logformat)
+{
+  const char *formats[] = { "%Y-%m-%d %H:%M:%S.%3N", "%F %T.%6N %z", 0, "%s.%N", "[%d/%b/%Y:%H:%M:%S %z] %S%%S %1N", "%c" };
+  char str[256], expected[256], fmt[256];
+  tm_instant instant;
+  struct tm date;
+
+  ck_assert (tm_makelocal (&date, 2016, TM_MONTH_MARCH, 27, 0, 0, 0) == TM_OK);
+
+  for (size_t f = 0; f < sizeof (formats) / sizeof (*formats); f++)
+  {
+    tm_logformat *log = tm_logformat_compile (formats[f]);
+
+    ck_assert (log);
+    ck_assert (tm_toinstant (date, &instant) == TM_OK);
+
+    for (int i = 0; i < 20000; i++)
+    {
+      tm_representation representation = i % 1000 < 500 ? TM_REP_LOCAL : TM_REP_UTC;
+      long int nanoseconds = (long int) (tm_getinstantnanoseconds (instant));
+      char fraction[16];
+      size_t n = 0;
+
+      // Expected result: strftime() with the fraction of second in place of %N
+      sprintf (fraction, "%09ld", nanoseconds);
+      for (const char *p = formats[f] ? formats[f] : "%x %X"; *p; p++)
+        if (p[0] == '%' && p[1] == 'N')
+          n += (size_t) sprintf (fmt + n, "%s", fraction), p++;
+        else if (p[0] == '%' && p[1] >= '1' && p[1] <= '9' && p[2] == 'N')
+          n += (size_t) sprintf (fmt + n, "%.*s", p[1] - '0', fraction), p += 2;
+        else if (p[0] == '%' && p[1])
+          fmt[n++] = *p++, fmt[n++] = *p;
+        else
+          fmt[n++] = *p;
+      fmt[n] = 0;
+      ck_assert (tm_frominstant (&date, instant, representation) == TM_OK);
+      n = strftime (expected, sizeof (expected), fmt, &date);
+
+      ck_assert (tm_logformat_exec (log, instant, representation, str, sizeof (str)) == n);
+      ck_assert (strcmp (str, expected) == 0);
+      ck_assert (tm_logformat_exec (log, instant, representation, str, n) == 0);
+
+      ck_assert (tm_instantaddnanoseconds (&instant, i % 7 ? 123456789 : i % 3 ? 987654321987 : -3600000000000) == TM_OK);
+    }
+
+    tm_logformat_free (log);
+  }
+
+  errno = 0;
+  ck_assert (tm_logformat_compile ("%S %S %S %S %S %S %S %S %S") == 0 && errno == EINVAL);
+
+  // A segment rendering to nothing (%Z of a timezone with an empty abbreviation, as %p of locales without AM/PM) is not an error.
+  static const unsigned char tzif[] = { 'T', 'Z', 'i', 'f', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1,
+    0, 0, 0, 0, 0, 0, 0
+  };
+  char cwd[2048], path[4096];
+  const char *tz = getenv ("TZ");
+  char *previous = tz ? strdup (tz) : 0;
+  FILE *f;
+
+  ck_assert (getcwd (cwd, sizeof (cwd)));
+  snprintf (path, sizeof (path), "%s/dates_tu_check.noname", cwd);
+  ck_assert ((f = fopen (path, "wb")) && fwrite (tzif, sizeof (tzif), 1, f) == 1 && fclose (f) == 0);
+  setenv ("TZ", path, 1);
+
+  tm_logformat *log = tm_logformat_compile ("%Z%S.%3N");
+
+  ck_assert (log);
+  ck_assert (tm_makeinstant (&instant, 1458000007, 250000000) == TM_OK);
+  ck_assert (tm_logformat_exec (log, instant, TM_REP_LOCAL, str, sizeof (str)) == 6);
+  ck_assert (!strcmp (str, "07.250"));
+  ck_assert (tm_makeinstant (&instant, 1458000008, 0) == TM_OK);
+  ck_assert (tm_logformat_exec (log, instant, TM_REP_LOCAL, str, sizeof (str)) == 6);
+  ck_assert (!strcmp (str, "08.000"));
+  ck_assert (tm_logformat_exec (log, instant, TM_REP_LOCAL, str, 6) == 0);
+  tm_logformat_free (log);
+
+  if (previous)
+    setenv ("TZ", previous, 1);
+  else
+    unsetenv ("TZ");
+  free (previous);
+  ck_assert (unlink (path) == 0);
+}
+
+END_TEST
+START_TEST (tu_diffcalendardays_n)
+{
+  enum { N = 1000 };
+  struct tm debut[N], fin[N], noon;
+  int days[N];
+  tm_status status[N];
+
+  for (int i = 0; i < N; i++)
+  {
+    ck_assert (tm_makelocal (&debut[i], 1850 + i % 200, TM_MONTH_JANUARY + i % 12, 1 + i % 28, 12, i % 60, 0) == TM_OK);
+    ck_assert (tm_makelocal (&fin[i], 2100 - i % 170, TM_MONTH_DECEMBER - i % 12, 28 - i % 28, 13, 59 - i % 60, 59) == TM_OK);
+  }
+  ck_assert (tm_makeutc (&fin[N - 1], 2016, TM_MONTH_MARCH, 27, 0, 0, 0) == TM_OK);
+
+  ck_assert (tm_diffcalendardays_n (days, debut, fin, N, status) == TM_ERROR && errno == EINVAL);
+  ck_assert (status[N - 1] == TM_ERROR && days[N - 1] == 0);
+  for (int i = 0; i < N - 1; i++)
+  {
+    ck_assert (status[i] == TM_OK);
+    ck_assert (days[i] == tm_diffcalendardays (debut[i], fin[i]));
+    ck_assert (-days[i] == tm_diffcalendardays (fin[i], debut[i]));
+
+    // Number of days between noons, UTC
+    ck_assert (tm_makeutc (&noon, tm_getyear (fin[i]), tm_getmonth (fin[i]), tm_getday (fin[i]), 12, 0, 0) == TM_OK);
+    long int seconds = tm_tobinary (noon);
+
+    ck_assert (tm_makeutc (&noon, tm_getyear (debut[i]), tm_getmonth (debut[i]), tm_getday (debut[i]), 12, 0, 0) == TM_OK);
+    ck_assert (days[i] * 86400L == seconds - tm_tobinary (noon));
+  }
+  ck_assert (tm_diffcalendardays_n (days, debut, fin, N - 1, 0) == TM_OK);
+}
+
+END_TEST
+START_TEST (tu_calendar_properties)
+{
+  int (*daysinmonth) (int, tm_month) = tm_getdaysinmonth;     // External definition in the library
+
+  for (int year = 1600; year <= 2400; year++)
+  {
+    struct tm date;
+
+    // Same results as with broken-down time structures
+    ck_assert (tm_makeutc (&date, year + 1, TM_MONTH_JANUARY, 4, 12, 0, 0) == TM_OK && tm_adddays (&date, -7) == TM_OK);
+    ck_assert (tm_getweeksinisoyear (year) == tm_getisoweek (date));
+    ck_assert (tm_makeutc (&date, year, TM_MONTH_DECEMBER, 31, 12, 0, 0) == TM_OK);
+    ck_assert (tm_isleapyear (year) == (tm_getdayofyear (date) == 366));
+
+    for (tm_month month = TM_MONTH_JANUARY; month <= TM_MONTH_DECEMBER; month++)
+    {
+      struct tm first, last;
+
+      ck_assert (tm_makeutc (&first, year, month, 1, 12, 0, 0) == TM_OK);
+      last = first;
+      ck_assert (tm_addmonths (&last, 1) == TM_OK && tm_adddays (&last, -1) == TM_OK);
+      ck_assert (tm_getdaysinmonth (year, month) == tm_getday (last));
+      ck_assert (daysinmonth (year, month) == tm_getday (last));
+      ck_assert (tm_getdayssinceepoch (year, month, 1) * 86400 + 43200 == tm_tobinary (first));
+
+      for (tm_dayofweek dow = TM_WEEKDAY_MONDAY; dow <= TM_WEEKDAY_SUNDAY; dow++)
+      {
+        date = first;
+        ck_assert (tm_adddays (&date, tm_getfirstweekdayinmonth (year, month, dow) - 1) == TM_OK);
+        ck_assert (tm_getdayofweek (date) == dow && tm_getday (date) <= 7);
+        date = last;
+        ck_assert (tm_adddays (&date, tm_getlastweekdayinmonth (year, month, dow) - tm_getday (last)) == TM_OK);
+        ck_assert (tm_getdayofweek (date) == dow && tm_getday (last) - tm_getday (date) < 7);
+      }
+    }
+
+    for (tm_dayofweek dow = TM_WEEKDAY_MONDAY; dow <= TM_WEEKDAY_SUNDAY; dow++)
+    {
+      ck_assert (tm_makeutc (&date, year, TM_MONTH_JANUARY, 1, 12, 0, 0) == TM_OK);
+      ck_assert (tm_adddays (&date, tm_getfirstweekdayinisoyear (year, dow) - 1) == TM_OK);
+      ck_assert (tm_getdayofweek (date) == dow && tm_getisoweek (date) == 1 && tm_getisoyear (date) == year);
+    }
+  }
+  ck_assert (tm_getdaysinmonth (2016, 13) == -1 && tm_getfirstweekdayinmonth (2016, 0, TM_WEEKDAY_MONDAY) == -1);
+
+  // Seconds of day, around daylight saving time changes
+  struct tm date, midnight;
+
+  ck_assert (tm_makelocal (&date, 2016, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  for (int i = 0; i < 366 * 24 * 4; i++)
+  {
+    midnight = date;
+    if (tm_set (&midnight, tm_getyear (date), tm_getmonth (date), tm_getday (date), 0, 0, 0) == TM_OK)
+      ck_assert (tm_getsecondsofday (date) == tm_diffseconds (midnight, date));
+    ck_assert (tm_addseconds (&date, 900) == TM_OK);
+  }
+}
+
+END_TEST
+START_TEST (tu_transitions)
+{
+  const char *zones[] = { "Europe/Paris", "America/New_York", "Australia/Lord_Howe", "Asia/Tokyo", "CET-1CEST,M3.5.0,M10.5.0/3" };
+
+  for (size_t z = 0; z < sizeof (zones) / sizeof (*zones); z++)
+  {
+    const tm_timezone *tz = tm_loadtimezone (zones[z]);
+
+    if (!tz)
+      continue;                 // Timezone database not installed
+
+    // Transition table
+    size_t n = tm_getnbtransitions (tz);
+    tm_transition transition, found;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      ck_assert (tm_gettransition (tz, i, &transition) == TM_OK && transition.index == i);
+      if (i)
+      {
+        tm_transition previous;
+
+        ck_assert (tm_gettransition (tz, i - 1, &previous) == TM_OK);
+        ck_assert (previous.when < transition.when);
+        ck_assert (previous.utcoffsetafter == transition.utcoffsetbefore && previous.isdstafter == transition.isdstbefore);
+      }
+      if (transition.when < -9000000000LL || transition.when > 9000000000LL)
+        continue;
+
+      tm_instant at;
+
+      ck_assert (tm_makeinstant (&at, transition.when, 0) == TM_OK);
+      ck_assert (tm_prevtransition (tz, at, &found) == TM_OK && found.index == i);
+      ck_assert (tm_prevtransition (tz, at - 1, &found) == TM_ERROR || found.index + 1 == i);
+      ck_assert (tm_nexttransition (tz, at - 1, &found) == TM_OK && found.index == i);
+      ck_assert (tm_nexttransition (tz, at, &found) == TM_ERROR || found.index == i + 1);
+
+      // Overlaps and gaps, in the local time of the timezone
+      struct tm date;
+
+      ck_assert (tm_frominstant (&date, at - 1000000000, TM_REP_UTC) == TM_OK);
+      ck_assert (tm_totimezonerepresentation (&date, tz) == TM_OK);
+      ck_assert (tm_getutcoffset (date) == transition.utcoffsetbefore);
+      if (transition.utcoffsetafter < transition.utcoffsetbefore && transition.isdstbefore && !transition.isdstafter)
+      {
+        // Last second before the transition: repeated after it
+        ck_assert (tm_isdaylightsavingextrasummertime (date));
+        ck_assert (!tm_isdaylightsavingextrawintertime (date));
+        struct tm later = date;
+
+        ck_assert (tm_todaylightsavingextrawintertime (&later) == TM_OK);
+        ck_assert (tm_getutcoffset (later) == transition.utcoffsetafter);
+        ck_assert (tm_gethour (later) == tm_gethour (date) && tm_getminute (later) == tm_getminute (date)
+                   && tm_getsecond (later) == tm_getsecond (date));
+        ck_assert (tm_diffseconds (date, later) == transition.utcoffsetbefore - transition.utcoffsetafter);
+        ck_assert (tm_isdaylightsavingextrawintertime (later) && !tm_isdaylightsavingextrasummertime (later));
+        ck_assert (tm_todaylightsavingextrasummertime (&later) == TM_OK && tm_equals (later, date));
+        ck_assert (tm_todaylightsavingextrasummertime (&date) == TM_ERROR);
+      }
+      else if (transition.utcoffsetafter > transition.utcoffsetbefore)
+      {
+        ck_assert (!tm_isdaylightsavingextrasummertime (date) && !tm_isdaylightsavingextrawintertime (date));
+        ck_assert (tm_todaylightsavingextrawintertime (&date) == TM_ERROR);
+      }
+    }
+    ck_assert (tm_gettransition (tz, n, &transition) == TM_ERROR);
+  }
+
+  // Same results as with normalizations, in local time, every 15 minutes
+  struct tm date;
+
+  ck_assert (tm_makelocal (&date, 2016, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  for (int i = 0; i < 366 * 24 * 4; i++)
+  {
+    struct tm other = date;
+    int summer = 0, winter = 0;
+
+    if (date.tm_isdst)
+    {
+      other.tm_isdst = 0;
+      mktime (&other);
+      summer = !other.tm_isdst;
+    }
+    else
+    {
+      other.tm_isdst = 1;
+      mktime (&other);
+      winter = other.tm_isdst;
+    }
+    ck_assert (tm_isdaylightsavingextrasummertime (date) == summer);
+    ck_assert (tm_isdaylightsavingextrawintertime (date) == winter);
+    ck_assert (tm_addseconds (&date, 900) == TM_OK);
+  }
+}
+
+END_TEST
+START_TEST (tu_sort)
+{
+  enum { N = 10000 };
+  static struct tm dates[N], sorted[N];
+  size_t indexes[N];
+
+  srand (1);
+  for (int i = 0; i < N; i++)
+  {
+    ck_assert (tm_makeutc (&dates[i], 1800 + rand () % 400, 1 + rand () % 12, 1 + rand () % 28, rand () % 24, rand () % 60, 0) == TM_OK);
+    if (i % 3)
+      ck_assert (tm_tolocalrepresentation (&dates[i]) == TM_OK);
+    if (i % 100 == 0)
+      dates[i] = dates[i / 2];  // Same instants
+  }
+
+  ck_assert (tm_sortindex (dates, N, indexes) == TM_OK);
+  memcpy (sorted, dates, sizeof (dates));
+  ck_assert (tm_sort (sorted, N) == TM_OK);
+
+  for (int i = 0; i < N; i++)
+  {
+    ck_assert (tm_equals (sorted[i], dates[indexes[i]]));
+    if (i)
+    {
+      ck_assert (tm_compare (&sorted[i - 1], &sorted[i]) <= 0);
+      // Stable
+      ck_assert (tm_compare (&sorted[i - 1], &sorted[i]) < 0 || indexes[i - 1] < indexes[i]);
+    }
+  }
+
+  // Permutation
+  static char seen[N];
+
+  for (int i = 0; i < N; i++)
+  {
+    ck_assert (indexes[i] < N && !seen[indexes[i]]);
+    seen[indexes[i]] = 1;
+  }
+
+  ck_assert (tm_sort (sorted, 0) == TM_OK);
+}
+
+END_TEST
+START_TEST (tu_pointer_api)
+{
+  enum { N = 2000 };
+  static struct tm dates[N];
+
+  srand (2);
+  for (int i = 0; i < N; i++)
+  {
+    ck_assert (tm_makeutc (&dates[i], 1900 + rand () % 300, 1 + rand () % 12, 1 + rand () % 28, rand () % 24, rand () % 60, 0) == TM_OK);
+    if (i % 2)
+      ck_assert (tm_tolocalrepresentation (&dates[i]) == TM_OK);
+  }
+
+  for (int i = 0; i < N; i++)
+  {
+    // Mostly pairs of dates in the same representation.
+    int j = (i * 7 + (i % 5 ? 2 : 1)) % N;
+    struct tm a = dates[i], b = dates[j];
+    const struct tm *pa = &dates[i], *pb = &dates[j];
+    int w = 0, m = 0, d1 = 0, d2 = 0, s1 = 0, s2 = 0;
+    tm_instant instant;
+    char buffer[32], expected[32];
+
+    // Getters are checked against the fields of the structure and strftime().
+    ck_assert_int_eq (tm_getyear_p (pa), pa->tm_year + 1900);
+    ck_assert_int_eq (tm_getmonth_p (pa), pa->tm_mon + 1);
+    ck_assert_int_eq (tm_getday_p (pa), pa->tm_mday);
+    ck_assert_int_eq (tm_gethour_p (pa), pa->tm_hour);
+    ck_assert_int_eq (tm_getminute_p (pa), pa->tm_min);
+    ck_assert_int_eq (tm_getsecond_p (pa), pa->tm_sec);
+    ck_assert_int_eq (tm_getdayofyear_p (pa), pa->tm_yday + 1);
+    strftime (expected, sizeof (expected), "%u %V %G", pa);
+    snprintf (buffer, sizeof (buffer), "%i %02i %i", tm_getdayofweek_p (pa), tm_getisoweek_p (pa), tm_getisoyear_p (pa));
+    ck_assert (!strcmp (buffer, expected));
+    ck_assert (tm_getutcoffset_p (pa) == pa->tm_gmtoff);
+    ck_assert (!strcmp (tm_gettimezone_p (pa), pa->tm_zone));
+    ck_assert_int_eq (tm_isdaylightsavingtime_p (pa), pa->tm_isdst);
+    ck_assert_int_eq (tm_isutcrepresentation_p (pa), !(i % 2));
+    ck_assert_int_eq (tm_islocalrepresentation_p (pa), i % 2);
+    ck_assert_int_eq (tm_getrepresentation_p (pa), i % 2 ? TM_REP_LOCAL : TM_REP_UTC);
+
+    // Calendar time is checked against mktime() and timegm() on copies, which was the former implementation.
+    time_t ta = i % 2 ? mktime (&a) : timegm (&a);
+    time_t tb = j % 2 ? mktime (&b) : timegm (&b);
+
+    ck_assert (tm_tobinary_p (pa) == ta);
+    struct tm midnight = *pa;
+    midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;
+    ck_assert (tm_getsecondsofday_p (pa) == ta - (i % 2 ? mktime (&midnight) : timegm (&midnight)));
+    ck_assert (tm_toinstant_p (pa, &instant) == TM_OK && tm_getinstantseconds (instant) == ta);
+    ck_assert (tm_diffseconds_p (pa, pb) == tb - ta);
+    ck_assert (tm_equals_p (pa, pa));
+    ck_assert (tm_equals_p (pa, pb) == (ta == tb && pa->tm_gmtoff == pb->tm_gmtoff && !strcmp (pa->tm_zone, pb->tm_zone)));
+
+    // Differences in calendar units are checked against the dates, and against each other.
+    if (i % 2 == j % 2)
+    {
+      ck_assert (tm_diffcalendardays_p (pa, pb) ==
+                 tm_getdayssinceepoch (tm_getyear_p (pb), tm_getmonth_p (pb), tm_getday_p (pb))
+                 - tm_getdayssinceepoch (tm_getyear_p (pa), tm_getmonth_p (pa), tm_getday_p (pa)));
+      ck_assert_int_eq (tm_diffcalendarmonths_p (pa, pb), (pb->tm_year - pa->tm_year) * 12 + pb->tm_mon - pa->tm_mon);
+      ck_assert_int_eq (tm_diffcalendaryears_p (pa, pb), pb->tm_year - pa->tm_year);
+
+      d1 = tm_diffdays_p (pa, pb, &s1);
+      w = tm_diffweeks_p (pa, pb, &d2, &s2);
+      ck_assert (w * 7 + d2 == d1 && s2 == s1);
+      m = tm_diffmonths_p (pa, pb, &d1, &s1);
+      ck_assert (tm_diffyears_p (pa, pb, &w, &d2, &s2) * 12 + w == m && d2 == d1 && s2 == s1);
+    }
+
+    // Calendar time is computed without normalizing: the dates are left untouched.
+    ck_assert (!memcmp (pa, &dates[i], sizeof (*pa)) && !memcmp (pb, &dates[j], sizeof (*pb)));
+  }
+
+  // Across daylight saving time changes (local timezone is Europe/Paris), with fields in and out of their ranges,
+  // calendar time and differences in seconds are checked against mktime() on copies.
+  struct tm edges[8 * 7 * 4];
+  time_t expected[sizeof (edges) / sizeof (*edges)];
+  size_t n = 0;
+
+  for (int year = 2015; year < 2019; year++)
+    for (tm_month month = TM_MONTH_MARCH; month <= TM_MONTH_OCTOBER; month += TM_MONTH_OCTOBER - TM_MONTH_MARCH)
+    {
+      // Last Sunday of the month, 01:00 UTC.
+      time_t change = (tm_getdayssinceepoch (year, month, 31) - (tm_getdayssinceepoch (year, month, 31) + 4) % 7) * 86400 + 3600;
+      static const int shifts[] = { -3601, -3600, -1, 0, 1, 3599, 3600 };
+
+      for (size_t k = 0; k < sizeof (shifts) / sizeof (*shifts); k++)
+      {
+        struct tm date;
+
+        ck_assert (tm_frombinary (&date, change + shifts[k]) == TM_OK);
+        edges[n] = date;
+        expected[n++] = change + shifts[k];
+
+        // Out of range fields, with the daylight saving time flag of the original date.
+        date.tm_min += 90;
+        date.tm_sec -= 45;
+        edges[n] = date;
+        expected[n++] = mktime (&date);
+
+        date = edges[n - 2];
+        date.tm_mday -= 40;
+        date.tm_hour += 24 * 40;
+        edges[n] = date;
+        expected[n++] = mktime (&date);
+
+        date = edges[n - 3];
+        date.tm_mon += 12;
+        date.tm_year -= 1;
+        edges[n] = date;
+        expected[n++] = mktime (&date);
+      }
+    }
+
+  ck_assert (n == sizeof (edges) / sizeof (*edges));
+  for (size_t k = 0; k < n; k++)
+  {
+    struct tm copy = edges[k];
+
+    ck_assert (mktime (&copy) == expected[k]);
+    ck_assert (tm_tobinary_p (&edges[k]) == expected[k]);
+    for (size_t l = 0; l < n; l += 5)
+      ck_assert (tm_diffseconds_p (&edges[l], &edges[k]) == expected[k] - expected[l]);
+  }
+
+  // Dates out of the range of calendar time still fail.
+  struct tm far;
+
+  ck_assert (tm_makeutc (&far, 9999, TM_MONTH_DECEMBER, 31, 23, 59, 59) == TM_OK);
+  far.tm_year = INT_MAX - 1900;
+  ck_assert (tm_tobinary_p (&far) == tm_tobinary (far));
+}
+
+END_TEST
+START_TEST (tu_zone_identity)
+{
+  const tm_timezone *london = tm_loadtimezone ("Europe/London");
+  struct tm winter, utc, copy;
+
+  ck_assert (london);
+  ck_assert (tm_makeintimezone (&winter, london, 2020, TM_MONTH_JANUARY, 15, 12, 0, 0) == TM_OK);
+  ck_assert (tm_makeutc (&utc, 2020, TM_MONTH_JANUARY, 15, 12, 0, 0) == TM_OK);
+
+  // Spelled like UTC, but local to London.
+  ck_assert (!strcmp (tm_gettimezone (winter), "GMT"));
+  ck_assert (tm_islocalrepresentation (winter));
+  ck_assert (tm_getrepresentation (utc) == TM_REP_UTC);
+  ck_assert (tm_diffseconds (utc, winter) == 0);
+  ck_assert (!tm_equals (utc, winter));
+
+  copy = winter;
+  ck_assert (tm_equals (copy, winter));
+  ck_assert (tm_toutcrepresentation (&copy) == TM_OK);
+  ck_assert (tm_equals (copy, utc));
+
+  // Instants broken down by gmtime_r() are in UTC representation.
+  time_t t = tm_tobinary (utc);
+
+  ck_assert (gmtime_r (&t, &copy));
+  ck_assert (tm_isutcrepresentation (copy));
+
+  // Dates are mapped back to their own timezone, whatever the number of loaded timezones, even for shared spellings.
+  static const char *names[] = { "Europe/Berlin", "Europe/Rome", "Europe/Madrid", "Europe/Brussels", "America/Chicago",
+    "America/Denver", "America/Los_Angeles", "Asia/Tokyo", "Asia/Kolkata", "Australia/Sydney", "Africa/Casablanca",
+    "America/Sao_Paulo", "Pacific/Auckland", "Asia/Kathmandu", "CET-1CEST,M3.5.0,M10.5.0/3"
+  };
+  const tm_timezone *zones[sizeof (names) / sizeof (*names)];
+  struct tm dates[sizeof (names) / sizeof (*names)][2];
+
+  for (size_t i = 0; i < sizeof (names) / sizeof (*names); i++)
+  {
+    ck_assert ((zones[i] = tm_loadtimezone (names[i])));
+    ck_assert (tm_makeintimezone (&dates[i][0], zones[i], 2020, TM_MONTH_JANUARY, 15, 12, 0, 0) == TM_OK);
+    ck_assert (tm_makeintimezone (&dates[i][1], zones[i], 2020, TM_MONTH_JULY, 15, 12, 0, 0) == TM_OK);
+  }
+  for (size_t i = 0; i < sizeof (names) / sizeof (*names); i++)
+    for (size_t j = 0; j < 2; j++)
+      ck_assert (tm_gettimezoneof_p (&dates[i][j]) == zones[i]);
+  ck_assert (tm_gettimezoneof_p (&winter) == london);
+
+  // Changes of TZ are noticed.
+  const char *tz = getenv ("TZ");
+  char *previous = tz ? strdup (tz) : 0;
+
+  setenv ("TZ", "Asia/Tokyo", 1);
+  ck_assert (tm_makelocal (&copy, 2020, TM_MONTH_JULY, 15, 12, 0, 0) == TM_OK);
+  ck_assert (tm_getutcoffset (copy) == 9 * 3600);
+  setenv ("TZ", "America/Chicago", 1);
+  ck_assert (tm_makelocal (&copy, 2020, TM_MONTH_JULY, 15, 12, 0, 0) == TM_OK);
+  ck_assert (tm_getutcoffset (copy) == -5 * 3600);
+  // Even when the value of TZ is modified in place, at the same address.
+  static char variable[32] = "TZ=Asia/Tokyo";
+
+  putenv (variable);
+  ck_assert (tm_makelocal (&copy, 2020, TM_MONTH_JULY, 15, 12, 0, 0) == TM_OK);
+  ck_assert (tm_getutcoffset (copy) == 9 * 3600);
+  strcpy (variable, "TZ=America/Chicago");
+  ck_assert (tm_makelocal (&copy, 2020, TM_MONTH_JULY, 15, 12, 0, 0) == TM_OK);
+  ck_assert (tm_getutcoffset (copy) == -5 * 3600);
+  if (previous)
+    setenv ("TZ", previous, 1);
+  else
+    unsetenv ("TZ");
+  free (previous);
+}
+
+END_TEST
+START_TEST (tu_iter)
+{
+  const tm_timezone *paris = tm_loadtimezone ("Europe/Paris");
+  struct tm start, end;
+  tm_iter it;
+  const char *result;
+  char string[32];
+
+  // Same walk as tu_day_loop, without normalizing each hour.
+  result =
+    "00-01 ;01-02 ;02-03A;02-03B;03-04 ;04-05 ;05-06 ;06-07 ;07-08 ;08-09 ;09-10 ;10-11 ;11-12 ;12-13 ;13-14 ;14-15 ;15-16 ;16-17 ;17-18 ;18-19 ;19-20 ;20-21 ;21-22 ;22-23 ;23-24 ;";
+  ck_assert (tm_makeintimezone (&start, paris, 2016, TM_MONTH_OCTOBER, 30, 0, 0, 0) == TM_OK);
+  ck_assert (tm_makeintimezone (&end, paris, 2016, TM_MONTH_OCTOBER, 31, 0, 0, 0) == TM_OK);
+  ck_assert (tm_iter_init (&it, &start, &end, TM_ITER_HOUR, 1) == TM_OK);
+  while (tm_iter_next (&it))
+  {
+    sprintf (string, "%02i-%02i%s;", tm_gethour_p (&it.current), tm_gethour_p (&it.current) + 1,
+             it.flags & TM_ITER_OVERLAP_FIRST ? "A" : it.flags & TM_ITER_OVERLAP_SECOND ? "B" : " ");
+    ck_assert (strncmp (string, result, 7) == 0);
+    ck_assert (it.daylength == 25 * 3600);
+    result += 7;
+  }
+  ck_assert (*result == 0);
+  ck_assert (!tm_iter_next (&it));
+
+  // Days over a forward transition, at a skipped local time
+  ck_assert (tm_makeintimezone (&start, paris, 2016, TM_MONTH_MARCH, 26, 2, 30, 0) == TM_OK);
+  ck_assert (tm_makeintimezone (&end, paris, 2016, TM_MONTH_MARCH, 29, 0, 0, 0) == TM_OK);
+  ck_assert (tm_iter_init (&it, &start, &end, TM_ITER_DAY, 1) == TM_OK);
+  ck_assert (tm_iter_next (&it) && !it.flags && it.daylength == 86400);
+  ck_assert (tm_iter_next (&it) && it.flags == TM_ITER_SHIFTED && it.daylength == 23 * 3600);
+  ck_assert (tm_iter_next (&it) && !it.flags && tm_gethour_p (&it.current) == 2 && tm_getminute_p (&it.current) == 30);
+  ck_assert (!tm_iter_next (&it));
+
+  // Same elements as the operators, in several timezones and representations
+  const char *zones[] = { "Europe/Paris", "Australia/Lord_Howe", "America/Havana", "UTC" };
+  const struct
+  {
+    tm_iterunit unit;
+    int step;
+    int days;
+  } walks[] = { {TM_ITER_SECOND, 1800, 10}, {TM_ITER_MINUTE, 7, 3}, {TM_ITER_HOUR, 1, 60}, {TM_ITER_HOUR, 5, 400},
+  {TM_ITER_DAY, 1, 800}, {TM_ITER_WEEK, 2, 1500}, {TM_ITER_MONTH, 1, 3000}, {TM_ITER_MONTH, 7, 10000}
+  };
+
+  for (size_t z = 0; z < sizeof (zones) / sizeof (*zones); z++)
+    for (size_t w = 0; w < sizeof (walks) / sizeof (*walks); w++)
+    {
+      const tm_timezone *tz = tm_loadtimezone (zones[z]);
+
+      ck_assert (tz);
+      ck_assert (tm_makeintimezone (&start, tz, 2015, TM_MONTH_JANUARY, 31, 0, 30, 0) == TM_OK);
+      if (w % 3 == 2)
+        ck_assert (tm_toutcrepresentation (&start) == TM_OK);
+      end = start;
+      ck_assert (tm_adddays (&end, walks[w].days) == TM_OK);
+
+      long long n = 0;
+
+      ck_assert (tm_iter_init (&it, &start, &end, walks[w].unit, walks[w].step) == TM_OK);
+      for (; tm_iter_next (&it); n++)
+      {
+        struct tm expected = start;
+
+        if (walks[w].unit == TM_ITER_MONTH)
+          ck_assert (tm_addmonths (&expected, (int) n * walks[w].step) == TM_OK);
+        else if (walks[w].unit == TM_ITER_WEEK)
+          ck_assert (tm_adddays (&expected, (int) n * 7 * walks[w].step) == TM_OK);
+        else if (walks[w].unit == TM_ITER_DAY)
+          ck_assert (tm_adddays (&expected, (int) n * walks[w].step) == TM_OK);
+        else
+          ck_assert (tm_addseconds (&expected, n * walks[w].step * (walks[w].unit == TM_ITER_HOUR ? 3600 : walks[w].unit == TM_ITER_MINUTE ? 60 : 1)) == TM_OK);
+        if (n)
+          ck_assert (tm_equals_p (&it.current, &expected));
+        ck_assert (tm_diffseconds_p (&it.current, &expected) == 0);
+        ck_assert (it.time == tm_tobinary (expected));
+        ck_assert (tm_getdayofweek_p (&it.current) == tm_getdayofweek (expected));
+        ck_assert (tm_getdayofyear_p (&it.current) == tm_getdayofyear (expected));
+        ck_assert (tm_diffseconds_p (&it.current, &end) > 0);
+        ck_assert (!(it.flags & TM_ITER_OVERLAP_FIRST) == !tm_isdaylightsavingextrasummertime_p (&it.current)
+                   || !it.current.tm_isdst);
+        ck_assert (!(it.flags & TM_ITER_OVERLAP_SECOND) == !tm_isdaylightsavingextrawintertime_p (&it.current)
+                   || it.current.tm_isdst);
+      }
+      ck_assert (n > 0);
+    }
+
+  ck_assert (tm_iter_init (&it, &start, &end, TM_ITER_DAY, 0) == TM_ERROR);
+}
+
+END_TEST
+START_TEST (tu_rrule)
+{
+  const tm_timezone *ny = tm_loadtimezone ("America/New_York");
+  const struct
+  {
+    int y, m, d;                // DTSTART, at 09:00 New York time
+    const char *rule;
+    const char *occurrences;    // First occurrences, %Y%m%d
+  } examples[] = {
+    // From RFC 5545, section 3.8.5.3.
+    {1997, 9, 2, "FREQ=DAILY;COUNT=10",
+     "19970902 19970903 19970904 19970905 19970906 19970907 19970908 19970909 19970910 19970911 "},
+    {1997, 9, 2, "RRULE:FREQ=WEEKLY;INTERVAL=2;WKST=SU;BYDAY=TU,TH;COUNT=8",
+     "19970902 19970904 19970916 19970918 19970930 19971002 19971014 19971016 "},
+    {1997, 9, 5, "FREQ=MONTHLY;COUNT=10;BYDAY=1FR",
+     "19970905 19971003 19971107 19971205 19980102 19980206 19980306 19980403 19980501 19980605 "},
+    {1997, 9, 29, "FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=-1",
+     "19970930 19971031 19971128 19971231 19980130 19980227 19980331 "},
+    {1997, 9, 28, "FREQ=MONTHLY;BYMONTHDAY=-2;COUNT=6", "19970929 19971030 19971129 19971230 19980130 19980227 "},
+    {1997, 6, 10, "FREQ=YEARLY;COUNT=10;BYMONTH=6,7",
+     "19970610 19970710 19980610 19980710 19990610 19990710 20000610 20000710 20010610 20010710 "},
+    {1997, 5, 19, "FREQ=YEARLY;BYDAY=20MO", "19970519 19980518 19990517 "},
+    {1997, 9, 2, "FREQ=MONTHLY;INTERVAL=18;COUNT=10;BYMONTHDAY=10,11,12,13,14,15",
+     "19970910 19970911 19970912 19970913 19970914 19970915 19990310 19990311 19990312 19990313 "},
+    {2000, 1, 31, "FREQ=MONTHLY;COUNT=5", "20000131 20000331 20000531 20000731 20000831 "},
+  };
+
+  for (size_t e = 0; e < sizeof (examples) / sizeof (*examples); e++)
+  {
+    struct tm dtstart;
+    tm_rruleiter it;
+    char string[16];
+    const char *expected = examples[e].occurrences;
+
+    ck_assert (tm_makeintimezone (&dtstart, ny, examples[e].y, examples[e].m, examples[e].d, 9, 0, 0) == TM_OK);
+
+    tm_rrule *rrule = tm_rrule_compile (examples[e].rule, &dtstart);
+
+    ck_assert (rrule);
+    tm_rrule_iter_init (&it, rrule);
+    while (*expected && tm_rrule_iter_next (&it))
+    {
+      ck_assert (strftime (string, sizeof (string), "%Y%m%d ", &it.current) == 9);
+      ck_assert (strncmp (string, expected, 9) == 0);
+      ck_assert (tm_gethour_p (&it.current) == 9 && tm_getminute_p (&it.current) == 0);
+      ck_assert (tm_gettimezoneof_p (&it.current) == ny);
+      expected += 9;
+    }
+    ck_assert (*expected == 0);
+    if (strstr (examples[e].rule, "COUNT"))
+      ck_assert (!tm_rrule_iter_next (&it));
+    tm_rrule_free (rrule);
+  }
+
+  // UNTIL, across daylight saving time changes: always at 09:00 local time
+  struct tm dtstart, date, next;
+  tm_rruleiter it;
+  int n = 0;
+
+  ck_assert (tm_makeintimezone (&dtstart, ny, 1997, TM_MONTH_SEPTEMBER, 2, 9, 0, 0) == TM_OK);
+
+  tm_rrule *rrule = tm_rrule_compile ("FREQ=DAILY;UNTIL=19971224T000000Z", &dtstart);
+
+  ck_assert (rrule);
+  for (tm_rrule_iter_init (&it, rrule); tm_rrule_iter_next (&it); n++)
+  {
+    date = dtstart;
+    ck_assert (tm_adddays (&date, n) == TM_OK);
+    ck_assert (tm_equals_p (&it.current, &date));
+    ck_assert (tm_gethour_p (&it.current) == 9);
+  }
+  ck_assert (n == 113);
+  ck_assert (tm_getmonth_p (&date) == TM_MONTH_DECEMBER && tm_getday_p (&date) == 23);
+
+  // EXDATE
+  ck_assert (tm_makeintimezone (&date, ny, 1997, TM_MONTH_SEPTEMBER, 3, 9, 0, 0) == TM_OK);
+  ck_assert (tm_rrule_exclude (rrule, &date) == TM_OK);
+  n = 0;
+  for (tm_rrule_iter_init (&it, rrule); tm_rrule_iter_next (&it); n++)
+    ck_assert (tm_diffseconds_p (&it.current, &date) != 0);
+  ck_assert (n == 112);
+
+  // Next occurrence after an instant
+  ck_assert (tm_makeintimezone (&date, ny, 1997, TM_MONTH_OCTOBER, 25, 9, 0, 0) == TM_OK);
+  ck_assert (tm_rrule_next (rrule, &date, &next) == TM_OK);
+  ck_assert (tm_getday_p (&next) == 26 && tm_gethour_p (&next) == 9 && tm_diffseconds_p (&date, &next) == 25 * 3600);
+  ck_assert (tm_toutcrepresentation (&date) == TM_OK);
+  ck_assert (tm_addseconds (&date, -1) == TM_OK);
+  ck_assert (tm_rrule_next (rrule, &date, &next) == TM_OK);
+  ck_assert (tm_getday_p (&next) == 25 && tm_getmonth_p (&next) == TM_MONTH_OCTOBER);
+  ck_assert (tm_makeintimezone (&date, ny, 1997, TM_MONTH_DECEMBER, 23, 9, 0, 0) == TM_OK);
+  ck_assert (tm_rrule_next (rrule, &date, &next) == TM_ERROR);
+  tm_rrule_free (rrule);
+
+  ck_assert (tm_makeintimezone (&dtstart, ny, 1997, TM_MONTH_SEPTEMBER, 5, 9, 0, 0) == TM_OK);
+  rrule = tm_rrule_compile ("FREQ=MONTHLY;BYDAY=1FR", &dtstart);
+  ck_assert (rrule);
+  ck_assert (tm_makeintimezone (&date, ny, 2017, TM_MONTH_JANUARY, 6, 9, 0, 0) == TM_OK);
+  ck_assert (tm_rrule_next (rrule, &date, &next) == TM_OK);
+  ck_assert (tm_getyear_p (&next) == 2017 && tm_getmonth_p (&next) == TM_MONTH_FEBRUARY && tm_getday_p (&next) == 3);
+  ck_assert (tm_addseconds (&date, -1) == TM_OK);
+  ck_assert (tm_rrule_next (rrule, &date, &next) == TM_OK);
+  ck_assert (tm_getmonth_p (&next) == TM_MONTH_JANUARY && tm_getday_p (&next) == 6);
+  tm_rrule_free (rrule);
+
+  // Unsupported or invalid rules
+  errno = 0;
+  ck_assert (!tm_rrule_compile ("FREQ=HOURLY", &dtstart) && errno == EINVAL);
+  ck_assert (!tm_rrule_compile ("FREQ=DAILY;BYDAY=1MO", &dtstart));
+  ck_assert (!tm_rrule_compile ("FREQ=DAILY;COUNT=2;UNTIL=20000101", &dtstart));
+  ck_assert (!tm_rrule_compile ("FREQ=MONTHLY;BYMONTHDAY=32", &dtstart));
+  ck_assert (!tm_rrule_compile ("INTERVAL=2", &dtstart));
+
+  // Too many values (more than 64) for BYDAY and BYSETPOS
+  char rule[512];
+  char *p = rule + sprintf (rule, "FREQ=WEEKLY;BYDAY=");
+
+  for (int i = 0; i < 64; i++)
+    p += sprintf (p, "TU,");
+  strcpy (p, "MO");
+  errno = 0;
+  ck_assert (!tm_rrule_compile (rule, &dtstart) && errno == EINVAL);
+  strcpy (p, "+5MO");
+  errno = 0;
+  ck_assert (!tm_rrule_compile (rule, &dtstart) && errno == EINVAL);
+  p[-1] = 0;
+  rrule = tm_rrule_compile (rule, &dtstart);
+  ck_assert (rrule);
+  tm_rrule_free (rrule);
+  p = rule + sprintf (rule, "FREQ=MONTHLY;BYDAY=MO;BYSETPOS=");
+  for (int i = 1; i <= 65; i++)
+    p += sprintf (p, i < 65 ? "%i," : "%i", i);
+  errno = 0;
+  ck_assert (!tm_rrule_compile (rule, &dtstart) && errno == EINVAL);
+}
+
+END_TEST
+START_TEST (tu_index)
+{
+  enum { N = 2000 };
+  static struct tm dates[N];
+  struct tm start;
+
+  // Local and UTC instants over a few months, across daylight saving time transitions, with duplicates.
+  srand (21);
+  ck_assert (tm_makelocal (&start, 2023, TM_MONTH_JANUARY, 10, 0, 0, 0) == TM_OK);
+  for (size_t i = 0; i < N; i++)
+  {
+    dates[i] = start;
+    ck_assert (tm_addseconds (&dates[i], (rand () % (300 * 24)) * 3600L + (rand () % 4) * 900L) == TM_OK);
+    if (i % 5 == 0)
+      ck_assert (tm_toutcrepresentation (&dates[i]) == TM_OK);
+  }
+  dates[N - 1] = dates[0];
+
+  tm_index *index = tm_index_build (dates, N, TM_REP_LOCAL);
+
+  ck_assert (index);
+
+  // Sorted, and stable
+  for (size_t rank = 1; rank < N; rank++)
+  {
+    int cmp = tm_compare (&dates[tm_index_at (index, rank - 1)], &dates[tm_index_at (index, rank)]);
+
+    ck_assert (cmp < 0 || (cmp == 0 && tm_index_at (index, rank - 1) < tm_index_at (index, rank)));
+  }
+
+  // Bounds, compared to a linear count
+  for (size_t q = 0; q < 200; q++)
+  {
+    struct tm date = dates[rand () % N];
+    size_t before = 0, notafter = 0, lower, upper;
+
+    if (q % 2)
+      ck_assert (tm_addseconds (&date, (q % 3) ? 1 : -1) == TM_OK);
+    for (size_t i = 0; i < N; i++)
+    {
+      before += tm_compare (&dates[i], &date) < 0;
+      notafter += tm_compare (&dates[i], &date) <= 0;
+    }
+    ck_assert (tm_index_lowerbound (index, &date, &lower) == TM_OK);
+    ck_assert (tm_index_upperbound (index, &date, &upper) == TM_OK);
+    ck_assert_int_eq (lower, before);
+    ck_assert_int_eq (upper, notafter);
+  }
+
+  size_t first, last;
+
+  ck_assert (tm_index_range (index, &dates[0], &dates[0], &first, &last) == TM_OK);
+  ck_assert_int_eq (first, last);
+  ck_assert (tm_index_range (index, &dates[tm_index_at (index, 0)], &dates[tm_index_at (index, N - 1)], &first, &last) == TM_OK);
+  ck_assert_int_eq (first, 0);
+  ck_assert (last < N);
+
+  // Local days, compared to the local dates
+  size_t total = 0;
+  struct tm day = start;
+
+  ck_assert (tm_adddays (&day, -3) == TM_OK);
+  for (int d = 0; d < 305; d++)
+  {
+    ck_assert (tm_adddays (&day, 1) == TM_OK);
+    ck_assert (tm_index_day (index, tm_getyear (day), tm_getmonth (day), tm_getday (day), &first, &last) == TM_OK);
+    total += last - first;
+    for (size_t rank = first; rank < last; rank++)
+    {
+      struct tm local = dates[tm_index_at (index, rank)];
+
+      ck_assert (tm_tolocalrepresentation (&local) == TM_OK);
+      ck_assert_int_eq (tm_getday (local), tm_getday (day));
+      ck_assert_int_eq (tm_getmonth (local), tm_getmonth (day));
+    }
+  }
+  ck_assert_int_eq (total, N);
+  ck_assert (tm_index_day (index, 2023, TM_MONTH_FEBRUARY, 29, &first, &last) == TM_ERROR);
+
+  tm_index_free (index);
+
+  // Empty index, and UTC days
+  index = tm_index_build (dates, 0, TM_REP_UTC);
+  ck_assert (index);
+  ck_assert (tm_index_lowerbound (index, &start, &first) == TM_OK);
+  ck_assert_int_eq (first, 0);
+  ck_assert (tm_index_day (index, 2023, TM_MONTH_MARCH, 26, &first, &last) == TM_OK);
+  ck_assert_int_eq (last - first, 0);
+  tm_index_free (index);
+}
+END_TEST
+
+START_TEST (tu_bucket)
+{
+  enum { N = 3000 };
+  static time_t in[N], out[N];
+  struct tm date;
+
+  // Sorted instants over two years, every 5 hours and 53 minutes, across daylight saving time transitions.
+  ck_assert (tm_makelocal (&date, 2023, TM_MONTH_JANUARY, 1, 0, 0, 0) == TM_OK);
+  in[0] = tm_tobinary (date);
+  for (size_t i = 1; i < N; i++)
+    in[i] = in[i - 1] + 5 * 3600 + 53 * 60 + 7;
+
+  const tm_bucketunit units[] = { TM_BUCKET_DAY, TM_BUCKET_WEEK, TM_BUCKET_MONTH, TM_BUCKET_QUARTER, TM_BUCKET_YEAR };
+
+  for (size_t u = 0; u < sizeof (units) / sizeof (*units); u++)
+  {
+    ck_assert (tm_bucket_n (out, in, N, units[u], 1, TM_REP_LOCAL, 0) == TM_OK);
+    for (size_t i = 0; i < N; i++)
+    {
+      // Same as truncating the broken-down local date
+      struct tm start;
+
+      ck_assert (tm_frombinary (&date, in[i]) == TM_OK);
+      switch (units[u])
+      {
+        case TM_BUCKET_WEEK:
+          ck_assert (tm_adddays (&date, 1 - (int) tm_getdayofweek (date)) == TM_OK);
+          // fall through
+        case TM_BUCKET_DAY:
+          start = date;
+          ck_assert (tm_trimtime (&start) == TM_OK);
+          break;
+        default:
+          ck_assert (tm_makelocal (&start, tm_getyear (date),
+                                   units[u] == TM_BUCKET_MONTH ? tm_getmonth (date) :
+                                   units[u] == TM_BUCKET_QUARTER ? tm_getmonth (date) - (tm_getmonth (date) - 1) % 3 : TM_MONTH_JANUARY,
+                                   1, 0, 0, 0) == TM_OK);
+      }
+      ck_assert_int_eq (out[i], tm_tobinary (start));
+    }
+  }
+
+  // 15-minute buckets, in local time and UTC
+  ck_assert (tm_bucket_n (out, in, N, TM_BUCKET_MINUTE, 15, TM_REP_LOCAL, 0) == TM_OK);
+  for (size_t i = 0; i < N; i++)
+  {
+    ck_assert (out[i] <= in[i] && in[i] - out[i] < 15 * 60 + 3600);
+    ck_assert (i == 0 || out[i] > out[i - 1]);
+    ck_assert (tm_frombinary (&date, out[i]) == TM_OK);
+    ck_assert_int_eq (tm_getminute (date) % 15, 0);
+    ck_assert_int_eq (tm_getsecond (date), 0);
+  }
+  ck_assert (tm_bucket_n (out, in, N, TM_BUCKET_MINUTE, 15, TM_REP_UTC, 0) == TM_OK);
+  for (size_t i = 0; i < N; i++)
+    ck_assert_int_eq (out[i], in[i] - in[i] % 900);
+
+  // Unsorted instants, one at a time
+  for (size_t i = 0; i < N; i += 97)
+  {
+    time_t one;
+
+    ck_assert (tm_bucket_n (out, in, N, TM_BUCKET_HOUR, 1, TM_REP_LOCAL, 0) == TM_OK);
+    ck_assert (tm_bucket_n (&one, &in[N - 1 - i], 1, TM_BUCKET_HOUR, 1, TM_REP_LOCAL, 0) == TM_OK);
+    ck_assert_int_eq (one, out[N - 1 - i]);
+  }
+
+  // 7-minute buckets, not aligned on hours, every 30 seconds across the DST changes of 2016 in Paris (01:00 UTC):
+  // buckets last at most 7 minutes, and the repeated 02:00 to 03:00 hour in October never shares a bucket with the first one.
+  static const time_t changes[] = { 1459040400, 1477789200 };
+
+  for (size_t c = 0; c < sizeof (changes) / sizeof (*changes); c++)
+  {
+    for (size_t i = 0; i < 480; i++)
+      in[i] = changes[c] - 2 * 3600 + 30 * (time_t) i;
+    ck_assert (tm_bucket_n (out, in, 480, TM_BUCKET_MINUTE, 7, TM_REP_LOCAL, 0) == TM_OK);
+    for (size_t i = 0; i < 480; i++)
+    {
+      ck_assert (out[i] <= in[i] && in[i] - out[i] < 7 * 60);
+      ck_assert (i == 0 || out[i] >= out[i - 1]);
+      ck_assert (tm_frombinary (&date, out[i]) == TM_OK);
+      ck_assert ((tm_gethour (date) * 60 + tm_getminute (date)) % 7 == 0 || out[i] == changes[c]);
+      ck_assert_int_eq (tm_getsecond (date), 0);
+    }
+  }
+  // 02:01 CEST and 02:01 CET, one hour apart
+  ck_assert (out[(7200 - 3540) / 30] != out[(7200 + 60) / 30]);
+
+  ck_assert (tm_bucket_n (out, in, N, TM_BUCKET_MINUTE, 0, TM_REP_LOCAL, 0) == TM_ERROR);
+  ck_assert (tm_bucket_n (out, in, N, TM_BUCKET_DAY, 2, TM_REP_LOCAL, 0) == TM_ERROR);
+}
+END_TEST
+
+START_TEST (tu_record)
+{
+  enum { N = 600 };
+  static struct tm dates[N], back[N];
+  static tm_record records[N];
+  const tm_timezone *tokyo = tm_loadtimezone ("Asia/Tokyo");
+
+  ck_assert (tokyo);
+
+  // Local, UTC and Tokyo dates, every 14 hours and 37 minutes, across daylight saving time transitions
+  ck_assert (tm_makelocal (&dates[0], 2023, TM_MONTH_FEBRUARY, 20, 1, 30, 0) == TM_OK);
+  for (size_t i = 1; i < N; i++)
+  {
+    dates[i] = dates[i - 1];
+    ck_assert (tm_addseconds (&dates[i], 14 * 3600 + 37 * 60) == TM_OK);
+  }
+  for (size_t i = 0; i < N; i += 3)
+    ck_assert (tm_toutcrepresentation (&dates[i]) == TM_OK);
+  for (size_t i = 1; i < N; i += 7)
+    ck_assert (tm_totimezonerepresentation (&dates[i], tokyo) == TM_OK);
+
+  ck_assert (tm_torecord_n (records, dates, N, 0) == TM_OK);
+  ck_assert (tm_fromrecord_n (back, records, N, 0) == TM_OK);
+  for (size_t i = 0; i < N; i++)
+  {
+    // Same instant, representation, offset and timezone
+    ck_assert (tm_equals_p (&back[i], &dates[i]));
+    ck_assert (back[i].tm_zone == dates[i].tm_zone);
+    ck_assert_int_eq (back[i].tm_gmtoff, dates[i].tm_gmtoff);
+    ck_assert_int_eq (back[i].tm_isdst, dates[i].tm_isdst);
+    ck_assert_int_eq (tm_getrepresentation_p (&back[i]), tm_getrepresentation_p (&dates[i]));
+    ck_assert_int_eq (tm_gethour_p (&back[i]), tm_gethour_p (&dates[i]));
+
+    // Records sort as instants
+    size_t j = (i * 7919) % N;
+    int cmp = memcmp (records[i].bytes, records[j].bytes, sizeof (records[i].bytes));
+
+    ck_assert ((cmp > 0) - (cmp < 0) == tm_compare (&dates[i], &dates[j]) || tm_compare (&dates[i], &dates[j]) == 0);
+  }
+
+  // One at a time, with a date not normalized
+  struct tm date, copy;
+  tm_record record;
+
+  ck_assert (tm_makeutc (&date, 2024, TM_MONTH_FEBRUARY, 28, 12, 0, 0) == TM_OK);
+  date.tm_mday += 2;
+  ck_assert (tm_torecord (&date, &record) == TM_OK);
+  ck_assert (tm_fromrecord (&copy, &record) == TM_OK);
+  ck_assert (tm_isutcrepresentation (copy));
+  ck_assert_int_eq (tm_getmonth (copy), TM_MONTH_MARCH);
+  ck_assert_int_eq (tm_getday (copy), 1);
+
+  // Timezone not loaded, and invalid record
+  record = records[1];
+  record.bytes[15] ^= 1;
+  ck_assert (tm_fromrecord (&copy, &record) == TM_ERROR);
+  ck_assert_int_eq (errno, ENOENT);
+  record = records[0];
+  record.bytes[11] = 4;
+  ck_assert (tm_fromrecord (&copy, &record) == TM_ERROR);
+
+  // UTC offset unknown to the timezone: not guessed from the local timezone.
+  record = records[1];
+  record.bytes[8] ^= 1;
+  ck_assert (tm_fromrecord (&copy, &record) == TM_ERROR);
+  ck_assert_int_eq (errno, EINVAL);
+
+  // Timezones are identified by their canonical name, whatever their spelling.
+  char cwd[2048], link[4096], file[4096], *expected = 0;
+  ck_assert (getcwd (cwd, sizeof (cwd)));
+  snprintf (link, sizeof (link), "%s/dates_tu_check.localtime", cwd);
+  snprintf (file, sizeof (file), "%s/dates_tu_check.zone", cwd);
+  unlink (link);
+  ck_assert (symlink ("/usr/share/zoneinfo/Asia/Tokyo", link) == 0);
+
+  const char *spellings[] = { ":Asia/Tokyo", "/usr/share/zoneinfo/Asia/Tokyo", link };
+
+  ck_assert (tm_makeintimezone (&date, tokyo, 2024, TM_MONTH_MAY, 1, 9, 0, 0) == TM_OK);
+  ck_assert (tm_torecord (&date, &record) == TM_OK);
+  for (size_t i = 0; i < sizeof (spellings) / sizeof (*spellings); i++)
+  {
+    const tm_timezone *zone = tm_loadtimezone (spellings[i]);
+    tm_record other;
+
+    ck_assert (zone && zone != tokyo);
+    ck_assert (tm_makeintimezone (&copy, zone, 2024, TM_MONTH_MAY, 1, 9, 0, 0) == TM_OK);
+    ck_assert (tm_torecord (&copy, &other) == TM_OK);
+    ck_assert (!memcmp (other.bytes, record.bytes, sizeof (record.bytes)));
+  }
+  ck_assert (tm_makelocal (&date, 2024, TM_MONTH_MAY, 1, 9, 0, 0) == TM_OK);
+  ck_assert (tm_torecord (&date, &record) == TM_OK);
+  ck_assert (tm_makeintimezone (&copy, tm_loadtimezone (":Europe/Paris"), 2024, TM_MONTH_MAY, 1, 9, 0, 0) == TM_OK);
+  ck_assert (tm_torecord (&copy, records) == TM_OK);
+  ck_assert (!memcmp (records[0].bytes, record.bytes, sizeof (record.bytes)));
+  ck_assert (unlink (link) == 0);
+
+  // A copy of a zone out of the timezone database can not be told apart from other zones: no record.
+  size_t size = 0;
+  FILE *in = fopen ("/usr/share/zoneinfo/Asia/Tokyo", "rb"), *out = fopen (file, "wb");
+
+  ck_assert (in && out);
+  ck_assert ((expected = malloc (1 << 16)));
+  ck_assert ((size = fread (expected, 1, 1 << 16, in)) > 0);
+  ck_assert (fwrite (expected, 1, size, out) == size);
+  ck_assert (fclose (in) == 0 && fclose (out) == 0);
+  free (expected);
+  ck_assert (tm_makeintimezone (&copy, tm_loadtimezone (file), 2024, TM_MONTH_MAY, 1, 9, 0, 0) == TM_OK);
+  ck_assert_int_eq (tm_getutcoffset (copy), 9 * 3600);
+  ck_assert (tm_torecord (&copy, &record) == TM_ERROR);
+  ck_assert_int_eq (errno, EINVAL);
+  ck_assert (unlink (file) == 0);
+}
+END_TEST
+
+START_TEST (tu_codec)
+{
+  enum { N = 5000 };
+  static time_t times[N], decoded[N];
+  tm_timeencoder enc;
+  tm_timedecoder dec;
+
+  // Samples every minute, with jitter, gaps and a clock step back
+  srand (24);
+  times[0] = 1700000000;
+  for (size_t i = 1; i < N; i++)
+    times[i] = times[i - 1] + 60 + (i % 10 == 0 ? rand () % 3 - 1 : 0) + (i % 1000 == 0 ? 86400 : 0) - (i == 2500 ? 3600 : 0);
+  times[N - 2] = LLONG_MIN;     // Delta-of-deltas out of range of zig-zag tokens
+  times[N - 1] = LLONG_MAX;
+
+  tm_timeencoder_init (&enc, 100);
+  ck_assert (tm_timeencoder_put_n (&enc, times, N / 2) == TM_OK);
+  ck_assert (tm_timeencoder_flush (&enc) == TM_OK);
+  for (size_t i = N / 2; i < N; i++)
+    ck_assert (tm_timeencoder_put (&enc, times[i]) == TM_OK);
+  ck_assert (tm_timeencoder_flush (&enc) == TM_OK);
+  ck_assert (enc.size < N * sizeof (time_t) / 10);
+
+  // One at a time, and all at once
+  size_t count = 0;
+
+  for (tm_timedecoder_init (&dec, enc.data, enc.size); tm_timedecoder_next (&dec); count++)
+    ck_assert_int_eq (dec.current, times[count]);
+  ck_assert_int_eq (count, N);
+
+  tm_timedecoder_init (&dec, enc.data, enc.size);
+  ck_assert_int_eq (tm_timedecoder_next_n (&dec, decoded, 1234), 1234);
+  ck_assert_int_eq (tm_timedecoder_next_n (&dec, decoded + 1234, N), N - 1234);
+  ck_assert (memcmp (decoded, times, sizeof (times)) == 0);
+
+  // Random access
+  for (size_t index = 0; index < N; index += 37)
+  {
+    ck_assert (tm_timedecoder_seek (&dec, index) == TM_OK);
+    ck_assert_int_eq (dec.current, times[index]);
+    ck_assert (tm_timedecoder_next (&dec));
+    ck_assert_int_eq (dec.current, times[index + 1]);
+  }
+  ck_assert (tm_timedecoder_seek (&dec, N) == TM_ERROR);
+
+  // Corrupted column
+  tm_timedecoder_init (&dec, enc.data, enc.size - 1);
+  ck_assert (tm_timedecoder_next_n (&dec, decoded, N) < N);
+
+  // Regular series, 8 bytes per value down to a few bytes per block
+  tm_timeencoder_free (&enc);
+  tm_timeencoder_init (&enc, 0);
+  for (size_t i = 0; i < N; i++)
+    times[i] = 1700000000 + 10 * (time_t) i;
+  ck_assert (tm_timeencoder_put_n (&enc, times, N) == TM_OK);
+  ck_assert (tm_timeencoder_flush (&enc) == TM_OK);
+  ck_assert (enc.size < 30 * (N / 1024 + 1));
+  tm_timedecoder_init (&dec, enc.data, enc.size);
+  ck_assert_int_eq (tm_timedecoder_next_n (&dec, decoded, N + 1), N);
+  ck_assert (memcmp (decoded, times, sizeof (times)) == 0);
+  tm_timeencoder_free (&enc);
+}
+END_TEST
+
+START_TEST (tu_column)
+{
+  enum { N = 10000 };
+  static time_t times[N], keys[N], expected[N];
+  const char *path = "dates_tu_check.tmcol";
+
+  // A sorted year of events, in local time
+  times[0] = 1672531200;
+  for (size_t i = 1; i < N; i++)
+    times[i] = times[i - 1] + 3000 + (time_t) (i % 7) * 60;
+  ck_assert (tm_column_write (path, times, N, TM_REP_LOCAL, 256) == TM_OK);
+
+  tm_column *col = tm_column_open (path);
+
+  ck_assert (col);
+  ck_assert_int_eq (tm_column_size (col), N);
+  ck_assert_int_eq (tm_column_representation (col), TM_REP_LOCAL);
+  ck_assert (tm_column_timezone (col) == tm_getlocaltimezone ());
+  ck_assert (memcmp (tm_column_values (col), times, sizeof (times)) == 0);
+
+  // Range scan: blocks out of range are skipped, and instants are bucketed in place.
+  time_t from = times[4321] + 1, to = times[6000];
+  const time_t *values;
+  size_t n, count = 0, nbblocks = 0;
+
+  for (size_t block = 0; tm_column_scan (col, from, to, &block, &values, &n); block++)
+  {
+    nbblocks++;
+    ck_assert (tm_bucket_n (keys, values, n, TM_BUCKET_DAY, 1, tm_column_representation (col), 0) == TM_OK);
+    ck_assert (tm_bucket_n (expected, times + (values - tm_column_values (col)), n, TM_BUCKET_DAY, 1, TM_REP_LOCAL, 0) == TM_OK);
+    ck_assert (memcmp (keys, expected, n * sizeof (*keys)) == 0);
+    for (size_t i = 0; i < n; i++)
+      count += values[i] >= from && values[i] < to;
+  }
+  ck_assert_int_eq (count, 6000 - 4322);
+  ck_assert (nbblocks <= (6000 - 4322) / 256 + 2);
+  tm_column_close (col);
+
+  // The file is replaced, not overwritten: a column still open keeps its instants, and no temporary file is left.
+  col = tm_column_open (path);
+  ck_assert (col);
+  ck_assert (tm_column_write (path, times + 1, N - 1, TM_REP_UTC, 0) == TM_OK);
+  ck_assert_int_eq (tm_column_size (col), N);
+  ck_assert (memcmp (tm_column_values (col), times, sizeof (times)) == 0);
+  tm_column_close (col);
+  col = tm_column_open (path);
+  ck_assert (col);
+  ck_assert_int_eq (tm_column_size (col), N - 1);
+  ck_assert_int_eq (tm_column_representation (col), TM_REP_UTC);
+  ck_assert (!tm_column_timezone (col));
+  tm_column_close (col);
+
+  DIR *dir = opendir (".");
+
+  ck_assert (dir);
+  for (struct dirent * entry; (entry = readdir (dir));)
+    ck_assert (strncmp (entry->d_name, path, strlen (path)) || !entry->d_name[strlen (path)]);
+  closedir (dir);
+  ck_assert (tm_column_write ("dates_tu_check.none/column", times, N, TM_REP_UTC, 0) == TM_ERROR);
+
+  // Not a column file
+  FILE *f = fopen (path, "r+b");
+
+  ck_assert (f);
+  ck_assert (fwrite ("x", 1, 1, f) == 1);
+  ck_assert (fclose (f) == 0);
+  ck_assert (!tm_column_open (path));
+  ck_assert_int_eq (errno, EINVAL);
+  ck_assert (remove (path) == 0);
+}
+END_TEST
+
+START_TEST (tu_civil_kernels)
+{
+  // Around the limits of the 32-bit calendar kernels of dates.c (years -32799 and 2900000, 1000000000 days after 1970-01-01),
+  // dates are checked against tm_getdayssinceepoch(), day after day, on both sides.
+  static const int first[] = { -32802, 2739875, 2899998 };
+  for (size_t i = 0; i < sizeof (first) / sizeof (*first); i++)
+  {
+    long long previous = tm_getdayssinceepoch (first[i], TM_MONTH_JANUARY, 1) - 1;
+    for (int year = first[i]; year < first[i] + 5; year++)
+      for (tm_month month = TM_MONTH_JANUARY; month <= TM_MONTH_DECEMBER; month++)
+        for (int day = 1; day <= tm_getdaysinmonth (year, month); day++)
+        {
+          long long days = tm_getdayssinceepoch (year, month, day);
+          ck_assert (days == previous + 1);
+          previous = days;
+
+          struct tm tm;
+          ck_assert_int_eq (tm_makeutc (&tm, year, month, day, 0, 0, 0), TM_OK);
+          ck_assert (tm_tobinary (tm) == (time_t) days * 86400);
+          ck_assert_int_eq (tm.tm_year, year - 1900);
+          ck_assert_int_eq (tm.tm_mon, month - 1);
+          ck_assert_int_eq (tm.tm_mday, day);
+          ck_assert (tm.tm_yday == days - tm_getdayssinceepoch (year, TM_MONTH_JANUARY, 1));
+          ck_assert (tm.tm_wday == ((days + 4) % 7 + 7) % 7);
+
+          // The other way round, from the number of seconds, through the batch conversion.
+          time_t binary = (time_t) days * 86400 + 86399;
+          tm_status status;
+          ck_assert_int_eq (tm_frombinary_n (&tm, &binary, 1, TM_REP_UTC, &status), TM_OK);
+          ck_assert_int_eq (tm.tm_year, year - 1900);
+          ck_assert_int_eq (tm.tm_mon, month - 1);
+          ck_assert_int_eq (tm.tm_mday, day);
+        }
+  }
+}
+END_TEST
+
 START_TEST (tu_day_loop)
 {
   struct tm hour;
@@ -916,6 +2820,7 @@ mm_suite (void)
   tcase_add_test (tc, tu_today_utc);
   tcase_add_test (tc, tu_local);
   tcase_add_test (tc, tu_utc);
+  tcase_add_test (tc, tu_utc_normalization);
   tcase_add_test (tc, tu_set_from_local);
   tcase_add_test (tc, tu_set_from_utc);
   tcase_add_test (tc, tu_tostring_local);
@@ -933,7 +2838,31 @@ mm_suite (void)
   tcase_add_test (tc, tu_calendar);
   tcase_add_test (tc, tu_equality);
   tcase_add_test (tc, tu_change_timezone);
+  tcase_add_test (tc, tu_timezone_rules);
+  tcase_add_test (tc, tu_timezone_handle);
   tcase_add_test (tc, tu_serialization);
+  tcase_add_test (tc, tu_serialization_n);
+  tcase_add_test (tc, tu_instant);
+  tcase_add_test (tc, tu_iso8601);
+  tcase_add_test (tc, tu_iso8601_format);
+  tcase_add_test (tc, tu_format_compile);
+  tcase_add_test (tc, tu_parse_compile);
+  tcase_add_test (tc, tu_clock);
+  tcase_add_test (tc, tu_logformat);
+  tcase_add_test (tc, tu_diffcalendardays_n);
+  tcase_add_test (tc, tu_calendar_properties);
+  tcase_add_test (tc, tu_transitions);
+  tcase_add_test (tc, tu_sort);
+  tcase_add_test (tc, tu_pointer_api);
+  tcase_add_test (tc, tu_zone_identity);
+  tcase_add_test (tc, tu_iter);
+  tcase_add_test (tc, tu_rrule);
+  tcase_add_test (tc, tu_index);
+  tcase_add_test (tc, tu_bucket);
+  tcase_add_test (tc, tu_record);
+  tcase_add_test (tc, tu_codec);
+  tcase_add_test (tc, tu_column);
+  tcase_add_test (tc, tu_civil_kernels);
   tcase_add_test (tc, tu_day_loop);
   tcase_add_test (tc, tu_beginingoftheday);
   tcase_add_test (tc, tu_moon_walk);